@@ -55,6 +55,15 @@ namespace grm
 		void InitFromImage();
 		float ComputeMergingCost(NodePointerType n1, NodePointerType n2);
 		void UpdateSpecificAttributes(NodePointerType n1, NodePointerType n2);
+
+		// Optional functions for the distributed segmentation (DistributedSegmenter):
+		// write and read the specific attributes of a node in a GraphBuffer.
+		// void WriteAttributes(GraphBuffer& buffer, NodePointerType n);
+		// void ReadAttributes(GraphBuffer& buffer, NodePointerType n);
+
+		// Optional function for the mean image output (GetMeanImageOutput):
+		// mean value of the region of a node in each band.
+		// void GetMeans(NodePointerType n, float * means);
 	};
 	
 } // end of namespace grm
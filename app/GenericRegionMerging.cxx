@@ -20,16 +20,46 @@
 #include "otbVectorImage.h"
 #include "otbImageFileReader.h"
 #include "otbImageFileWriter.h"
+#include "otbImageIOFactory.h"
+#include "otbExtendedFilenameToReaderOptions.h"
 #include "grmSpringSegmenter.h"
 #include "grmFullLambdaScheduleSegmenter.h"
 #include "grmBaatzSegmenter.h"
+#include "grmPluginSegmenter.h"
+#include "grmCriterionRegistry.h"
+#include "grmMultiResolutionSegmenter.h"
+#include "grmDistributedSegmenter.h"
 #include "otbWrapperApplication.h"
 #include "otbWrapperApplicationFactory.h"
+#include "itkProcessObject.h"
+#include "itkCastImageFilter.h"
+#include <functional>
+#include <map>
 
 namespace otb
 {
 	namespace Wrapper
 	{
+		/*
+		 * The region merging is not an ITK filter: this process object only
+		 * exists to forward the progress of the iterations to the application
+		 * watchers.
+		 */
+		class RegionMergingProgress : public itk::ProcessObject
+		{
+		public:
+			typedef RegionMergingProgress Self;
+			typedef itk::ProcessObject SuperClass;
+			typedef itk::SmartPointer<Self> Pointer;
+
+			itkNewMacro(Self);
+			itkTypeMacro(RegionMergingProgress, itk::ProcessObject);
+
+			void Start() { this->InvokeEvent(itk::StartEvent()); }
+			void Report(const float progress) { this->UpdateProgress(progress); }
+			void End() { this->InvokeEvent(itk::EndEvent()); }
+		};
+
 		class GenericRegionMerging : public Application
 		{
 		public:
@@ -37,9 +67,14 @@ namespace otb
 			typedef Application SuperClass;
 			typedef itk::SmartPointer<Self> Pointer;
 
-			typedef FloatVectorImageType ImageType;
 			typedef UInt32ImageType LabelImageType;
 
+			/* The global ids are 64-bit: they are written as doubles, which hold them exactly */
+			typedef itk::CastImageFilter<otb::Image<uint64_t, 2>, DoubleImageType> GlobalIdCastFilterType;
+
+			/* Runs the segmentation of the input image with a criterion given the threshold */
+			typedef std::function<void(float)> CriterionRunnerType;
+
 			itkNewMacro(Self);
 			itkTypeMacro(GenericRegionMerging, otb::Application);
 
@@ -48,26 +83,31 @@ namespace otb
 			void DoInit()
 				{
 					SetName("GenericRegionMerging");
-					SetDescription("This application allows to use the Generic Region Merging library (GRM) and provides currently 3 homogeneity criteria: Euclidean Distance, Full Lambda Schedule and Baatz & Schape criterion.");
+					SetDescription("This application allows to use the Generic Region Merging library (GRM) and provides currently 3 homogeneity criteria: Euclidean Distance, Full Lambda Schedule and Baatz & Schape criterion, as well as the criteria of the plugin libraries found in the directories of GRM_CRITERION_PLUGIN_PATH.");
 
 					AddParameter(ParameterType_InputImage, "in", "Input Image");
 					AddParameter(ParameterType_OutputImage, "out", "Ouput Label Image");
 
 					AddParameter(ParameterType_Choice, "criterion", "Homogeneity criterion to use");
-					AddChoice("criterion.bs", "Baatz & Schape");
-					AddChoice("criterion.ed", "Euclidean Distance");
-					AddChoice("criterion.fls", "Full Lambda Schedule");
+					AddCriteria();
 
 					AddParameter(ParameterType_Float, "threshold", "Threshold for the criterion");
 
+					AddParameter(ParameterType_String, "schedule", "Threshold of the iterations as factors of the threshold (of its square for bs): constant, linear:start:iterations, geometric:start:iterations or table:f1,f2,...");
+					MandatoryOff("schedule");
+
 					AddParameter(ParameterType_Int, "niter", "Number of iterations");
 					SetDefaultParameterInt("niter", 0);
 					MandatoryOff("niter");
 
-					AddParameter(ParameterType_Int, "speed", "Activate it to boost the segmentation speed");
+					AddParameter(ParameterType_Int, "speed", "Activate it to boost the segmentation speed: 1 for the best fitting in a random order, 2 for the best fitting by increasing cost (buckets of costs)");
 					SetDefaultParameterInt("speed", 0);
 					MandatoryOff("speed");
 
+					AddParameter(ParameterType_Int, "multires", "Shrink factor of the coarse level of a coarse-to-fine segmentation: only the pixels along the borders of its regions start alone at full resolution (1 to disable)");
+					SetDefaultParameterInt("multires", 1);
+					MandatoryOff("multires");
+
 					// For Baatz & Schape
 					AddParameter(ParameterType_Float, "cw", "Weight for the spectral homogeneity");
 					SetDefaultParameterFloat("cw", 0.5);
@@ -75,99 +115,404 @@ namespace otb
 					AddParameter(ParameterType_Float, "sw", "Weight for the spatial homogeneity");
 					SetDefaultParameterFloat("sw", 0.5);
 					MandatoryOff("sw");
+
+					// For the criteria loaded from plugins
+					AddParameter(ParameterType_String, "cparams", "Parameters of a criterion loaded from a plugin (key=value pairs separated by spaces)");
+					MandatoryOff("cparams");
+
+					AddParameter(ParameterType_Directory, "storage", "Directory of a memory-mapped file holding the graph (out-of-core mode)");
+					MandatoryOff("storage");
+
+					AddParameter(ParameterType_Int, "zorder", "Sort the regions along the Z-order curve every zorder iterations (0 to disable)");
+					SetDefaultParameterInt("zorder", 0);
+					MandatoryOff("zorder");
+
+					AddParameter(ParameterType_Int, "minsize", "Minimum size (in pixels) of the segments: the smaller ones are merged into their most similar neighbor (0 to disable)");
+					SetDefaultParameterInt("minsize", 0);
+					MandatoryOff("minsize");
+
+					AddParameter(ParameterType_InputImage, "mask", "Mask of the pixels to segment (null pixels get the label 0)");
+					MandatoryOff("mask");
+					AddParameter(ParameterType_Float, "nodata", "No-data value of the input image (pixels with a band equal to it get the label 0)");
+					MandatoryOff("nodata");
+
+					AddParameter(ParameterType_StringList, "features", "Features computed for each segment: minmax, moments, histogram:band:bins:min:max or ndvi:red:nir");
+					MandatoryOff("features");
+					AddParameter(ParameterType_OutputFilename, "featout", "CSV file of the features (and area) of each segment, by label");
+					MandatoryOff("featout");
+
+					AddParameter(ParameterType_Choice, "labels", "Values of the labels of the output image and of the features");
+					AddChoice("labels.seq", "Sequential labels 1, 2, 3...");
+					AddChoice("labels.global", "Global ids of the regions plus 1: index of their first pixel in the scene which the input image is a tile of (use an output pixel type holding them, such as uint32 or double)");
+					AddParameter(ParameterType_Int, "labels.global.x", "Column of the first pixel of the input image in the scene");
+					SetDefaultParameterInt("labels.global.x", 0);
+					AddParameter(ParameterType_Int, "labels.global.y", "Row of the first pixel of the input image in the scene");
+					SetDefaultParameterInt("labels.global.y", 0);
+					AddParameter(ParameterType_Int, "labels.global.width", "Width of the scene (0 for the width of the input image)");
+					SetDefaultParameterInt("labels.global.width", 0);
+
+					AddParameter(ParameterType_OutputImage, "clustered", "Output image where each segment is painted with its mean value or with a color");
+					MandatoryOff("clustered");
+					AddParameter(ParameterType_Choice, "clusteredcolors", "Values of the segments in the clustered image");
+					AddChoice("clusteredcolors.mean", "Mean value of the segment in each band of the input image");
+					AddChoice("clusteredcolors.id", "RGB color derived from the global id of the segment (the same at each run)");
+
+					AddParameter(ParameterType_OutputFilename, "stats", "Per-iteration statistics of the segmentation (JSON if the extension is .json, CSV otherwise)");
+					MandatoryOff("stats");
+
+					// Only used when it is given: the image is then segmented by tiles if it does not fit in it (the coarse-to-fine segmentation stops instead).
+					AddRAMParameter();
 				}
 
-			void DoUpdateParameters()
+			void AddCriterion(const std::string& name, const std::string& description, CriterionRunnerType runner)
 				{
+					AddChoice("criterion." + name, description);
+					m_CriterionRunners[name] = runner;
 				}
 
-			void DoExecute()
+			/*
+			 * Adds the built-in criteria, then the ones of the plugin
+			 * libraries found in the directories of GRM_CRITERION_PLUGIN_PATH.
+			 */
+			void AddCriteria()
 				{
-					
-					// Mandatory parameters
-					// Input Image
-					ImageType::Pointer image = GetParameterImage("in");
-					image->Update();
+					AddCriterion("bs", "Baatz & Schape", [this](float threshold)
+						{
+							RunCriterion<grm::BaatzSegmenter>(threshold);
+						});
+
+					AddCriterion("ed", "Euclidean Distance", [this](float threshold)
+						{
+							RunCriterion<grm::SpringSegmenter>(threshold);
+						});
+
+					AddCriterion("fls", "Full Lambda Schedule", [this](float threshold)
+						{
+							RunCriterion<grm::FullLambdaScheduleSegmenter>(threshold);
+						});
+
+					try
+					{
+						m_CriterionRegistry.LoadFromEnvironment();
+					}
+					catch(const std::exception& e)
+					{
+						otbAppLogWARNING(<< "Cannot load the criterion plugins: " << e.what());
+					}
 
-					// Criterion selected
-					const std::string selectedCriterion = GetParameterString("criterion");
+					for(auto criterion : m_CriterionRegistry.GetCriteria())
+					{
+						if(m_CriterionRunners.count(criterion->m_Name) > 0)
+						{
+							otbAppLogWARNING(<< "The plugin criterion " << criterion->m_Name << " is ignored: it has the name of a built-in one");
+							continue;
+						}
+
+						AddCriterion(criterion->m_Name, criterion->m_Description, [this](float threshold)
+							{
+								RunCriterion<grm::PluginSegmenter>(threshold);
+							});
+					}
+				}
 
-					// Threshold
-					float threshold = GetParameterFloat("threshold");
+			/* Type of the bands of the input image, as stored in the file */
+			itk::ImageIOBase::IOComponentType GetInputComponentType()
+				{
+					ExtendedFilenameToReaderOptions::Pointer fileName = ExtendedFilenameToReaderOptions::New();
+					fileName->SetExtendedFileName(GetParameterString("in"));
 
-					const unsigned int niter = GetParameterInt("niter");
-					const int speed = GetParameterInt("speed");
+					itk::ImageIOBase::Pointer imageIO = ImageIOFactory::CreateImageIO(fileName->GetSimpleFileName(),
+																					   ImageIOFactory::ReadMode);
+					if(imageIO.IsNull())
+						return itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
 
-					// Output images
-					LabelImageType::Pointer labelImage = LabelImageType::New();
-					typedef otb::VectorImage<unsigned char, 2> RGBLabelImageType;
-					RGBLabelImageType::Pointer rvbLabelImage = RGBLabelImageType::New();
+					imageIO->SetFileName(fileName->GetSimpleFileName());
+					imageIO->ReadImageInformation();
+					return imageIO->GetComponentType();
+				}
 
-					if(selectedCriterion == "bs")
+			/*
+			 * Runs a criterion on the input image read with its native type
+			 * of band when it is a small integer one, so that the pixels are
+			 * not converted into floats and the sums of the regions are exact.
+			 * The other images are read as float images.
+			 */
+			template<template<class> class TSegmenter>
+			void RunCriterion(float threshold)
+				{
+					switch(GetInputComponentType())
 					{
-						const float cw = GetParameterFloat("cw");
-						const float sw = GetParameterFloat("sw");
+					case itk::ImageIOBase::UCHAR:
+						Segment< TSegmenter<UInt8VectorImageType> >(GetParameterUInt8VectorImage("in"), threshold);
+						break;
+					case itk::ImageIOBase::USHORT:
+						Segment< TSegmenter<UInt16VectorImageType> >(GetParameterUInt16VectorImage("in"), threshold);
+						break;
+					case itk::ImageIOBase::SHORT:
+						Segment< TSegmenter<Int16VectorImageType> >(GetParameterInt16VectorImage("in"), threshold);
+						break;
+					default:
+						Segment< TSegmenter<FloatVectorImageType> >(GetParameterFloatVectorImage("in"), threshold);
+						break;
+					}
+				}
 
-						grm::BaatzParam params;
-						params.m_SpectralWeight = cw;
-						params.m_ShapeWeight = sw;
+			template<class TImage>
+			void ConfigureCriterion(grm::BaatzSegmenter<TImage>& segmenter, float threshold)
+				{
+					grm::BaatzParam params;
+					params.m_SpectralWeight = GetParameterFloat("cw");
+					params.m_ShapeWeight = GetParameterFloat("sw");
+					segmenter.SetParam(params);
+					segmenter.SetThreshold(threshold*threshold);
+				}
 
-						grm::BaatzSegmenter<ImageType> segmenter;
-						segmenter.SetParam(params);
-						segmenter.SetThreshold(threshold*threshold);
-						segmenter.SetInput(image);
+			template<class TImage>
+			void ConfigureCriterion(grm::SpringSegmenter<TImage>& segmenter, float threshold)
+				{
+					segmenter.SetThreshold(threshold);
+				}
 
-						if(niter > 0)
-							segmenter.SetNumberOfIterations(niter);
+			template<class TImage>
+			void ConfigureCriterion(grm::FullLambdaScheduleSegmenter<TImage>& segmenter, float threshold)
+				{
+					segmenter.SetThreshold(threshold);
+				}
 
-						if(speed > 0)
-							segmenter.SetDoFastSegmentation(true);
+			template<class TImage>
+			void ConfigureCriterion(grm::PluginSegmenter<TImage>& segmenter, float threshold)
+				{
+					if(GetParameterInt("multires") > 1)
+						otbAppLogFATAL(<< "The coarse-to-fine segmentation does not support the plugin criteria");
+
+					grm::PluginParam params;
+					params.m_Criterion = m_CriterionRegistry.Find(GetParameterString("criterion"));
+					if(HasValue("cparams"))
+						params.m_Parameters = GetParameterString("cparams");
+					segmenter.SetParam(params);
+					segmenter.SetThreshold(threshold);
+				}
+
+			/* Segments the image with the selected criterion and sets the output label image */
+			template<class TSegmenter>
+			void Segment(typename TSegmenter::ImageType::Pointer image, float threshold)
+				{
+					// The segmenter reads the image by strips
+					image->UpdateOutputInformation();
+
+					auto configure = [&](TSegmenter& s)
+						{
+							ConfigureCriterion(s, threshold);
+							ConfigureSegmenter(s);
+						};
+
+					std::size_t memoryBudget = 0;
+					if(HasUserValue("ram"))
+						memoryBudget = static_cast<std::size_t>(GetParameterInt("ram")) * 1024 * 1024;
+
+					// The coarse-to-fine segmentation checks the budget itself once
+					// the pixels to refine are known: it is not segmented by tiles.
+					if(memoryBudget > 0 && GetParameterInt("multires") <= 1)
+					{
+						TSegmenter estimator;
+						configure(estimator);
+						const auto size = image->GetLargestPossibleRegion().GetSize();
+						const std::size_t estimate = estimator.EstimateMemoryUsage(size[0], size[1], image->GetNumberOfComponentsPerPixel());
+						if(estimate > memoryBudget)
+						{
+							otbAppLogINFO(<< "The segmentation of the whole image needs about " << estimate / (1024 * 1024) + 1
+										  << " MB: the image is segmented by tiles");
+
+							// The mask of the whole image is cut into the tiles by the distributed
+							// segmenter. The tiles are segmented by this process only, without MPI
+							// which cannot be initialized again by a second execution.
+							grm::Communicator communicator;
+							grm::DistributedSegmenter<TSegmenter> distributed(communicator);
+							distributed.SetInput(image);
+							distributed.SetMemoryBudget(memoryBudget);
+							if(HasValue("mask"))
+								distributed.SetMask(GetParameterUInt8Image("mask"));
+							distributed.SetConfigureFunction([&](TSegmenter& s)
+								{
+									configure(s);
+									s.SetMask(nullptr);
+								});
+
+							RunSegmenter(distributed);
+							otbAppLogINFO(<< "Tiles of " << distributed.GetTileWidth() << " x " << distributed.GetTileHeight() << " pixels");
+							SetOutputs(distributed.GetSegmenter(), image.GetPointer());
+							return;
+						}
+					}
 
-						segmenter.Update();
+					grm::MultiResolutionSegmenter<TSegmenter> multiResolution;
+					multiResolution.SetInput(image);
+					multiResolution.SetShrinkFactor(GetParameterInt("multires"));
+					multiResolution.SetConfigureFunction([&](TSegmenter& s)
+						{
+							configure(s);
+							s.SetMemoryBudget(memoryBudget);
+						});
+
+					// The costs of bs and fls grow with the areas of the regions,
+					// which the shrinking divides by the square of the factor.
+					const float shrinkFactor = static_cast<float>(GetParameterInt("multires"));
+					const std::string criterion = GetParameterString("criterion");
+					if(criterion == "bs" || criterion == "fls")
+						multiResolution.SetCoarseThresholdFactor(1.0f / (shrinkFactor * shrinkFactor));
+
+					RunSegmenter(multiResolution);
+					if(multiResolution.GetShrinkFactor() > 1)
+					{
+						otbAppLogINFO(<< multiResolution.GetNumberOfCores() << " regions of the coarse level and "
+									  << multiResolution.GetNumberOfRefinedPixels() << " pixels refined at full resolution");
+					}
+					SetOutputs(multiResolution.GetSegmenter(), image.GetPointer());
+				}
 
-						
-						labelImage = segmenter.GetLabeledClusteredOutput();
-						//SetParameterOutputImage<LabelImageType>("out", segmenter.GetLabeledClusteredOutput());
+			/* Sets the label image and the clustered image from the graph of the segmented image */
+			template<class TSegmenter>
+			void SetOutputs(TSegmenter& segmenter, typename TSegmenter::ImageType * image)
+				{
+					if(GetParameterString("labels") == "global")
+					{
+						m_GlobalIdCast = GlobalIdCastFilterType::New();
+						m_GlobalIdCast->SetInput(segmenter.GetGlobalIdLabelOutput());
+						m_GlobalIdCast->Update();
+						SetOutputImage<DoubleImageType>("out", m_GlobalIdCast->GetOutput(), image);
 					}
-					else if(selectedCriterion == "ed")
+					else
 					{
-						grm::SpringSegmenter<ImageType> segmenter;
-						segmenter.SetThreshold(threshold);
-						segmenter.SetInput(image);
-						if(niter > 0)
-							segmenter.SetNumberOfIterations(niter);
+						SetOutputImage<LabelImageType>("out", segmenter.GetLabeledClusteredOutput(), image);
+					}
 
-						if(speed > 0)
-							segmenter.SetDoFastSegmentation(true);
+					if(HasValue("clustered"))
+					{
+						if(GetParameterString("clusteredcolors") == "mean")
+							SetOutputImage<FloatVectorImageType>("clustered", segmenter.GetMeanImageOutput(), image);
+						else
+							SetOutputImage<UInt8VectorImageType>("clustered", segmenter.GetClusteredImageOutput(), image);
+					}
+				}
 
-						segmenter.Update();
+			/* Sets an output image with the projection, origin and spacing of the input image */
+			template<class TOutputImage, class TImage>
+			void SetOutputImage(const std::string& key, typename TOutputImage::Pointer output, TImage * image)
+				{
+					output->SetProjectionRef(image->GetProjectionRef());
+					output->SetOrigin(image->GetOrigin());
+					output->SetSpacing(image->GetSpacing());
+					SetParameterOutputImage<TOutputImage>(key, output);
+				}
 
-						labelImage = segmenter.GetLabeledClusteredOutput();
-						//SetParameterOutputImage<LabelImageType>("out", segmenter.GetLabeledClusteredOutput());
-					}
-					else if(selectedCriterion == "fls")
+			/* Sets the parameters common to all the criteria */
+			template<class TSegmenter>
+			void ConfigureSegmenter(TSegmenter& segmenter)
+				{
+					const unsigned int niter = GetParameterInt("niter");
+					if(niter > 0)
+						segmenter.SetNumberOfIterations(niter);
+
+					if(GetParameterInt("speed") == 2)
+						segmenter.SetMergingHeuristic(grm::BUCKETED_BF_HEURISTIC);
+					else if(GetParameterInt("speed") > 0)
+						segmenter.SetDoFastSegmentation(true);
+
+					if(HasValue("schedule"))
+						segmenter.SetThresholdSchedule(grm::ThresholdSchedule::Parse(GetParameterString("schedule")));
+
+					if(HasValue("mask"))
+						segmenter.SetMask(GetParameterUInt8Image("mask"));
+					if(HasValue("nodata"))
+						segmenter.SetNoDataValue(GetParameterFloat("nodata"));
+
+					if(HasValue("storage"))
+						segmenter.SetStorageDirectory(GetParameterString("storage"));
+					segmenter.SetNodeSortingPeriod(GetParameterInt("zorder"));
+					segmenter.SetMinimumRegionSize(GetParameterInt("minsize"));
+
+					const bool globalIds = (GetParameterString("labels") == "global");
+					if(globalIds)
 					{
-						grm::FullLambdaScheduleSegmenter<ImageType> segmenter;
-						segmenter.SetThreshold(threshold);
-						segmenter.SetInput(image);
-						if(niter > 0)
-							segmenter.SetNumberOfIterations(niter);
+						segmenter.SetSceneOffsetX(GetParameterInt("labels.global.x"));
+						segmenter.SetSceneOffsetY(GetParameterInt("labels.global.y"));
+						segmenter.SetSceneWidth(GetParameterInt("labels.global.width"));
+					}
 
-						if(speed > 0)
-							segmenter.SetDoFastSegmentation(true);
+					if(HasValue("features"))
+					{
+						for(auto& description : GetParameterStringList("features"))
+							segmenter.AddFeatureAccumulator(grm::CreateFeatureAccumulator(description));
+					}
+				}
 
-						segmenter.Update();
+			/*
+			 * Runs the segmentation (coarse-to-fine or by tiles according to
+			 * the wrapper of the segmenter) and writes its statistics and
+			 * features.
+			 */
+			template<class TRunner>
+			void RunSegmenter(TRunner& runner)
+				{
+					typename TRunner::SegmenterType& segmenter = runner.GetSegmenter();
+
+					// The application only keeps a raw pointer on the watched process
+					m_Progress = RegionMergingProgress::New();
+					AddProcess(m_Progress, "Region merging");
+					RegionMergingProgress* progress = m_Progress.GetPointer();
+					segmenter.SetIterationCallback([progress](const grm::IterationStatistics& stats)
+						{
+							progress->Report(static_cast<float>(stats.m_Iteration) /
+											 static_cast<float>(stats.m_MaximumNumberOfIterations));
+						});
+
+					m_Progress->Start();
+					runner.Update();
+					m_Progress->Report(1.0);
+					m_Progress->End();
+
+					if(HasValue("stats"))
+						segmenter.GetStatistics().Write(GetParameterString("stats"));
+
+					// The estimate can be checked against the memory actually taken by the segmentation.
+					const grm::SegmentationStatistics& stats = segmenter.GetStatistics();
+					if(stats.m_EstimatedMemoryUsage > 0 && stats.m_PeakMemoryUsage > stats.m_InitialMemoryUsage)
+					{
+						otbAppLogINFO(<< "Estimated memory: " << stats.m_EstimatedMemoryUsage / (1024 * 1024) << " MB, peak memory of the segmentation: "
+									  << (stats.m_PeakMemoryUsage - stats.m_InitialMemoryUsage) / (1024 * 1024) << " MB");
+					}
 
-						labelImage = segmenter.GetLabeledClusteredOutput();
-						//SetParameterOutputImage<LabelImageType>("out", segmenter.GetLabeledClusteredOutput());
+					if(HasValue("featout"))
+					{
+						const bool globalIds = (GetParameterString("labels") == "global");
+						segmenter.WriteFeatures(GetParameterString("featout"), globalIds ? grm::GLOBAL_ID_LABELS : grm::SEQUENTIAL_LABELS);
 					}
+				}
+
+			void DoUpdateParameters()
+				{
+				}
+
+			void DoExecute()
+				{
 					
-					// Set output image projection, origin and spacing for labelImage
-					labelImage->SetProjectionRef(image->GetProjectionRef());
-					labelImage->SetOrigin(image->GetOrigin());
-					labelImage->SetSpacing(image->GetSpacing());
-					SetParameterOutputImage<LabelImageType>("out", labelImage);
+					// Mandatory parameters
+					// Criterion selected
+					const std::string selectedCriterion = GetParameterString("criterion");
+
+					// Threshold
+					float threshold = GetParameterFloat("threshold");
+
+					// Segmentation of the input image with the selected criterion
+					m_CriterionRunners.at(selectedCriterion)(threshold);
 				}
+
+			RegionMergingProgress::Pointer m_Progress;
+			GlobalIdCastFilterType::Pointer m_GlobalIdCast;
+
+			/* Plugin libraries and segmentation of each criterion, by name */
+			grm::CriterionRegistry m_CriterionRegistry;
+			std::map<std::string, CriterionRunnerType> m_CriterionRunners;
 		};
 	} // end of namespace Wrapper
 	
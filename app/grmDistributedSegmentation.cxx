@@ -0,0 +1,249 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+     Region merging segmentation distributed over MPI processes: each
+     process segments a band of tiles of the image and writes their
+     labels, which are consistent over the whole image, in one file per
+     tile (out_<row>_<column>.tif for --out out.tif). With --labels global,
+     the label of a region is its global id plus 1 (index of its first
+     pixel in the image), written as a double. Without --tilesize, the
+     tiles are the largest ones fitting in the memory budget given by
+     --ram (in MB), 1024 x 1024 pixels if it is not given either.
+
+     Usage: mpirun -np 4 grmDistributedSegmentation --in image --out labels.tif
+                         [--criterion bs|ed|fls] [--threshold t] [--cw w] [--sw w]
+                         [--tilesize n] [--ram MB] [--niter n] [--speed 0|1|2]
+                         [--minsize n] [--nodata value] [--labels seq|global]
+                         [--schedule constant|linear:f:n|geometric:f:n|table:f1,f2,...]
+
+=========================================================================*/
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <otbVectorImage.h>
+#include <otbImageFileReader.h>
+#include <otbImageFileWriter.h>
+#include <itkCastImageFilter.h>
+#include "grmSpringSegmenter.h"
+#include "grmFullLambdaScheduleSegmenter.h"
+#include "grmBaatzSegmenter.h"
+#include "grmDistributedSegmenter.h"
+
+namespace
+{
+	typedef otb::VectorImage<float, 2> ImageType;
+	typedef otb::ImageFileReader<ImageType> ReaderType;
+	typedef otb::Image<double, 2> GlobalIdImageType;
+
+	struct SegmentationOptions
+	{
+		std::string m_InputFileName;
+		std::string m_OutputFileName;
+		std::string m_Criterion = "bs";
+		float m_Threshold = 60.0f;
+		float m_SpectralWeight = 0.7f;
+		float m_ShapeWeight = 0.3f;
+		unsigned int m_TileSize = 0;
+		std::size_t m_MemoryBudget = 0;
+		unsigned int m_NumberOfIterations = 0;
+		unsigned int m_Speed = 0;
+		unsigned int m_MinimumRegionSize = 0;
+		bool m_UseNoDataValue = false;
+		float m_NoDataValue = 0.0f;
+		bool m_GlobalIds = false;
+		grm::ThresholdSchedule m_ThresholdSchedule;
+	};
+
+	/* out.tif gives out_<row>_<column>.tif */
+	std::string GetTileFileName(const std::string& fileName, const unsigned int row, const unsigned int column)
+	{
+		const std::size_t dot = fileName.find_last_of('.');
+		const std::size_t slash = fileName.find_last_of('/');
+		const bool hasExtension = (dot != std::string::npos && (slash == std::string::npos || dot > slash));
+
+		std::ostringstream os;
+		os << fileName.substr(0, hasExtension ? dot : fileName.size()) << "_" << row << "_" << column
+		   << (hasExtension ? fileName.substr(dot) : std::string(".tif"));
+		return os.str();
+	}
+
+	/* Parameters shared by all the criteria */
+	template<class TSegmenter>
+	void ConfigureSegmenter(TSegmenter& segmenter, const SegmentationOptions& options)
+	{
+		segmenter.SetNumberOfIterations(options.m_NumberOfIterations);
+		if(options.m_Speed == 2)
+			segmenter.SetMergingHeuristic(grm::BUCKETED_BF_HEURISTIC);
+		else
+			segmenter.SetDoFastSegmentation(options.m_Speed > 0);
+		segmenter.SetMinimumRegionSize(options.m_MinimumRegionSize);
+		segmenter.SetThresholdSchedule(options.m_ThresholdSchedule);
+		if(options.m_UseNoDataValue)
+			segmenter.SetNoDataValue(options.m_NoDataValue);
+	}
+
+	template<class TSegmenter>
+	void Segment(grm::Communicator& communicator,
+				 ImageType * image,
+				 const SegmentationOptions& options,
+				 typename grm::DistributedSegmenter<TSegmenter>::ConfigureFunctionType configure)
+	{
+		typedef grm::DistributedSegmenter<TSegmenter> DistributedSegmenterType;
+		typedef otb::ImageFileWriter<typename DistributedSegmenterType::LabelImageType> WriterType;
+		typedef itk::CastImageFilter<typename DistributedSegmenterType::GlobalLabelImageType, GlobalIdImageType> GlobalIdCastFilterType;
+		typedef otb::ImageFileWriter<GlobalIdImageType> GlobalIdWriterType;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		DistributedSegmenterType segmenter(communicator);
+		segmenter.SetInput(image);
+		segmenter.SetTileWidth(options.m_TileSize);
+		segmenter.SetTileHeight(options.m_TileSize);
+		segmenter.SetMemoryBudget(options.m_MemoryBudget);
+		segmenter.SetConfigureFunction([&](TSegmenter& s)
+			{
+				configure(s);
+				ConfigureSegmenter(s, options);
+			});
+		segmenter.Update();
+
+		for(auto& tile : segmenter.GetTiles())
+		{
+			const std::string fileName = GetTileFileName(options.m_OutputFileName, tile.m_UY / segmenter.GetTileHeight(),
+														 tile.m_UX / segmenter.GetTileWidth());
+			if(options.m_GlobalIds)
+			{
+				auto labelImage = segmenter.GetTileGlobalIdImage(tile);
+				typename GlobalIdCastFilterType::Pointer cast = GlobalIdCastFilterType::New();
+				cast->SetInput(labelImage);
+				typename GlobalIdWriterType::Pointer writer = GlobalIdWriterType::New();
+				writer->SetFileName(fileName);
+				writer->SetInput(cast->GetOutput());
+				writer->Update();
+			}
+			else
+			{
+				auto labelImage = segmenter.GetTileLabelImage(tile);
+				typename WriterType::Pointer writer = WriterType::New();
+				writer->SetFileName(fileName);
+				writer->SetInput(labelImage);
+				writer->Update();
+			}
+		}
+
+		communicator.Barrier();
+		if(communicator.GetRank() == 0)
+		{
+			std::cout << "Number of regions: " << segmenter.GetNumberOfRegions() << " (" << communicator.GetSize()
+					  << " processes, " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+					  << " s, tiles of " << segmenter.GetTileWidth() << " x " << segmenter.GetTileHeight() << " pixels)" << std::endl;
+		}
+	}
+
+	bool ParseOptions(int argc, char * argv[], SegmentationOptions& options)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			const std::string arg(argv[i]);
+			if(i + 1 >= argc)
+				return false;
+			const std::string value(argv[++i]);
+
+			if(arg == "--in") options.m_InputFileName = value;
+			else if(arg == "--out") options.m_OutputFileName = value;
+			else if(arg == "--criterion") options.m_Criterion = value;
+			else if(arg == "--threshold") options.m_Threshold = std::stof(value);
+			else if(arg == "--cw") options.m_SpectralWeight = std::stof(value);
+			else if(arg == "--sw") options.m_ShapeWeight = std::stof(value);
+			else if(arg == "--tilesize") options.m_TileSize = std::stoul(value);
+			else if(arg == "--ram") options.m_MemoryBudget = std::stoul(value) * 1024 * 1024;
+			else if(arg == "--niter") options.m_NumberOfIterations = std::stoul(value);
+			else if(arg == "--speed") options.m_Speed = std::stoul(value);
+			else if(arg == "--minsize") options.m_MinimumRegionSize = std::stoul(value);
+			else if(arg == "--nodata") { options.m_NoDataValue = std::stof(value); options.m_UseNoDataValue = true; }
+			else if(arg == "--labels" && (value == "seq" || value == "global")) options.m_GlobalIds = (value == "global");
+			else if(arg == "--schedule") options.m_ThresholdSchedule = grm::ThresholdSchedule::Parse(value);
+			else return false;
+		}
+		if(options.m_TileSize == 0 && options.m_MemoryBudget == 0)
+			options.m_TileSize = 1024;
+		return !options.m_InputFileName.empty() && !options.m_OutputFileName.empty() &&
+			(options.m_Criterion == "bs" || options.m_Criterion == "ed" || options.m_Criterion == "fls");
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	grm::Communicator communicator(&argc, &argv);
+
+	SegmentationOptions options;
+	if(!ParseOptions(argc, argv, options))
+	{
+		if(communicator.GetRank() == 0)
+		{
+			std::cerr << "Usage: " << argv[0] << " --in image --out labels.tif [--criterion bs|ed|fls] [--threshold t]"
+					  << " [--cw w] [--sw w] [--tilesize n] [--ram MB] [--niter n] [--speed 0|1|2] [--minsize n] [--nodata value]"
+					  << " [--labels seq|global] [--schedule constant|linear:f:n|geometric:f:n|table:f1,f2,...]" << std::endl;
+		}
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		// Each process only reads its tiles.
+		ReaderType::Pointer reader = ReaderType::New();
+		reader->SetFileName(options.m_InputFileName);
+		reader->UpdateOutputInformation();
+		ImageType * image = reader->GetOutput();
+
+		const float threshold = options.m_Threshold;
+		if(options.m_Criterion == "bs")
+		{
+			Segment< grm::BaatzSegmenter<ImageType> >(communicator, image, options, [&](grm::BaatzSegmenter<ImageType>& s)
+				{
+					grm::BaatzParam params;
+					params.m_SpectralWeight = options.m_SpectralWeight;
+					params.m_ShapeWeight = options.m_ShapeWeight;
+					s.SetParam(params);
+					s.SetThreshold(threshold*threshold);
+				});
+		}
+		else if(options.m_Criterion == "ed")
+		{
+			Segment< grm::SpringSegmenter<ImageType> >(communicator, image, options, [&](grm::SpringSegmenter<ImageType>& s)
+				{
+					s.SetThreshold(threshold);
+				});
+		}
+		else
+		{
+			Segment< grm::FullLambdaScheduleSegmenter<ImageType> >(communicator, image, options, [&](grm::FullLambdaScheduleSegmenter<ImageType>& s)
+				{
+					s.SetThreshold(threshold);
+				});
+		}
+	}
+	catch(const std::exception& e)
+	{
+		// The other processes would wait forever for the graph of this one.
+		std::cerr << "Process " << communicator.GetRank() << ": " << e.what() << std::endl;
+		communicator.Abort(EXIT_FAILURE);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -18,15 +18,54 @@
 #ifndef GRM_BAATZ_SEGMENTER_H
 #define GRM_BAATZ_SEGMENTER_H
 #include "grmSegmenter.h"
+#include "grmPixelTraits.h"
 
 namespace grm
 {
-	struct BaatzNode : Node<BaatzNode>
+	/*
+	  The sums of the pixel values are exact for the integer images (see
+	  AccumulatorTraits) and the means are derived from them. The sums of
+	  the squared deviations from the means are combined pairwise at each
+	  merge, which is stable even for large regions with a large mean.
+
+	  A node of a single pixel only keeps its value in the type of the
+	  image: the statistics of the bands are built when it absorbs its
+	  first neighbor, most pixels being absorbed without ever growing.
+	 */
+	template<class TValue>
+	struct BaatzNode : Node< BaatzNode<TValue> >
 	{
-		std::vector<float> m_Means;
-		std::vector<float> m_SquareMeans;
-		std::vector<float> m_SpectralSum;
-		std::vector<float> m_Std;
+		typedef typename AccumulatorTraits<TValue>::SumType SumType;
+
+		struct BandStatistics
+		{
+			SumType m_SpectralSum;
+			double m_SquaredDeviations;
+
+			/* Area times the standard deviation, i.e. sqrt(area * squared deviations) */
+			double m_WeightedStd;
+		};
+
+		/* Value of the pixel of a node which has not absorbed any neighbor */
+		std::vector<TValue> m_PixelValue;
+
+		/* Statistics of the bands of a node which has absorbed neighbors (empty otherwise) */
+		std::vector<BandStatistics> m_Bands;
+
+		SumType GetSpectralSum(const unsigned int b) const
+		{
+			return m_Bands.empty() ? static_cast<SumType>(m_PixelValue[b]) : m_Bands[b].m_SpectralSum;
+		}
+
+		double GetSquaredDeviations(const unsigned int b) const
+		{
+			return m_Bands.empty() ? 0.0 : m_Bands[b].m_SquaredDeviations;
+		}
+
+		double GetWeightedStd(const unsigned int b) const
+		{
+			return m_Bands.empty() ? 0.0 : m_Bands[b].m_WeightedStd;
+		}
 	};
 
 	struct BaatzParam
@@ -36,24 +75,45 @@ namespace grm
 	};
 	
 	template<class TImage>
-	class BaatzSegmenter : public Segmenter< TImage, BaatzNode, BaatzParam>
+	class BaatzSegmenter : public Segmenter< TImage, BaatzNode<typename TImage::InternalPixelType>, BaatzParam>
 	{
 	public:
 
 		/* Some convenient typedefs */
-		typedef Segmenter<TImage, BaatzNode, BaatzParam> Superclass;
+		typedef BaatzNode<typename TImage::InternalPixelType> NodeType;
+		typedef Segmenter<TImage, NodeType, BaatzParam> Superclass;
 		typedef TImage ImageType;
 		typedef BaatzParam ParameterType;
 		typedef typename Superclass::GraphType GraphType;
-		typedef BaatzNode NodeType;
 		typedef typename Superclass::EdgeType EdgeType;
 		typedef typename Superclass::NodePointerType NodePointerType;
 		typedef typename Superclass::GraphOperatorType GraphOperatorType;
 		typedef GraphToOtbImage<GraphType> IOType;
 
 		float ComputeMergingCost(NodePointerType n1, NodePointerType n2);
+		void ComputeMergingCosts(NodePointerType r, EdgeType * const * edges, const std::size_t n, float * costs, const float bound);
 		void UpdateSpecificAttributes(NodePointerType n1, NodePointerType n2);
 		void InitFromImage();
+		std::size_t EstimateAttributesMemoryUsage(const unsigned int numberOfComponents)
+		{
+			// The statistics of about one region per two pixels formed by the first iterations
+			return GetHeapBlockSize(numberOfComponents * sizeof(typename ImageType::InternalPixelType)) +
+				GetHeapBlockSize(numberOfComponents * sizeof(typename NodeType::BandStatistics)) / 2;
+		}
+		void WriteAttributes(GraphBuffer& buffer, NodePointerType n);
+		void ReadAttributes(GraphBuffer& buffer, NodePointerType n);
+		void GetMeans(NodePointerType n, float * means);
+
+	private:
+
+		/* Sum of the squared deviations of a band of the union of two regions */
+		static double MergeSquaredDeviations(NodePointerType n1, NodePointerType n2, const unsigned int b);
+
+		/* Adds the shape cost to the spectral cost of a merge when the latter is below the threshold */
+		float AddShapeCost(NodePointerType n1, NodePointerType n2, const unsigned int boundary, float spect_cost);
+
+		/* Number of bands whose square roots are computed together by ComputeMergingCosts */
+		static const unsigned int BandBlockSize = 4;
 	};
 } // end of namespace grm
 #include "grmBaatzSegmenter.txx"
@@ -28,58 +28,88 @@ namespace grm
 	void
 	BaatzSegmenter<TImage>::InitFromImage()
 	{
-		typedef itk::ImageRegionIterator<TImage> ImageIterator;
+		typedef typename TImage::PixelType PixelType;
 
 		this->m_ImageWidth = this->m_InputImage->GetLargestPossibleRegion().GetSize()[0];
 		this->m_ImageHeight =this->m_InputImage->GetLargestPossibleRegion().GetSize()[1];
 		this->m_NumberOfComponentsPerPixel = this->m_InputImage->GetNumberOfComponentsPerPixel();
 
-		std::size_t idx = 0;
-		ImageIterator it(this->m_InputImage, this->m_InputImage->GetLargestPossibleRegion());
-		for(it.GoToBegin(); !it.IsAtEnd(); ++it)
-		{
-			this->m_Graph.m_Nodes[idx]->m_Means.reserve(this->m_NumberOfComponentsPerPixel);
-			this->m_Graph.m_Nodes[idx]->m_SquareMeans.reserve(this->m_NumberOfComponentsPerPixel);
-			this->m_Graph.m_Nodes[idx]->m_SpectralSum.reserve(this->m_NumberOfComponentsPerPixel);
-			this->m_Graph.m_Nodes[idx]->m_Std.assign(this->m_NumberOfComponentsPerPixel, 0.0f);
-
-			for(std::size_t b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+		this->ForEachValidPixel([&](const std::size_t idx, const PixelType& pixel)
 			{
-				this->m_Graph.m_Nodes[idx]->m_Means.push_back(it.Get()[b]);
-				this->m_Graph.m_Nodes[idx]->m_SquareMeans.push_back((it.Get()[b])*(it.Get()[b]));
-				this->m_Graph.m_Nodes[idx]->m_SpectralSum.push_back(it.Get()[b]);
-			}	
-			++idx;
-		}
+				auto& n = this->m_Graph.m_Nodes[idx];
+				n->m_PixelValue.resize(this->m_NumberOfComponentsPerPixel);
+				for(std::size_t b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+					n->m_PixelValue[b] = pixel[b];
+				this->InitFeatures(idx, pixel);
+			});
 	}
 
 	template<class TImage>
 	float
 	BaatzSegmenter<TImage>::ComputeMergingCost(NodePointerType n1, NodePointerType n2)
 	{
-		const unsigned int a1 = n1->m_Area, a2 = n2->m_Area, a_sum = a1 + a2;
+		EdgeType * edge = &(*GraphOperatorType::FindEdge(n1, n2));
+		float cost;
+		ComputeMergingCosts(n1, &edge, 1, &cost, std::numeric_limits<float>::max());
+		return cost;
+	}
 
-		float spect_cost = 0.0f;
-		float mean, square_mean, sum, std;
+	template<class TImage>
+	void
+	BaatzSegmenter<TImage>::ComputeMergingCosts(NodePointerType r,
+												EdgeType * const * edges,
+												const std::size_t n,
+												float * costs,
+												const float bound)
+	{
+		const unsigned int bands = this->m_NumberOfComponentsPerPixel;
 
-		for (unsigned int b = 0; b < this->m_NumberOfComponentsPerPixel; b++)
+		// A spectral cost not below the threshold is the merging cost, which
+		// then is not below the bound either: the evaluation stops there.
+		const float spectralBound = std::max(bound, this->m_Threshold);
+
+		for(std::size_t i = 0; i < n; ++i)
 		{
-			mean = ((a1 * n1->m_Means[b]) + (a2 * n2->m_Means[b])) / a_sum;
-			square_mean = n1->m_SquareMeans[b] + n2->m_SquareMeans[b];
-			sum = n1->m_SpectralSum[b] + n2->m_SpectralSum[b];
-			std = std::sqrt((square_mean - 2*mean*sum + a_sum * mean* mean) / a_sum);
-			spect_cost += (a_sum * std - a1 * n1->m_Std[b] - a2 * n2->m_Std[b]);
+			NodePointerType neighbor = edges[i]->GetRegion();
+			const double a_sum = static_cast<double>(r->m_Area) + static_cast<double>(neighbor->m_Area);
+			double spect_cost = 0.0;
+			float weighted_spect_cost = 0.0f;
+
+			// The square roots of a block of bands are computed in one loop
+			// without dependencies, which the compiler vectorizes, and the
+			// bound is checked after each block.
+			double mergedWeightedStd[BandBlockSize];
+			for(unsigned int first = 0; first < bands; first += BandBlockSize)
+			{
+				const unsigned int last = std::min(first + BandBlockSize, bands);
+				for(unsigned int b = first; b < last; ++b)
+					mergedWeightedStd[b - first] = a_sum * MergeSquaredDeviations(r, neighbor, b);
+				for(unsigned int k = 0; k < last - first; ++k)
+					mergedWeightedStd[k] = std::sqrt(mergedWeightedStd[k]);
+				for(unsigned int b = first; b < last; ++b)
+					spect_cost += mergedWeightedStd[b - first] - r->GetWeightedStd(b) - neighbor->GetWeightedStd(b);
+
+				weighted_spect_cost = this->m_Param.m_SpectralWeight * static_cast<float>(spect_cost);
+				if(weighted_spect_cost >= spectralBound)
+					break;
+			}
+
+			costs[i] = AddShapeCost(r, neighbor, edges[i]->m_Boundary, weighted_spect_cost);
 		}
-		spect_cost *= this->m_Param.m_SpectralWeight;
+	}
 
+	template<class TImage>
+	float
+	BaatzSegmenter<TImage>::AddShapeCost(NodePointerType n1, NodePointerType n2, const unsigned int boundary, float spect_cost)
+	{
 		if(spect_cost < this->m_Threshold)
 		{
+			const unsigned int a1 = n1->m_Area, a2 = n2->m_Area, a_sum = a1 + a2;
 			float shape_cost, smooth_f, compact_f;
 
  			// Compute the shape merging cost
 			const float p1 = static_cast<float>(n1->m_Perimeter);
 			const float p2 = static_cast<float>(n2->m_Perimeter);
-			const unsigned int boundary = (GraphOperatorType::FindEdge(n1, n2))->m_Boundary;
 			const float p3 = p1 + p2 - 2 * static_cast<float>(boundary);
 			
 			const lp::BoundingBox merged_bbox = lp::ContourOperations::MergeBoundingBoxes(n1->m_Bbox, n2->m_Bbox);
@@ -102,19 +132,62 @@ namespace grm
 	void
 	BaatzSegmenter<TImage>::UpdateSpecificAttributes(NodePointerType n1, NodePointerType n2)
 	{
-		const float a1 = static_cast<float>(n1->m_Area);
-		const float a2 = static_cast<float>(n2->m_Area);
-		const float a_sum = a1 + a2;
+		const double a_sum = static_cast<double>(n1->m_Area) + static_cast<double>(n2->m_Area);
+
+		// The statistics of a pixel are built at its first merge.
+		if(n1->m_Bands.empty())
+		{
+			n1->m_Bands.resize(this->m_NumberOfComponentsPerPixel);
+			for(unsigned int b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+				n1->m_Bands[b] = {static_cast<typename NodeType::SumType>(n1->m_PixelValue[b]), 0.0, 0.0};
+			std::vector<typename ImageType::InternalPixelType>().swap(n1->m_PixelValue);
+		}
 
 		for(unsigned int b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
 		{
-			n1->m_Means[b] = (a1 * n1->m_Means[b] + a2 * n2->m_Means[b]) / a_sum;
-			n1->m_SquareMeans[b] += n2->m_SquareMeans[b];
-			n1->m_SpectralSum[b] += n2->m_SpectralSum[b];
-			n1->m_Std[b] = std::sqrt((n1->m_SquareMeans[b] - 2 * n1->m_Means[b] * n1->m_SpectralSum[b] +
-									  a_sum * n1->m_Means[b] * n1->m_Means[b]) / a_sum);
+			// The deviations are combined before the sums, which give the means of n1 and n2.
+			auto& band = n1->m_Bands[b];
+			band.m_SquaredDeviations = MergeSquaredDeviations(n1, n2, b);
+			band.m_SpectralSum += n2->GetSpectralSum(b);
+			band.m_WeightedStd = std::sqrt(a_sum * band.m_SquaredDeviations);
 		}
 	}
+
+	template<class TImage>
+	double
+	BaatzSegmenter<TImage>::MergeSquaredDeviations(NodePointerType n1, NodePointerType n2, const unsigned int b)
+	{
+		// Pairwise combination (Chan et al.): only the difference of the
+		// means is squared, hence no cancellation and a non negative result.
+		const double a1 = static_cast<double>(n1->m_Area);
+		const double a2 = static_cast<double>(n2->m_Area);
+		const double delta = static_cast<double>(n2->GetSpectralSum(b)) / a2 - static_cast<double>(n1->GetSpectralSum(b)) / a1;
+		return n1->GetSquaredDeviations(b) + n2->GetSquaredDeviations(b) + delta * delta * a1 * a2 / (a1 + a2);
+	}
+
+	template<class TImage>
+	void
+	BaatzSegmenter<TImage>::WriteAttributes(GraphBuffer& buffer, NodePointerType n)
+	{
+		buffer.Write(n->m_PixelValue);
+		buffer.Write(n->m_Bands);
+	}
+
+	template<class TImage>
+	void
+	BaatzSegmenter<TImage>::ReadAttributes(GraphBuffer& buffer, NodePointerType n)
+	{
+		buffer.Read(n->m_PixelValue);
+		buffer.Read(n->m_Bands);
+	}
+
+	template<class TImage>
+	void
+	BaatzSegmenter<TImage>::GetMeans(NodePointerType n, float * means)
+	{
+		for(unsigned int b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+			means[b] = static_cast<double>(n->GetSpectralSum(b)) / n->m_Area;
+	}
 } // end of namespace grm
 
 #endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_COMMUNICATOR_H
+#define GRM_COMMUNICATOR_H
+#include <vector>
+
+namespace grm
+{
+	/*
+	 * Processes of a distributed segmentation: the MPI processes when the
+	 * library is built with GRM_USE_MPI, a single process otherwise or
+	 * with the default constructor. The messages are byte buffers of any
+	 * size.
+	 */
+	class Communicator
+	{
+	public:
+
+		/* Initializes MPI with the arguments of main if it is not already */
+		Communicator(int * argc, char *** argv);
+
+		/*
+		 * Single process which never calls MPI, even in a build with MPI:
+		 * for instance in an application which a process may run again.
+		 */
+		Communicator();
+
+		/* Finalizes MPI if it has been initialized by the constructor */
+		~Communicator();
+
+		Communicator(const Communicator&) = delete;
+		Communicator& operator=(const Communicator&) = delete;
+
+		/* Rank of this process, between 0 and GetSize() - 1 */
+		int GetRank() const { return m_Rank; }
+
+		/* Number of processes */
+		int GetSize() const { return m_Size; }
+
+		/* True if the library is built with MPI */
+		static bool IsMPIEnabled();
+
+		/* Blocking point-to-point exchange of a buffer */
+		void Send(const std::vector<char>& data, const int destination);
+		void Receive(std::vector<char>& data, const int source);
+
+		/* The buffer of the root process is copied to all the processes */
+		void Broadcast(std::vector<char>& data, const int root);
+
+		void Barrier();
+
+		/* Terminates all the processes after an error on one of them */
+		void Abort(const int errorCode);
+
+	private:
+
+		int m_Rank;
+		int m_Size;
+
+		/* The processes are the ones of MPI (false for a single process) */
+		bool m_UseMPI;
+
+		/* MPI has been initialized by this communicator */
+		bool m_Finalize;
+	};
+
+} // end of namespace grm
+#endif
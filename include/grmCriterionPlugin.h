@@ -0,0 +1,123 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_CRITERION_PLUGIN_H
+#define GRM_CRITERION_PLUGIN_H
+#include <stddef.h>
+
+/*
+ * Binary interface of the criteria loaded at runtime. It only uses C types
+ * so that a plugin does not depend on the compiler, the standard library
+ * or the version of the module it is built with.
+ *
+ * A plugin is a shared library exporting the entry point
+ *
+ *   extern "C" void GRMRegisterCriteria(GRMRegisterCriterionFunction registerCriterion,
+ *                                       void * registry);
+ *
+ * which calls registerCriterion(registry, &criterion) for each of its
+ * criteria. The criterion descriptions must outlive the library.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented at each incompatible change of the structures below */
+#define GRM_CRITERION_PLUGIN_ABI_VERSION 1
+
+/* Name of the entry point of a plugin library */
+#define GRM_CRITERION_PLUGIN_ENTRY_POINT "GRMRegisterCriteria"
+
+/* Region given to the kernels of a criterion */
+typedef struct GRMPluginRegion
+{
+	/* Attributes of the region, laid out by the criterion */
+	double * m_Attributes;
+
+	/* Number of pixels and perimeter of the region */
+	unsigned int m_Area;
+	unsigned int m_Perimeter;
+
+	/* Bounding box of the region: upper left corner, width and height */
+	unsigned int m_UX;
+	unsigned int m_UY;
+	unsigned int m_W;
+	unsigned int m_H;
+} GRMPluginRegion;
+
+/* Description and kernels of a criterion */
+typedef struct GRMCriterionPlugin
+{
+	/* GRM_CRITERION_PLUGIN_ABI_VERSION of the plugin */
+	unsigned int m_AbiVersion;
+
+	/* Name of the criterion (the value of the criterion parameter) and description */
+	const char * m_Name;
+	const char * m_Description;
+
+	/*
+	 * Parse the parameters of the criterion ("key=value" pairs separated
+	 * by spaces, possibly empty) for an image of numberOfBands bands and
+	 * return its state, or NULL if they are invalid.
+	 */
+	void * (*m_CreateContext)(const char * parameters, unsigned int numberOfBands);
+	void (*m_DestroyContext)(void * context);
+
+	/* Number of attributes (double values) of a region */
+	unsigned int (*m_GetNumberOfAttributes)(const void * context);
+
+	/*
+	 * Initialize the attributes of n regions made of one pixel each:
+	 * pixels holds n pixels of numberOfBands values and attributes
+	 * n blocks of numberOfAttributes values.
+	 */
+	void (*m_InitAttributes)(const void * context, const float * pixels, size_t n, double * attributes);
+
+	/*
+	 * Compute the merging costs between a region and n of its neighbors,
+	 * sharing boundaries[i] pixel sides with it.
+	 */
+	void (*m_ComputeMergingCosts)(const void * context,
+								  const GRMPluginRegion * region,
+								  const GRMPluginRegion * neighbors,
+								  const unsigned int * boundaries,
+								  size_t n,
+								  float * costs);
+
+	/*
+	 * Merge the attributes of region b into the ones of region a, sharing
+	 * boundary pixel sides. The area, perimeter and bounding box of both
+	 * regions are the ones before the merge.
+	 */
+	void (*m_MergeAttributes)(const void * context,
+							  GRMPluginRegion * a,
+							  const GRMPluginRegion * b,
+							  unsigned int boundary);
+} GRMCriterionPlugin;
+
+/* Function given to the entry point to register a criterion */
+typedef void (*GRMRegisterCriterionFunction)(void * registry, const GRMCriterionPlugin * criterion);
+
+/* Type of the entry point */
+typedef void (*GRMRegisterCriteriaFunction)(GRMRegisterCriterionFunction registerCriterion, void * registry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
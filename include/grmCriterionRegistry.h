@@ -0,0 +1,66 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_CRITERION_REGISTRY_H
+#define GRM_CRITERION_REGISTRY_H
+#include "grmCriterionPlugin.h"
+#include <string>
+#include <vector>
+
+namespace grm
+{
+	/*
+	 * Criteria registered by the plugin libraries. The libraries stay
+	 * loaded as long as the registry exists.
+	 */
+	class CriterionRegistry
+	{
+	public:
+
+		/* Environment variable listing the plugin directories (separated by ':') */
+		static const char * const PluginPathVariable;
+
+		CriterionRegistry() {}
+		CriterionRegistry(const CriterionRegistry&) = delete;
+		CriterionRegistry& operator=(const CriterionRegistry&) = delete;
+		~CriterionRegistry();
+
+		/* Add a criterion: its ABI version must match and its name be new */
+		void Register(const GRMCriterionPlugin * criterion);
+
+		/* Load a plugin library and register its criteria */
+		void LoadLibrary(const std::string& fileName);
+
+		/* Load the plugin libraries (*.so, *.dylib) of a directory */
+		void LoadDirectory(const std::string& directory);
+
+		/* Load the plugin libraries of the directories listed in PluginPathVariable */
+		void LoadFromEnvironment();
+
+		/* Criterion of the given name (null if there is none) */
+		const GRMCriterionPlugin * Find(const std::string& name) const;
+
+		const std::vector<const GRMCriterionPlugin *>& GetCriteria() const { return m_Criteria; }
+
+	private:
+
+		std::vector<const GRMCriterionPlugin *> m_Criteria;
+		std::vector<void *> m_Libraries;
+	};
+
+} // end of namespace grm
+#endif
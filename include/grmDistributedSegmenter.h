@@ -0,0 +1,258 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_DISTRIBUTED_SEGMENTER_H
+#define GRM_DISTRIBUTED_SEGMENTER_H
+#include <itkRegionOfInterestImageFilter.h>
+#include "grmCommunicator.h"
+#include "grmGraphBuffer.h"
+#include "grmMacroGenerator.h"
+#include "grmStatistics.h"
+#include "lpContour.h"
+#include <functional>
+#include <vector>
+
+namespace grm
+{
+	/*
+	 * Region merging segmentation of an image distributed over the
+	 * processes of a communicator.
+	 *
+	 * The image is cut into tiles and each process segments the tiles of
+	 * a band of rows. The nodes along the sides shared with other tiles
+	 * are frozen: they stay single pixels, so that the graphs of adjacent
+	 * tiles are stitched by connecting their border pixels. The bands
+	 * are merged pairwise (process r receives from process r + step, for
+	 * step = 1, 2, 4...) and the merging iterations go on after each
+	 * stitching. Only the regions which may still merge are sent: the
+	 * frozen pixels and the regions within the stability margin (in
+	 * number of edges) of them. The other regions are final and stay on
+	 * their process (the small ones are merged among them first), so
+	 * that the graph of the whole image is never gathered.
+	 * The final regions are then sent back the same way, each process
+	 * keeping the ones which intersect its band, and numbered by id along
+	 * the processes: the label of a region is the same in every tile.
+	 *
+	 * The tiles only approximate the segmentation of the whole image: the
+	 * regions along the tile borders grow later than the other ones.
+	 *
+	 * If the size of the tiles is not set, it is chosen from the memory
+	 * budget: the largest square tiles whose segmentation is estimated
+	 * (see Segmenter::EstimateMemoryUsage) to take at most half of the
+	 * budget, the other half being left to the stitched graph. The size
+	 * of the stitched graph depends on the number of regions left by
+	 * the merging of the tiles: it is checked against the budget each
+	 * time it grows.
+	 */
+	template<class TSegmenter>
+	class DistributedSegmenter
+	{
+	public:
+
+		/* Some convenient typedefs */
+		typedef TSegmenter SegmenterType;
+		typedef typename SegmenterType::ImageType ImageType;
+		typedef typename SegmenterType::MaskImageType MaskImageType;
+		typedef typename SegmenterType::LabelImageType LabelImageType;
+		typedef typename SegmenterType::GlobalLabelImageType GlobalLabelImageType;
+		typedef typename SegmenterType::GraphOperatorType GraphOperatorType;
+		typedef typename GraphOperatorType::NodePointerType NodePointerType;
+		typedef typename SegmenterType::IOType IOType;
+		typedef itk::RegionOfInterestImageFilter<ImageType, ImageType> ExtractFilterType;
+		typedef itk::RegionOfInterestImageFilter<MaskImageType, MaskImageType> MaskExtractFilterType;
+
+		/* Function setting the parameters of the segmenters (criterion, threshold...) */
+		typedef std::function<void(SegmenterType&)> ConfigureFunctionType;
+
+		DistributedSegmenter(Communicator& communicator) :
+			m_Communicator(communicator), m_InputImage(nullptr),
+			m_TileWidth(0), m_TileHeight(0), m_ImageWidth(0), m_ImageHeight(0),
+			m_MinimumRegionSize(0), m_MemoryBudget(0), m_StabilityMargin(DefaultStabilityMargin), m_NumberOfRegions(0) {}
+
+		/*
+		 * This method segments the tiles of this process and takes part in
+		 * the stitching of the graphs. It has to be called by all the
+		 * processes of the communicator.
+		 */
+		void Update();
+
+		/*
+		 * Given a tile of this process, this method returns its label
+		 * image (label 0 for the masked pixels), georeferenced as the
+		 * corresponding area of the input image.
+		 */
+		typename LabelImageType::Pointer GetTileLabelImage(const lp::BoundingBox& tile);
+
+		/*
+		 * Same as GetTileLabelImage with the global ids of the regions
+		 * plus 1 as labels: the index of their first pixel in the image.
+		 */
+		typename GlobalLabelImageType::Pointer GetTileGlobalIdImage(const lp::BoundingBox& tile);
+
+		/* Number of regions of the whole image */
+		std::size_t GetNumberOfRegions() { return m_NumberOfRegions; }
+
+		/* Set methods */
+		GRMSetMacro(unsigned int, TileWidth);
+		GRMSetMacro(unsigned int, TileHeight);
+		GRMSetMacro(ConfigureFunctionType, ConfigureFunction);
+		GRMSetMacro(std::size_t, MemoryBudget);
+		GRMSetMacro(unsigned int, StabilityMargin);
+		inline void SetInput(ImageType * in){ m_InputImage = in;}
+		inline void SetMask(MaskImageType * mask){ m_Mask = mask;}
+
+		/* Get methods */
+		GRMGetMacro(unsigned int, TileWidth);
+		GRMGetMacro(unsigned int, TileHeight);
+		GRMGetMacro(std::size_t, MemoryBudget);
+		GRMGetMacro(unsigned int, StabilityMargin);
+
+		/* Tiles of the image segmented by this process (set by Update) */
+		GRMGetRefMacro(std::vector<lp::BoundingBox>, Tiles);
+
+		/*
+		 * Segmenter holding the regions which intersect the band of this
+		 * process after Update (the whole image with a single process),
+		 * sorted by id. Only the edges between regions merged on the
+		 * same process are kept.
+		 */
+		GRMGetRefMacro(SegmenterType, Segmenter);
+
+	private:
+
+		/* Stability margin by default: the regions beyond it seldom merge again */
+		static const unsigned int DefaultStabilityMargin = 5;
+
+		/* Smallest size of the tiles chosen from the memory budget */
+		static const unsigned int MinimumTileSize = 64;
+
+		/*
+		 * Sets the size of the tiles to the largest square tiles whose
+		 * segmentation fits in half of the memory budget.
+		 */
+		void ChooseTileSize();
+
+		/*
+		 * Throws if the peak memory of the process since the start of
+		 * Update exceeds the memory budget (if any).
+		 */
+		void CheckMemoryBudget(const std::size_t initialMemoryUsage) const;
+
+		/* First row of tiles of a process: the rows are shared evenly */
+		unsigned int GetFirstRowOfTiles(const int rank) const;
+
+		/* Area of the image covered by the tiles of the processes [firstRank, lastRank) */
+		lp::BoundingBox GetArea(const int firstRank, const int lastRank) const;
+
+		/* Sides of an area which are shared with the rest of the image */
+		unsigned int GetInteriorSides(const lp::BoundingBox& area) const;
+
+		/*
+		 * Fills the label image of a tile with the given labels of the
+		 * regions and georeferences it.
+		 */
+		template<class TLabelImage>
+		typename TLabelImage::Pointer
+		GetTileImage(const lp::BoundingBox& tile, const std::vector<typename TLabelImage::PixelType>& labels);
+
+		/*
+		 * Bitmap of the valid pixels of the area of this process (empty:
+		 * all). With a single process it is the one of the segmenter of
+		 * the whole image, whose outputs use it.
+		 */
+		std::vector<bool>& GetValidPixelsOfArea();
+
+		/* Applies the configuration function to a segmenter */
+		void Configure(SegmenterType& seg);
+
+		/*
+		 * Segments a tile and writes its graph in the coordinates of the
+		 * image, and copies the validity of its pixels into the bitmap of
+		 * the area of this process. Returns the statistics of the
+		 * segmentation of the tile.
+		 */
+		SegmentationStatistics SegmentTile(const lp::BoundingBox& tile, GraphBuffer& buffer);
+
+		/*
+		 * Sends the regions of the graph which may still merge (the
+		 * frozen ones and their neighbors) to a process and removes them:
+		 * the other regions are final.
+		 */
+		void SendBorderRegions(const int destination);
+
+		/*
+		 * Steps of the reduction in reverse order: each process gets back
+		 * the final regions which intersect its band.
+		 */
+		void DistributeRegions();
+
+		/*
+		 * Numbers the regions by id across the processes and sets the
+		 * labels of the regions of this process and the number of regions.
+		 */
+		void ComputeLabels();
+
+		/* Whether a bounding box intersects a non-empty area */
+		static bool Intersects(const lp::BoundingBox& bbox, const lp::BoundingBox& area);
+
+		/*
+		 * Connects the graphs read into the segmenter, which cover the
+		 * given area, and goes on with the merging iterations.
+		 */
+		void Stitch(const lp::BoundingBox& area, const bool last);
+
+		template<class TInputImage>
+		typename itk::RegionOfInterestImageFilter<TInputImage, TInputImage>::Pointer
+		ExtractTile(TInputImage * img, const lp::BoundingBox& tile);
+
+		Communicator& m_Communicator;
+
+		/* Input image and optional mask of the whole image */
+		ImageType * m_InputImage;
+		typename MaskImageType::Pointer m_Mask;
+
+		/* Size of the tiles (the last ones of a row or a column may be smaller) */
+		unsigned int m_TileWidth;
+		unsigned int m_TileHeight;
+
+		ConfigureFunctionType m_ConfigureFunction;
+
+		unsigned int m_ImageWidth;
+		unsigned int m_ImageHeight;
+
+		/* The small regions are only merged once the graph of the whole image is stitched */
+		unsigned int m_MinimumRegionSize;
+
+		/* Memory (in bytes) from which the size of the tiles is chosen if it is not set (0: none) */
+		std::size_t m_MemoryBudget;
+
+		std::vector<lp::BoundingBox> m_Tiles;
+		SegmenterType m_Segmenter;
+
+		/* Validity of the pixels of the area of this process, with several processes */
+		std::vector<bool> m_ValidPixels;
+
+		/* Distance (in number of edges) to the frozen regions of the regions sent to the next step */
+		unsigned int m_StabilityMargin;
+
+		/* Labels of the regions of m_Segmenter and number of regions of the whole image */
+		std::vector<typename LabelImageType::PixelType> m_Labels;
+		std::size_t m_NumberOfRegions;
+	};
+} // end of namespace grm
+#include "grmDistributedSegmenter.txx"
+#endif
@@ -0,0 +1,547 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_DISTRIBUTED_SEGMENTER_TXX
+#define GRM_DISTRIBUTED_SEGMENTER_TXX
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "grmDistributedSegmenter.h"
+#include "grmMemoryUsage.h"
+
+namespace grm
+{
+	template<class TSegmenter>
+	void
+	DistributedSegmenter<TSegmenter>::Update()
+	{
+		if(m_InputImage == nullptr)
+			throw std::runtime_error("DistributedSegmenter::Update - No input image is set");
+		if((m_TileWidth == 0 || m_TileHeight == 0) && m_MemoryBudget == 0)
+			throw std::runtime_error("DistributedSegmenter::Update - The size of the tiles is not set");
+
+		ResetPeakMemoryUsage();
+		const std::size_t initialMemoryUsage = GetCurrentMemoryUsage();
+
+		m_InputImage->UpdateOutputInformation();
+		m_ImageWidth = m_InputImage->GetLargestPossibleRegion().GetSize()[0];
+		m_ImageHeight = m_InputImage->GetLargestPossibleRegion().GetSize()[1];
+		if(m_TileWidth == 0 || m_TileHeight == 0)
+			ChooseTileSize();
+
+		const int rank = m_Communicator.GetRank();
+		const int size = m_Communicator.GetSize();
+
+		m_Tiles.clear();
+		for(unsigned int row = GetFirstRowOfTiles(rank); row < GetFirstRowOfTiles(rank + 1); ++row)
+		{
+			for(unsigned int x = 0; x < m_ImageWidth; x += m_TileWidth)
+			{
+				const unsigned int y = row * m_TileHeight;
+				const lp::BoundingBox tile = {x, y, std::min(m_TileWidth, m_ImageWidth - x), std::min(m_TileHeight, m_ImageHeight - y)};
+				m_Tiles.push_back(tile);
+			}
+		}
+
+		// The graph of the tiles is expressed in the coordinates of the image.
+		m_Segmenter.m_Graph.Clear();
+		m_Segmenter.GetValidPixels().clear();
+		m_ValidPixels.clear();
+		Configure(m_Segmenter);
+		m_MinimumRegionSize = m_Segmenter.GetMinimumRegionSize();
+		m_Segmenter.SetMinimumRegionSize(0);
+		m_Segmenter.SetImageWidth(m_ImageWidth);
+		m_Segmenter.SetImageHeight(m_ImageHeight);
+		m_Segmenter.SetNumberOfComponentsPerPixel(m_InputImage->GetNumberOfComponentsPerPixel());
+		// The outputs of the segmenter of the whole image reset its masked
+		// pixels (with the bitmap of the tiles if there is a single process).
+		m_Segmenter.SetInput(m_InputImage);
+		m_Segmenter.SetMask(m_Mask.GetPointer());
+		m_Segmenter.GetFeatureAccumulators().SetNumberOfComponentsPerPixel(m_InputImage->GetNumberOfComponentsPerPixel());
+		m_Segmenter.GetStatistics().Clear();
+		m_Segmenter.GetStatistics().m_InitialMemoryUsage = initialMemoryUsage;
+
+		// The segmentation of a tile resets the peak memory: the peak of
+		// the whole run is the largest one of the tiles and the stitching.
+		std::size_t peakMemoryUsage = 0;
+		GraphBuffer buffer;
+		for(auto& tile : m_Tiles)
+		{
+			buffer.Clear();
+			const SegmentationStatistics stats = SegmentTile(tile, buffer);
+			peakMemoryUsage = std::max(peakMemoryUsage, stats.m_PeakMemoryUsage);
+			m_Segmenter.GetStatistics().m_EstimatedMemoryUsage = std::max(m_Segmenter.GetStatistics().m_EstimatedMemoryUsage,
+																		   stats.m_EstimatedMemoryUsage);
+			GraphOperatorType::ReadGraph(m_Segmenter, buffer);
+			CheckMemoryBudget(initialMemoryUsage);
+		}
+		Stitch(GetArea(rank, rank + 1), size == 1);
+		CheckMemoryBudget(initialMemoryUsage);
+
+		// Pairwise reduction of the borders of the graphs: after the round
+		// of a step, the process r (multiple of 2 * step) holds the regions
+		// of the processes [r, r + 2 * step) which may still merge, the
+		// other processes keep their final regions.
+		for(int step = 1; step < size; step *= 2)
+		{
+			if(rank % (2 * step) == step)
+			{
+				SendBorderRegions(rank - step);
+				break;
+			}
+			else if(rank % (2 * step) == 0 && rank + step < size)
+			{
+				buffer.Clear();
+				m_Communicator.Receive(buffer.GetData(), rank + step);
+				GraphOperatorType::ReadGraph(m_Segmenter, buffer);
+				CheckMemoryBudget(initialMemoryUsage);
+				Stitch(GetArea(rank, std::min(rank + 2 * step, size)), rank == 0 && 2 * step >= size);
+			}
+		}
+
+		if(size > 1)
+		{
+			DistributeRegions();
+			CheckMemoryBudget(initialMemoryUsage);
+		}
+
+		// The labels follow the ids of the regions, whatever the number of processes.
+		std::sort(m_Segmenter.m_Graph.m_Nodes.begin(), m_Segmenter.m_Graph.m_Nodes.end(),
+				  [](const NodePointerType& a, const NodePointerType& b)->bool{
+					  return a->m_Id < b->m_Id;
+				  });
+		ComputeLabels();
+
+		m_Segmenter.GetStatistics().m_PeakMemoryUsage = std::max(peakMemoryUsage, GetPeakMemoryUsage());
+	}
+
+	template<class TSegmenter>
+	void
+	DistributedSegmenter<TSegmenter>::ChooseTileSize()
+	{
+		SegmenterType seg;
+		Configure(seg);
+		const unsigned int numberOfComponents = m_InputImage->GetNumberOfComponentsPerPixel();
+		auto fits = [&](const unsigned int tileSize)->bool{
+			return seg.EstimateMemoryUsage(std::min(tileSize, m_ImageWidth), std::min(tileSize, m_ImageHeight),
+										   numberOfComponents) <= m_MemoryBudget / 2;
+		};
+
+		if(!fits(MinimumTileSize))
+		{
+			throw std::runtime_error("DistributedSegmenter::Update - The memory budget of " + std::to_string(m_MemoryBudget / (1024 * 1024)) +
+									 " MB is too small for tiles of " + std::to_string(MinimumTileSize) + " x " +
+									 std::to_string(MinimumTileSize) + " pixels");
+		}
+
+		// Largest size which fits, by bisection: fits(low) && !fits(high)
+		unsigned int low = MinimumTileSize;
+		unsigned int high = std::max(std::max(m_ImageWidth, m_ImageHeight), low) + 1;
+		while(high - low > 1)
+		{
+			const unsigned int middle = low + (high - low) / 2;
+			if(fits(middle))
+				low = middle;
+			else
+				high = middle;
+		}
+		m_TileWidth = low;
+		m_TileHeight = low;
+	}
+
+	template<class TSegmenter>
+	void
+	DistributedSegmenter<TSegmenter>::CheckMemoryBudget(const std::size_t initialMemoryUsage) const
+	{
+		// The peak covers the segmentation of the last tile and the merging iterations.
+		const std::size_t memoryUsage = GetPeakMemoryUsage();
+		if(m_MemoryBudget == 0 || memoryUsage <= initialMemoryUsage || memoryUsage - initialMemoryUsage <= m_MemoryBudget)
+			return;
+
+		throw std::runtime_error("DistributedSegmenter::Update - The stitched graph takes about " +
+								 std::to_string((memoryUsage - initialMemoryUsage) / (1024 * 1024) + 1) +
+								 " MB, more than the memory budget of " + std::to_string(m_MemoryBudget / (1024 * 1024)) +
+								 " MB: too many regions are left by the merging of the tiles (raise the budget, the threshold or the number of processes)");
+	}
+
+	template<class TSegmenter>
+	typename DistributedSegmenter<TSegmenter>::LabelImageType::Pointer
+	DistributedSegmenter<TSegmenter>::GetTileLabelImage(const lp::BoundingBox& tile)
+	{
+		return GetTileImage<LabelImageType>(tile, m_Labels);
+	}
+
+	template<class TSegmenter>
+	typename DistributedSegmenter<TSegmenter>::GlobalLabelImageType::Pointer
+	DistributedSegmenter<TSegmenter>::GetTileGlobalIdImage(const lp::BoundingBox& tile)
+	{
+		std::vector<typename GlobalLabelImageType::PixelType> labels;
+		labels.reserve(m_Segmenter.m_Graph.m_Nodes.size());
+		for(auto& node : m_Segmenter.m_Graph.m_Nodes)
+			labels.push_back(m_Segmenter.GetGlobalId(node) + 1);
+		return GetTileImage<GlobalLabelImageType>(tile, labels);
+	}
+
+	template<class TSegmenter>
+	template<class TLabelImage>
+	typename TLabelImage::Pointer
+	DistributedSegmenter<TSegmenter>::GetTileImage(const lp::BoundingBox& tile,
+												   const std::vector<typename TLabelImage::PixelType>& labels)
+	{
+		IOType io;
+		io.SetNumberOfThreads(m_Segmenter.GetNumberOfThreads());
+		auto labelImg = io.template GetTileLabelImage<TLabelImage>(m_Segmenter.m_Graph, m_ImageWidth, tile, labels);
+
+		auto extract = ExtractTile(m_InputImage, tile);
+		labelImg->SetProjectionRef(m_InputImage->GetProjectionRef());
+		labelImg->SetOrigin(extract->GetOutput()->GetOrigin());
+		labelImg->SetSpacing(extract->GetOutput()->GetSpacing());
+
+		// The filling cannot tell the masked pixels enclosed by a region from a hole.
+		const std::vector<bool>& valid = GetValidPixelsOfArea();
+		if(valid.empty())
+			return labelImg;
+
+		const lp::BoundingBox area = GetArea(m_Communicator.GetRank(), m_Communicator.GetRank() + 1);
+		if(tile.m_UY < area.m_UY || tile.m_UY + tile.m_H > area.m_UY + area.m_H || tile.m_UX + tile.m_W > m_ImageWidth)
+			throw std::runtime_error("DistributedSegmenter::GetTileImage - The tile is not segmented by this process");
+
+		typename TLabelImage::PixelType * pixels = labelImg->GetBufferPointer();
+		for(unsigned int y = 0; y < tile.m_H; ++y)
+		{
+			const std::size_t row = static_cast<std::size_t>(tile.m_UY + y - area.m_UY) * m_ImageWidth + tile.m_UX;
+			for(unsigned int x = 0; x < tile.m_W; ++x)
+			{
+				if(!valid[row + x])
+					pixels[static_cast<std::size_t>(y) * tile.m_W + x] = 0;
+			}
+		}
+
+		return labelImg;
+	}
+
+	template<class TSegmenter>
+	unsigned int
+	DistributedSegmenter<TSegmenter>::GetFirstRowOfTiles(const int rank) const
+	{
+		const uint64_t numberOfRows = (m_ImageHeight + m_TileHeight - 1) / m_TileHeight;
+		return static_cast<unsigned int>(numberOfRows * rank / m_Communicator.GetSize());
+	}
+
+	template<class TSegmenter>
+	lp::BoundingBox
+	DistributedSegmenter<TSegmenter>::GetArea(const int firstRank, const int lastRank) const
+	{
+		const unsigned int y0 = std::min(GetFirstRowOfTiles(firstRank) * m_TileHeight, m_ImageHeight);
+		const unsigned int y1 = std::min(GetFirstRowOfTiles(lastRank) * m_TileHeight, m_ImageHeight);
+		const lp::BoundingBox area = {0, y0, m_ImageWidth, y1 - y0};
+		return area;
+	}
+
+	template<class TSegmenter>
+	unsigned int
+	DistributedSegmenter<TSegmenter>::GetInteriorSides(const lp::BoundingBox& area) const
+	{
+		unsigned int sides = 0;
+		if(area.m_UY > 0)
+			sides |= TOP_SIDE;
+		if(area.m_UX + area.m_W < m_ImageWidth)
+			sides |= RIGHT_SIDE;
+		if(area.m_UY + area.m_H < m_ImageHeight)
+			sides |= BOTTOM_SIDE;
+		if(area.m_UX > 0)
+			sides |= LEFT_SIDE;
+		return sides;
+	}
+
+	template<class TSegmenter>
+	void
+	DistributedSegmenter<TSegmenter>::Configure(SegmenterType& seg)
+	{
+		if(m_ConfigureFunction)
+			m_ConfigureFunction(seg);
+	}
+
+	template<class TSegmenter>
+	SegmentationStatistics
+	DistributedSegmenter<TSegmenter>::SegmentTile(const lp::BoundingBox& tile, GraphBuffer& buffer)
+	{
+		SegmenterType seg;
+		Configure(seg);
+		seg.SetMinimumRegionSize(0);
+		seg.SetFrozenSides(GetInteriorSides(tile));
+
+		// The tile is read by strips from the input pipeline.
+		auto extract = ExtractTile(m_InputImage, tile);
+		seg.SetInput(extract->GetOutput());
+		typename MaskExtractFilterType::Pointer maskExtract;
+		if(m_Mask.IsNotNull())
+		{
+			maskExtract = ExtractTile(m_Mask.GetPointer(), tile);
+			seg.SetMask(maskExtract->GetOutput());
+		}
+
+		seg.Update();
+		GraphOperatorType::WriteGraph(seg, buffer, tile.m_UX, tile.m_UY, m_ImageWidth);
+
+		const std::vector<bool>& tileValid = seg.GetValidPixels();
+		if(!tileValid.empty())
+		{
+			const lp::BoundingBox area = GetArea(m_Communicator.GetRank(), m_Communicator.GetRank() + 1);
+			std::vector<bool>& valid = GetValidPixelsOfArea();
+			if(valid.empty())
+				valid.assign(static_cast<std::size_t>(area.m_W) * area.m_H, true);
+
+			for(unsigned int y = 0; y < tile.m_H; ++y)
+			{
+				const std::size_t row = static_cast<std::size_t>(tile.m_UY + y - area.m_UY) * m_ImageWidth + tile.m_UX;
+				for(unsigned int x = 0; x < tile.m_W; ++x)
+					valid[row + x] = tileValid[static_cast<std::size_t>(y) * tile.m_W + x];
+			}
+		}
+		return seg.GetStatistics();
+	}
+
+	template<class TSegmenter>
+	std::vector<bool>&
+	DistributedSegmenter<TSegmenter>::GetValidPixelsOfArea()
+	{
+		return (m_Communicator.GetSize() == 1) ? m_Segmenter.GetValidPixels() : m_ValidPixels;
+	}
+
+	template<class TSegmenter>
+	void
+	DistributedSegmenter<TSegmenter>::SendBorderRegions(const int destination)
+	{
+		// The regions which may still merge: the frozen border pixels and
+		// the regions within the stability margin of them.
+		std::unordered_set<NodePointerType> border;
+		std::vector<NodePointerType> neighbors;
+		for(auto& r : m_Segmenter.m_Graph.m_Nodes)
+		{
+			if(r->m_Frozen)
+				border.insert(r);
+		}
+
+		std::vector<NodePointerType> front(border.begin(), border.end());
+		for(unsigned int depth = 0; depth < m_StabilityMargin && !front.empty(); ++depth)
+		{
+			std::vector<NodePointerType> next;
+			for(auto& r : front)
+			{
+				for(auto& edge : r->m_Edges)
+				{
+					if(border.insert(edge.GetRegion()).second)
+						next.push_back(edge.GetRegion());
+				}
+			}
+			neighbors.insert(neighbors.end(), next.begin(), next.end());
+			front.swap(next);
+		}
+		auto isBorder = [&](const NodePointerType& r)->bool{ return border.count(r) > 0; };
+
+		// The other regions are final: the small ones are merged among
+		// them, the border regions being frozen meanwhile.
+		if(m_MinimumRegionSize > 1)
+		{
+			for(auto& r : neighbors)
+				r->m_Frozen = true;
+			GraphOperatorType::MergeSmallRegions(m_Segmenter, m_MinimumRegionSize);
+			for(auto& r : neighbors)
+				r->m_Frozen = false;
+		}
+
+		GraphBuffer buffer;
+		GraphOperatorType::WriteGraph(m_Segmenter, buffer, 0, 0, m_ImageWidth, isBorder);
+		GraphOperatorType::RemoveNodes(m_Segmenter.m_Graph, isBorder);
+		m_Communicator.Send(buffer.GetData(), destination);
+	}
+
+	template<class TSegmenter>
+	void
+	DistributedSegmenter<TSegmenter>::DistributeRegions()
+	{
+		const int rank = m_Communicator.GetRank();
+		const int size = m_Communicator.GetSize();
+
+		// The steps of the reduction in reverse order: a process receives
+		// from the one it sent its border regions to the regions
+		// intersecting the area it covered then, and sends to the processes
+		// it received from the regions intersecting theirs.
+		int step = 1;
+		while(2 * step < size)
+			step *= 2;
+
+		GraphBuffer buffer;
+		for(; step >= 1; step /= 2)
+		{
+			if(rank % (2 * step) == step)
+			{
+				buffer.Clear();
+				m_Communicator.Receive(buffer.GetData(), rank - step);
+				GraphOperatorType::ReadGraph(m_Segmenter, buffer);
+			}
+			else if(rank % (2 * step) == 0 && rank + step < size)
+			{
+				const lp::BoundingBox area = GetArea(rank + step, std::min(rank + 2 * step, size));
+				buffer.Clear();
+				GraphOperatorType::WriteGraph(m_Segmenter, buffer, 0, 0, m_ImageWidth, [&](const NodePointerType& r)->bool{
+						return Intersects(r->m_Bbox, area);
+					});
+				m_Communicator.Send(buffer.GetData(), rank + step);
+
+				const lp::BoundingBox ownArea = GetArea(rank, rank + step);
+				GraphOperatorType::RemoveNodes(m_Segmenter.m_Graph, [&](const NodePointerType& r)->bool{
+						return !Intersects(r->m_Bbox, ownArea);
+					});
+			}
+		}
+	}
+
+	template<class TSegmenter>
+	void
+	DistributedSegmenter<TSegmenter>::ComputeLabels()
+	{
+		typedef typename LabelImageType::PixelType LabelType;
+
+		const int rank = m_Communicator.GetRank();
+		const int size = m_Communicator.GetSize();
+		const lp::BoundingBox area = GetArea(rank, rank + 1);
+		const unsigned int bottom = area.m_UY + area.m_H;
+
+		// The regions are numbered by id: a process numbers the regions
+		// whose first row is in its area after the ones of the previous
+		// processes, which pass along their number and the labels of the
+		// regions extending below their area (id, label, last row).
+		uint64_t numberOfRegions = 0;
+		std::vector<uint64_t> ids;
+		std::vector<LabelType> labels;
+		std::vector<uint32_t> lastRows;
+		GraphBuffer buffer;
+		if(rank > 0)
+		{
+			m_Communicator.Receive(buffer.GetData(), rank - 1);
+			buffer.Read(numberOfRegions);
+			buffer.Read(ids);
+			buffer.Read(labels);
+			buffer.Read(lastRows);
+		}
+
+		std::unordered_map<uint64_t, LabelType> previousLabels;
+		for(std::size_t i = 0; i < ids.size(); ++i)
+			previousLabels[ids[i]] = labels[i];
+
+		std::vector<uint64_t> nextIds;
+		std::vector<LabelType> nextLabels;
+		std::vector<uint32_t> nextLastRows;
+		for(std::size_t i = 0; i < ids.size(); ++i)
+		{
+			if(lastRows[i] >= bottom)
+			{
+				nextIds.push_back(ids[i]);
+				nextLabels.push_back(labels[i]);
+				nextLastRows.push_back(lastRows[i]);
+			}
+		}
+
+		m_Labels.resize(m_Segmenter.m_Graph.m_Nodes.size());
+		for(std::size_t i = 0; i < m_Labels.size(); ++i)
+		{
+			const NodePointerType& r = m_Segmenter.m_Graph.m_Nodes[i];
+			if(r->m_Bbox.m_UY < area.m_UY)
+			{
+				auto label = previousLabels.find(r->m_Id);
+				if(label == previousLabels.end())
+					throw std::runtime_error("DistributedSegmenter::Update - The label of the region " + std::to_string(r->m_Id) + " is not received");
+				m_Labels[i] = label->second;
+				continue;
+			}
+
+			if(numberOfRegions == std::numeric_limits<LabelType>::max())
+				throw std::runtime_error("DistributedSegmenter::Update - Too many regions for the label image: use GetTileGlobalIdImage");
+			m_Labels[i] = static_cast<LabelType>(++numberOfRegions);
+			if(r->m_Bbox.m_UY + r->m_Bbox.m_H > bottom)
+			{
+				nextIds.push_back(r->m_Id);
+				nextLabels.push_back(m_Labels[i]);
+				nextLastRows.push_back(r->m_Bbox.m_UY + r->m_Bbox.m_H - 1);
+			}
+		}
+
+		if(rank + 1 < size)
+		{
+			buffer.Clear();
+			buffer.Write(numberOfRegions);
+			buffer.Write(nextIds);
+			buffer.Write(nextLabels);
+			buffer.Write(nextLastRows);
+			m_Communicator.Send(buffer.GetData(), rank + 1);
+		}
+
+		// The last process knows the number of regions of the whole image.
+		buffer.Clear();
+		if(rank == size - 1)
+			buffer.Write(numberOfRegions);
+		m_Communicator.Broadcast(buffer.GetData(), size - 1);
+		if(rank != size - 1)
+			buffer.Read(numberOfRegions);
+		m_NumberOfRegions = numberOfRegions;
+	}
+
+	template<class TSegmenter>
+	bool
+	DistributedSegmenter<TSegmenter>::Intersects(const lp::BoundingBox& bbox, const lp::BoundingBox& area)
+	{
+		return area.m_W > 0 && area.m_H > 0 &&
+			bbox.m_UX < area.m_UX + area.m_W && area.m_UX < bbox.m_UX + bbox.m_W &&
+			bbox.m_UY < area.m_UY + area.m_H && area.m_UY < bbox.m_UY + bbox.m_H;
+	}
+
+	template<class TSegmenter>
+	void
+	DistributedSegmenter<TSegmenter>::Stitch(const lp::BoundingBox& area, const bool last)
+	{
+		GraphOperatorType::StitchGraph(m_Segmenter);
+		GraphOperatorType::FreezeBorderNodes(m_Segmenter.m_Graph, area, GetInteriorSides(area));
+		if(last)
+			m_Segmenter.SetMinimumRegionSize(m_MinimumRegionSize);
+		m_Segmenter.MergeRegions();
+	}
+
+	template<class TSegmenter>
+	template<class TInputImage>
+	typename itk::RegionOfInterestImageFilter<TInputImage, TInputImage>::Pointer
+	DistributedSegmenter<TSegmenter>::ExtractTile(TInputImage * img, const lp::BoundingBox& tile)
+	{
+		img->UpdateOutputInformation();
+		typename TInputImage::RegionType region;
+		region.SetIndex(0, img->GetLargestPossibleRegion().GetIndex()[0] + tile.m_UX);
+		region.SetIndex(1, img->GetLargestPossibleRegion().GetIndex()[1] + tile.m_UY);
+		region.SetSize(0, tile.m_W);
+		region.SetSize(1, tile.m_H);
+
+		auto filter = itk::RegionOfInterestImageFilter<TInputImage, TInputImage>::New();
+		filter->SetInput(img);
+		filter->SetRegionOfInterest(region);
+		filter->UpdateOutputInformation();
+		return filter;
+	}
+} // end of namespace grm
+#endif
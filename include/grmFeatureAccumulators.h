@@ -0,0 +1,166 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_FEATURE_ACCUMULATORS_H
+#define GRM_FEATURE_ACCUMULATORS_H
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace grm
+{
+	/*
+	 * Feature of the segments computed along the segmentation. The state of
+	 * a segment is a fixed number of values stored with its node: it is
+	 * initialized from the pixel of the initial node and combined when two
+	 * nodes merge, so that no second pass over the image is needed.
+	 */
+	class FeatureAccumulator
+	{
+	public:
+
+		FeatureAccumulator() : m_NumberOfComponentsPerPixel(0) {}
+		virtual ~FeatureAccumulator() {}
+
+		/* Called before the segmentation, when the image is known */
+		virtual void SetNumberOfComponentsPerPixel(const unsigned int n) { m_NumberOfComponentsPerPixel = n; }
+
+		/* Number of values of the state of a segment */
+		virtual std::size_t GetStateSize() const = 0;
+
+		/* Initialize the state of a segment made of a single pixel */
+		virtual void Initialize(double * state, const float * pixel) const = 0;
+
+		/* Combine the state of another segment into the state of a segment, given their areas */
+		virtual void Merge(double * state, const unsigned int area,
+						   const double * other, const unsigned int otherArea) const = 0;
+
+		/* Names of the features, in the order of GetFeatures */
+		virtual std::vector<std::string> GetFeatureNames() const = 0;
+
+		/* Append the features of a segment of the given area to a vector */
+		virtual void GetFeatures(const double * state,
+								 const unsigned int area,
+								 std::vector<double>& features) const = 0;
+
+	protected:
+
+		unsigned int m_NumberOfComponentsPerPixel;
+	};
+
+	/* Minimum and maximum of each band */
+	class MinMaxAccumulator : public FeatureAccumulator
+	{
+	public:
+		std::size_t GetStateSize() const;
+		void Initialize(double * state, const float * pixel) const;
+		void Merge(double * state, const unsigned int area, const double * other, const unsigned int otherArea) const;
+		std::vector<std::string> GetFeatureNames() const;
+		void GetFeatures(const double * state, const unsigned int area, std::vector<double>& features) const;
+	};
+
+	/* Mean, standard deviation and skewness of each band */
+	class MomentsAccumulator : public FeatureAccumulator
+	{
+	public:
+		std::size_t GetStateSize() const;
+		void Initialize(double * state, const float * pixel) const;
+		void Merge(double * state, const unsigned int area, const double * other, const unsigned int otherArea) const;
+		std::vector<std::string> GetFeatureNames() const;
+		void GetFeatures(const double * state, const unsigned int area, std::vector<double>& features) const;
+	};
+
+	/* Normalized histogram of one band (1-based) over [min, max] */
+	class HistogramAccumulator : public FeatureAccumulator
+	{
+	public:
+		HistogramAccumulator(const unsigned int band,
+							 const unsigned int numberOfBins,
+							 const float minimum,
+							 const float maximum);
+
+		void SetNumberOfComponentsPerPixel(const unsigned int n);
+		std::size_t GetStateSize() const;
+		void Initialize(double * state, const float * pixel) const;
+		void Merge(double * state, const unsigned int area, const double * other, const unsigned int otherArea) const;
+		std::vector<std::string> GetFeatureNames() const;
+		void GetFeatures(const double * state, const unsigned int area, std::vector<double>& features) const;
+
+	private:
+		unsigned int m_Band;
+		unsigned int m_NumberOfBins;
+		float m_Minimum;
+		float m_Maximum;
+	};
+
+	/* Mean, standard deviation, minimum and maximum of the NDVI given the red and NIR bands (1-based) */
+	class NDVIAccumulator : public FeatureAccumulator
+	{
+	public:
+		NDVIAccumulator(const unsigned int redBand, const unsigned int nirBand);
+
+		void SetNumberOfComponentsPerPixel(const unsigned int n);
+		std::size_t GetStateSize() const;
+		void Initialize(double * state, const float * pixel) const;
+		void Merge(double * state, const unsigned int area, const double * other, const unsigned int otherArea) const;
+		std::vector<std::string> GetFeatureNames() const;
+		void GetFeatures(const double * state, const unsigned int area, std::vector<double>& features) const;
+
+	private:
+		unsigned int m_RedBand;
+		unsigned int m_NIRBand;
+	};
+
+	/*
+	 * Accumulators used by a segmentation: their states are laid out one
+	 * after the other in the feature vector of each node.
+	 */
+	class FeatureAccumulatorSet
+	{
+	public:
+
+		FeatureAccumulatorSet() : m_StateSize(0) {}
+
+		void Add(std::shared_ptr<FeatureAccumulator> accumulator);
+		void Clear();
+		bool Empty() const { return m_Accumulators.empty(); }
+
+		/* Set the number of bands of the accumulators and compute the layout of the states */
+		void SetNumberOfComponentsPerPixel(const unsigned int n);
+		std::size_t GetStateSize() const { return m_StateSize; }
+
+		void Initialize(double * state, const float * pixel) const;
+		void Merge(double * state, const unsigned int area, const double * other, const unsigned int otherArea) const;
+		std::vector<std::string> GetFeatureNames() const;
+		void GetFeatures(const double * state, const unsigned int area, std::vector<double>& features) const;
+
+	private:
+
+		std::vector< std::shared_ptr<FeatureAccumulator> > m_Accumulators;
+		std::vector<std::size_t> m_Offsets;
+		std::size_t m_StateSize;
+	};
+
+	/*
+	 * Create an accumulator from its description: "minmax", "moments",
+	 * "histogram:band:bins:min:max" or "ndvi:red:nir" (1-based bands).
+	 */
+	std::shared_ptr<FeatureAccumulator> CreateFeatureAccumulator(const std::string& description);
+
+} // end of namespace grm
+#endif
@@ -36,13 +36,27 @@ namespace grm
 		typedef Segmenter<TImage, FLSNode, FLSParam> Superclass;
 		typedef TImage ImageType;
 		typedef typename Superclass::GraphType GraphType;
+		typedef typename Superclass::EdgeType EdgeType;
 		typedef typename Superclass::NodePointerType NodePointerType;
 		typedef typename Superclass::GraphOperatorType GraphOperatorType;
 		typedef GraphToOtbImage<GraphType> IOType;
 
 		float ComputeMergingCost(NodePointerType n1, NodePointerType n2);
+		void ComputeMergingCosts(NodePointerType r, EdgeType * const * edges, const std::size_t n, float * costs, const float bound);
 		void UpdateSpecificAttributes(NodePointerType n1, NodePointerType n2);
 		void InitFromImage();
+		std::size_t EstimateAttributesMemoryUsage(const unsigned int numberOfComponents)
+		{
+			return GetHeapBlockSize(numberOfComponents * sizeof(float));
+		}
+		void WriteAttributes(GraphBuffer& buffer, NodePointerType n);
+		void ReadAttributes(GraphBuffer& buffer, NodePointerType n);
+		void GetMeans(NodePointerType n, float * means);
+
+	private:
+
+		/* Merging cost, whose evaluation stops as soon as it is known not to be below the bound */
+		float ComputeBoundedMergingCost(NodePointerType n1, NodePointerType n2, const unsigned int boundary, const float bound);
 	};
 } // end of namespace grm
 #include "grmFullLambdaScheduleSegmenter.txx"
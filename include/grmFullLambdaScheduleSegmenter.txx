@@ -26,44 +26,70 @@ namespace grm
 	void
 	FullLambdaScheduleSegmenter<TImage>::InitFromImage()
 	{
-		typedef itk::ImageRegionIterator<TImage> ImageIterator;
+		typedef typename TImage::PixelType PixelType;
 
 		this->m_ImageWidth = this->m_InputImage->GetLargestPossibleRegion().GetSize()[0];
 		this->m_ImageHeight =this->m_InputImage->GetLargestPossibleRegion().GetSize()[1];
 		this->m_NumberOfComponentsPerPixel = this->m_InputImage->GetNumberOfComponentsPerPixel();
 
-		std::size_t idx = 0;
-		ImageIterator it(this->m_InputImage, this->m_InputImage->GetLargestPossibleRegion());
-		for(it.GoToBegin(); !it.IsAtEnd(); ++it)
-		{
-			this->m_Graph.m_Nodes[idx]->m_Means.reserve(this->m_NumberOfComponentsPerPixel);
-
-			for(std::size_t b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+		this->ForEachValidPixel([&](const std::size_t idx, const PixelType& pixel)
 			{
-				this->m_Graph.m_Nodes[idx]->m_Means.push_back(it.Get()[b]);
-			}	
-			++idx;
-		}
+				this->m_Graph.m_Nodes[idx]->m_Means.reserve(this->m_NumberOfComponentsPerPixel);
+
+				for(std::size_t b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+				{
+					this->m_Graph.m_Nodes[idx]->m_Means.push_back(pixel[b]);
+				}
+				this->InitFeatures(idx, pixel);
+			});
 	}
 
 	template<class TImage>
 	float
 	FullLambdaScheduleSegmenter<TImage>::ComputeMergingCost(NodePointerType n1, NodePointerType n2)
+	{
+		// Retrieve the length of the boundary between n1 and n2
+		auto toN2 = GraphOperatorType::FindEdge(n1, n2);
+
+		return ComputeBoundedMergingCost(n1, n2, toN2->m_Boundary, std::numeric_limits<float>::max());
+	}
+
+	template<class TImage>
+	void
+	FullLambdaScheduleSegmenter<TImage>::ComputeMergingCosts(NodePointerType r,
+															 EdgeType * const * edges,
+															 const std::size_t n,
+															 float * costs,
+															 const float bound)
+	{
+		for(std::size_t i = 0; i < n; ++i)
+			costs[i] = ComputeBoundedMergingCost(r, edges[i]->GetRegion(), edges[i]->m_Boundary, bound);
+	}
+
+	template<class TImage>
+	float
+	FullLambdaScheduleSegmenter<TImage>::ComputeBoundedMergingCost(NodePointerType n1, NodePointerType n2,
+																   const unsigned int boundary, const float bound)
 	{
 		float eucDist = 0.0;
 		const float a1 = static_cast<float>(n1->m_Area);
 		const float a2 = static_cast<float>(n2->m_Area);
 		const float a_sum = a1 + a2;
+		const float weight = (a1*a2)/a_sum;
+
+		// The cost grows with the distance: the evaluation stops as soon as
+		// the partial distance gives a cost not below the bound.
+		const float distanceBound = bound / weight * static_cast<float>(boundary);
 
 		for(unsigned int b = 0; b < this->m_NumberOfComponentsPerPixel; b++)
 		{
 			eucDist += (n1->m_Means[b] - n2->m_Means[b])*(n1->m_Means[b] - n2->m_Means[b]);
-		}
 
-		// Retrieve the length of the boundary between n1 and n2
-		auto toN2 = GraphOperatorType::FindEdge(n1, n2);
+			if(eucDist >= distanceBound && (weight*eucDist) / (static_cast<float>(boundary)) >= bound)
+				break;
+		}
 
-		float cost = (((a1*a2)/a_sum)*eucDist) / (static_cast<float>(toN2->m_Boundary));
+		float cost = (weight*eucDist) / (static_cast<float>(boundary));
 
 		return cost;
 	}
@@ -81,6 +107,27 @@ namespace grm
 			n1->m_Means[b] = (a1 * n1->m_Means[b] + a2 * n2->m_Means[b]) / a_sum;
 		}
 	}
+
+	template<class TImage>
+	void
+	FullLambdaScheduleSegmenter<TImage>::WriteAttributes(GraphBuffer& buffer, NodePointerType n)
+	{
+		buffer.Write(n->m_Means);
+	}
+
+	template<class TImage>
+	void
+	FullLambdaScheduleSegmenter<TImage>::ReadAttributes(GraphBuffer& buffer, NodePointerType n)
+	{
+		buffer.Read(n->m_Means);
+	}
+
+	template<class TImage>
+	void
+	FullLambdaScheduleSegmenter<TImage>::GetMeans(NodePointerType n, float * means)
+	{
+		std::copy(n->m_Means.begin(), n->m_Means.end(), means);
+	}
 } // end of namespace grm
 
 #endif
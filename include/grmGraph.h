@@ -18,20 +18,50 @@
 #ifndef GRM_GRAPH_H
 #define GRM_GRAPH_H
 #include "grmDataStructures.h"
+#include "grmMemoryMappedStorage.h"
+#include "grmSmallVector.h"
 #include "lpContour.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 
 namespace grm
 {
+	/*
+	  The fields are ordered and sized to keep the per-pixel graph
+	  small: the flags share a 32-bit word with the version, and the
+	  areas, perimeters, positions and coordinates are 32-bit. A graph
+	  holds at most 2^32 - 1 nodes, which InitNodes and ReadGraph check,
+	  but the ids are 64-bit: the graph stitched from the tiles of a
+	  distributed segmentation is identified in the whole image.
+	 */
 	struct BaseNode
 	{
-		/* Node already merged. */
-		bool m_Valid;
+		/*
+		  The first edge of the node is its best one and the node may
+		  merge in the current iteration: cleared when the node merges,
+		  when its best neighbor is absorbed or, in a dithered iteration,
+		  once the node is visited; set again when its costs are updated.
+		 */
+		unsigned int m_Valid : 1;
 		
 		/* Node has to be removed from the graph. */
-		bool m_Expired;
+		unsigned int m_Expired : 1;
+
+		/*
+		  Node touching a side of its tile shared with another tile of
+		  a distributed segmentation: it cannot merge until the tiles
+		  are stitched.
+		 */
+		unsigned int m_Frozen : 1;
 
-		/* Does the node merge at the previous iteration */
-		bool m_IsMerged;
+		/*
+		  Incremented each time the node absorbs a neighbor: an edge
+		  cost is up to date as long as the versions of both nodes
+		  match the ones stored in the edge. It wraps around to 1 (0
+		  marks the costs to compute).
+		 */
+		unsigned int m_Version : 29;
 		
 		/* Perimeter of the region */
 		unsigned int m_Perimeter;
@@ -40,10 +70,20 @@ namespace grm
 		unsigned int m_Area;
 
 		/*
-		  Node is identified by the location
-		  of the first pixel of the region.
+		  Index of the node in the node list, only maintained during a
+		  dithered iteration, which removes the absorbed nodes at once.
 		 */
-		long unsigned int m_Id;
+		unsigned int m_Position;
+
+		/*
+		  Index of the first pixel of the region in the image of the
+		  segmenter (row-major). It is local to the image: the id of the
+		  region in a scene tiled into such images is given by
+		  Segmenter::GetGlobalId with the offset of the image in the
+		  scene. The graph stitched from the tiles of a distributed
+		  segmentation covers the whole image, hence its ids are global.
+		 */
+		uint64_t m_Id;
 
 		/*
 		  Bounding box of the region
@@ -55,51 +95,145 @@ namespace grm
 		lp::Contour m_Contour;
 	};
 
+	static_assert(sizeof(BaseNode) <= 40 + sizeof(lp::Contour),
+				  "BaseNode should not exceed 40 bytes apart from the contour");
+
+	/*
+	  The target is a raw pointer: the nodes are owned by the graph and
+	  an expired node is only released once every edge targeting it
+	  has been removed.
+	 */
 	template<class DerivedNode>
 		struct NeighborType
 		{
-			typedef std::weak_ptr<DerivedNode> WeakDerived;
-			typedef std::shared_ptr<DerivedNode> SharedDerived;
-
-			WeakDerived m_Target;
+			DerivedNode * m_Target;
 			float  m_Cost;
 			unsigned int m_Boundary;
-			bool m_CostUpdated;
 
-		    NeighborType(WeakDerived ptr, double w, unsigned int c) :
-			m_Target(ptr), m_Cost(w), m_Boundary(c), m_CostUpdated(false) {}
+			/* Versions of the source and target nodes when m_Cost was computed */
+			unsigned int m_SourceVersion;
+			unsigned int m_TargetVersion;
+
+		    NeighborType(DerivedNode * ptr, double w, unsigned int c) :
+			m_Target(ptr), m_Cost(w), m_Boundary(c), m_SourceVersion(0), m_TargetVersion(0) {}
 			
-			inline SharedDerived GetRegion()
+			inline DerivedNode * GetRegion() const
 				{
-					SharedDerived ptr(m_Target.lock());
-					if(!ptr)
-						throw std::runtime_error("NeighborType::GetRegion - Region pointer is not valid");
-					return ptr;
+					return m_Target;
 				}
 		};
-	
+
+	static_assert(sizeof(NeighborType<BaseNode>) <= sizeof(void*) + 4 * sizeof(unsigned int),
+				  "NeighborType should only hold a pointer and four 32-bit fields");
 
 	template<class DerivedNode>
 		struct Node : BaseNode
 	{
 		typedef NeighborType<DerivedNode> CRPTNeighborType;
-		std::vector<CRPTNeighborType> m_Edges;
+
+		/*
+		  Edge lists of up to 4 edges (the pixels in 4-connectivity)
+		  are stored in the node itself, the longer ones in the
+		  graph storage.
+		 */
+		typedef SmallVector<CRPTNeighborType, 4, StorageAllocator<CRPTNeighborType> > EdgeListType;
+		EdgeListType m_Edges;
 	};
 
 	template<class TNode>
 	struct Graph
 	{
 		typedef TNode NodeType;
-		typedef std::shared_ptr<NodeType> NodePointerType;
+		typedef NodeType * NodePointerType;
 		typedef typename NodeType::CRPTNeighborType EdgeType;
 		typedef std::vector<NodePointerType> NodeListType;
 		typedef typename NodeListType::iterator NodeIteratorType;
 		typedef typename NodeListType::const_iterator NodeConstIteratorType;
-		typedef std::vector<EdgeType> EdgeListType;
+		typedef typename NodeType::EdgeListType EdgeListType;
 		typedef typename EdgeListType::iterator EdgeIteratorType;
 		typedef typename EdgeListType::const_iterator EdgeConstIteratorType;
+
+		Graph() : m_FeatureStateSize(0) {}
+		Graph(const Graph&) = delete;
+		Graph& operator=(const Graph&) = delete;
+		~Graph() { Clear(); }
+
+		/* Create a node with an empty edge list allocated in the graph storage */
+		NodePointerType CreateNode()
+			{
+				NodePointerType n = AllocateNode();
+				::new(static_cast<void*>(n)) NodeType();
+				n->m_Edges = EdgeListType(StorageAllocator<EdgeType>(m_Storage.get()));
+				return n;
+			}
+
+		/*
+		  Create a node taking the attributes of another one, which has to
+		  be a node of a graph with the same feature state size
+		*/
+		NodePointerType CreateNode(NodeType&& other)
+			{
+				NodePointerType n = AllocateNode();
+				::new(static_cast<void*>(n)) NodeType(std::move(other));
+				std::copy(GetFeatures(&other), GetFeatures(&other) + m_FeatureStateSize, GetFeatures(n));
+				return n;
+			}
+
+		void DestroyNode(NodePointerType n)
+			{
+				StorageAllocator<char> allocator(m_Storage.get());
+				n->~NodeType();
+				allocator.deallocate(reinterpret_cast<char*>(n), GetNodeRecordSize());
+			}
+
+		/* States of the feature accumulators of a node, stored after its record */
+		double * GetFeatures(NodePointerType n)
+			{
+				return reinterpret_cast<double*>(n + 1);
+			}
+
+		/* Size in bytes of the record of a node and of its feature states */
+		std::size_t GetNodeRecordSize() const
+			{
+				return sizeof(NodeType) + m_FeatureStateSize * sizeof(double);
+			}
+
+		/* Release all the nodes (the storages are kept) */
+		void Clear()
+			{
+				for(auto& n : m_Nodes)
+				{
+					if(n != nullptr)
+						DestroyNode(n);
+				}
+				m_Nodes.clear();
+			}
 		
+		/*
+		  Storage of the node records and of the edge lists which do not
+		  fit in their node: a memory-mapped file in out-of-core mode, an
+		  anonymous pool otherwise (the heap if it is not set). It is
+		  declared first to outlive the nodes.
+		 */
+		std::shared_ptr<MemoryMappedStorage> m_Storage;
+
 		std::vector< NodePointerType > m_Nodes; 
+
+		/*
+		  Number of states of the feature accumulators stored after the
+		  record of each node (0: no feature). It can only be changed
+		  while the graph is empty.
+		*/
+		std::size_t m_FeatureStateSize;
+
+	private:
+
+		NodePointerType AllocateNode()
+			{
+				static_assert(sizeof(NodeType) % alignof(double) == 0, "The feature states have to be aligned");
+				StorageAllocator<char> allocator(m_Storage.get());
+				return reinterpret_cast<NodePointerType>(allocator.allocate(GetNodeRecordSize()));
+			}
 	};
 	
 } // end of namespace grm
@@ -0,0 +1,139 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_GRAPH_BUFFER_H
+#define GRM_GRAPH_BUFFER_H
+#include "grmMacroGenerator.h"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace grm
+{
+	/*
+	 * Byte buffer in which a graph is serialized to be sent to another
+	 * process. The values are written in the native byte order: the
+	 * processes are expected to run on the same kind of machine.
+	 */
+	class GraphBuffer
+	{
+	public:
+
+		GraphBuffer() : m_Position(0) {}
+
+		template<class T>
+		void Write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "GraphBuffer::Write - The type has to be trivially copyable");
+			const char * bytes = reinterpret_cast<const char*>(&value);
+			m_Data.insert(m_Data.end(), bytes, bytes + sizeof(T));
+		}
+
+		template<class T>
+		void Write(const std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "GraphBuffer::Write - The type has to be trivially copyable");
+			Write<uint64_t>(values.size());
+			const char * bytes = reinterpret_cast<const char*>(values.data());
+			m_Data.insert(m_Data.end(), bytes, bytes + values.size() * sizeof(T));
+		}
+
+		/* Same as the vector version for an array of the given size */
+		template<class T>
+		void Write(const T * values, const std::size_t size)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "GraphBuffer::Write - The type has to be trivially copyable");
+			Write<uint64_t>(size);
+			const char * bytes = reinterpret_cast<const char*>(values);
+			m_Data.insert(m_Data.end(), bytes, bytes + size * sizeof(T));
+		}
+
+		template<class T>
+		void Read(T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "GraphBuffer::Read - The type has to be trivially copyable");
+			CheckAvailable(sizeof(T));
+			std::memcpy(&value, m_Data.data() + m_Position, sizeof(T));
+			m_Position += sizeof(T);
+		}
+
+		template<class T>
+		void Read(std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "GraphBuffer::Read - The type has to be trivially copyable");
+			uint64_t size;
+			Read(size);
+			if(size > (m_Data.size() - m_Position) / sizeof(T))
+				throw std::runtime_error("GraphBuffer::Read - Truncated buffer");
+			values.resize(size);
+			if(size > 0)
+				std::memcpy(values.data(), m_Data.data() + m_Position, size * sizeof(T));
+			m_Position += size * sizeof(T);
+		}
+
+		/* Reads an array written by Write(values, size), whose size has to be the given one */
+		template<class T>
+		void Read(T * values, const std::size_t size)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "GraphBuffer::Read - The type has to be trivially copyable");
+			if(Read<uint64_t>() != size)
+				throw std::runtime_error("GraphBuffer::Read - Unexpected size of an array");
+			CheckAvailable(size * sizeof(T));
+			if(size > 0)
+				std::memcpy(values, m_Data.data() + m_Position, size * sizeof(T));
+			m_Position += size * sizeof(T);
+		}
+
+		template<class T>
+		T Read()
+		{
+			T value;
+			Read(value);
+			return value;
+		}
+
+		/* True when all the values have been read */
+		bool AtEnd() const { return m_Position == m_Data.size(); }
+
+		/* Empty the buffer and restart the reading from the beginning */
+		void Clear()
+		{
+			m_Data.clear();
+			m_Position = 0;
+		}
+
+		/* Bytes of the buffer, to send them or to fill them with received ones */
+		GRMGetRefMacro(std::vector<char>, Data);
+
+	private:
+
+		void CheckAvailable(const std::size_t size) const
+		{
+			if(m_Data.size() - m_Position < size)
+				throw std::runtime_error("GraphBuffer::Read - Truncated buffer");
+		}
+
+		std::vector<char> m_Data;
+
+		/* Position of the next value to read */
+		std::size_t m_Position;
+	};
+
+} // end of namespace grm
+#endif
@@ -18,18 +18,41 @@
 #ifndef GRM_GRAPH_OPERATIONS_H
 #define GRM_GRAPH_OPERATIONS_H
 #include "grmGraph.h"
+#include "grmGraphBuffer.h"
 #include "grmNeighborhood.h"
+#include "grmSpaceFillingCurve.h"
+#include "grmStatistics.h"
+#include "grmMemoryUsage.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <cassert>
 #include <limits>
 #include <map>
+#include <queue>
+#include <tuple>
 #include <utility>
 #include <set>
 #include <random>
 #include <numeric>
+#include <unordered_map>
 
 namespace grm
 {
+	/*
+	 * Heuristics of the merging iterations: local mutual best fitting,
+	 * best fitting with the nodes taken in a random order (dithered),
+	 * or best fitting with the nodes taken by increasing cost, the costs
+	 * being sorted approximately in buckets.
+	 */
+	enum MergingHeuristic
+	{
+		LMBF_HEURISTIC,
+		DITHERED_BF_HEURISTIC,
+		BUCKETED_BF_HEURISTIC
+	};
+
 	template<class TSegmenter>
 	class GraphOperations
 	{
@@ -51,6 +74,12 @@ namespace grm
 
 		using ContourOperator = lp::ContourOperations;
 
+		/* One iteration of the merging process given its threshold */
+		typedef bool (*IterationFunctionType)(SegmenterType&, const float);
+
+		/* Number of buckets of the costs below the threshold (bucketed best fitting) */
+		static const unsigned int NumberOfCostBuckets = 256;
+
 
 		/*
 		 * Given the size of the input image and the mask of the
@@ -61,6 +90,10 @@ namespace grm
 		 * const unsigned int width: width of the input image
 		 * const unsigned int height: height of the input image
 		 * CONNECTIVITY mask : mask of the neighborhood (4X4 or 8X8)
+		 *
+		 * If the segmenter has a storage directory, the nodes and their
+		 * edges are allocated in a memory-mapped file following the
+		 * Z-order curve.
 		 */
 		static void InitNodes(ImageType * inputImg,
 							  SegmenterType& seg,
@@ -76,8 +109,56 @@ namespace grm
 		 * GraphType& graph: reference to the graph of nodes
 		 * float(*fptr)(NodeType*, NodeType*): pointer to the function
 		 * to compute the merging cost between two adjacent nodes.
+		 * const float threshold : threshold of the current iteration.
+		 */
+		static void UpdateMergingCosts(SegmenterType& seg, const float threshold);
+
+		/*
+		 * Given a node whose edge costs are up to date, it swaps the edge
+		 * of lowest cost (the one targeting the smallest id in case of a
+		 * tie) with the first edge.
+		 *
+		 * @params
+		 * NodePointerType r : node whose edges are sorted.
 		 */
-		static void UpdateMergingCosts(SegmenterType& seg);
+		static void MoveBestEdgeToFront(NodePointerType r);
+
+		/*
+		 * Given a node, it computes the merging costs with its neighbors
+		 * except the ones stored in the edges which were computed with the
+		 * current versions of both nodes. The outdated costs are computed
+		 * by batches, with one call to the segmenter per batch, and the
+		 * opposite edges receive the same costs.
+		 *
+		 * The costs which are not below the bound are stored as
+		 * BoundExceededCost, the segmenter being allowed to stop their
+		 * evaluation early. The bound is either the threshold of the
+		 * segmenter or BoundExceededCost for exact costs, which recomputes
+		 * the costs left at BoundExceededCost.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the segmenter.
+		 * NodePointerType r : node whose edges are updated.
+		 * const float bound : upper bound of the costs of interest.
+		 */
+		static void UpdateMergingCostsOfNode(SegmenterType& seg,
+											 const NodePointerType& r,
+											 const float bound);
+
+		/* Cost of the edges whose cost is not below the bound of its evaluation */
+		static float BoundExceededCost() { return std::numeric_limits<float>::max(); }
+
+		/*
+		 * Given the threshold of the next iteration, it marks the costs
+		 * left at BoundExceededCost as outdated if they were evaluated
+		 * with a lower bound (see Segmenter::m_ExceededCostBound): the
+		 * threshold schedules raise it between the iterations.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the segmenter.
+		 * const float threshold : threshold of the next iteration.
+		 */
+		static void InvalidateExceededCosts(SegmenterType& seg, const float threshold);
 
 		/*
 		 * Given a node A, we analyse its best node B.
@@ -144,6 +225,20 @@ namespace grm
 											 NodePointerType b,
 											 const unsigned int width);
 
+		/*
+		 * Given 2 adjacent nodes A and B, it merges node B into node A:
+		 * specific attributes of the criterion, features of the segment
+		 * and internal attributes.
+		 *
+		 * @params:
+		 * SegmenterType& seg : reference to the segmenter.
+		 * NodePointerType a : pointer to node A (smallest id).
+		 * NodePointerType b : pointer to node B.
+		 */
+		static void MergeNodes(SegmenterType& seg,
+							   NodePointerType a,
+							   NodePointerType b);
+
 		/*
 		 * Given a graph, it removes all the expired nodes.
 		 *
@@ -152,6 +247,17 @@ namespace grm
 		 */
 		static void RemoveExpiredNodes(GraphType& graph);
 
+		/*
+		 * Given a graph, it sorts its nodes along the Z-order curve
+		 * using the upper left corner of their bounding box as key. The nodes are
+		 * reallocated in this order and the edge targets renumbered
+		 * accordingly, so that adjacent regions are close in memory.
+		 *
+		 * @params
+		 * GraphType& graph : reference to the graph.
+		 */
+		static void SortNodesAlongZOrderCurve(GraphType& graph);
+
 
 		/*
 		 * Given a graph, a region merging algorithm, a threshold
@@ -169,15 +275,15 @@ namespace grm
 		 * @return a boolean pointing out if there was at least a fusion
 		 * of nodes.
 		 */
-		static bool PerfomOneIterationWithLMBF(SegmenterType& seg);
+		static bool PerfomOneIterationWithLMBF(SegmenterType& seg, const float threshold);
 
 		/*
 		 * Given a graph, a region merging algorithm, a threshold,
 		 * the number of iterations to apply and the dimension of the image,
 		 * it performs all the iterations of the merging process using the
 		 * local mutual best fitting heuristic.
-		 * This method can be used when the threshold is constant during
-		 * the region merging process.
+		 * The threshold of each iteration is given by the threshold
+		 * schedule of the segmenter.
 		 *
 		 * @params
 		 * GraphType& graph : reference to the graph
@@ -190,14 +296,192 @@ namespace grm
 		 * @return a boolean pointing out if there was at least a fusion
 		 * of nodes.
 		 */
-		static bool PerfomAllIterationsWithLMBFAndConstThreshold(SegmenterType& seg);
+		static bool PerfomAllIterationsWithLMBF(SegmenterType& seg);
+
+		/*
+		 * Given a segmenter and a function performing one iteration, it
+		 * performs the iterations of the merging process with the
+		 * thresholds of the schedule of the segmenter, until no merge
+		 * happens or the maximum number of iterations is reached.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the region merging algorithm.
+		 * IterationFunctionType iterate : function performing one iteration.
+		 *
+		 * @return a boolean pointing out if there was at least a fusion
+		 * of nodes during the last iteration.
+		 */
+		static bool PerfomAllIterations(SegmenterType& seg, IterationFunctionType iterate);
 
 
 		static bool PerfomAllDitheredIterationsWithBF(SegmenterType& seg);
 		
-		static bool PerfomOneDitheredIterationWithBF(SegmenterType& seg);
+		/*
+		 * Given a graph and a threshold, it performs one iteration of the
+		 * best fitting in a random order: each node not merged yet during
+		 * the iteration merges with its best neighbor if their cost is
+		 * below the threshold. The absorbed nodes are released as soon as
+		 * they are merged, no edge targeting them anymore, and their slots
+		 * are removed from the node list by the pass which marks the nodes
+		 * valid again for the next iteration.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the region merging algorithm.
+		 * const float threshold : threshold of this iteration.
+		 *
+		 * @return a boolean pointing out if there was at least a fusion
+		 * of nodes.
+		 */
+		static bool PerfomOneDitheredIterationWithBF(SegmenterType& seg, const float threshold);
+
+		/* Updates the costs of the edges of a node and moves its best edge to the front */
+		static void ComputeMergingCostsUsingDither(NodePointerType r, SegmenterType& seg, const float threshold);
+
+		/*
+		 * Given a graph and a threshold, it performs one iteration of
+		 * the merging process using the best fitting heuristic, the nodes
+		 * being taken by increasing cost of their best edge from a queue
+		 * of NumberOfCostBuckets buckets of equal width below the
+		 * threshold: the costs are only sorted up to their bucket, which
+		 * makes the pushes and pops constant time. A node whose best edge
+		 * has been changed by a merge goes back to the queue with its new
+		 * best cost, but not before the current bucket. A merged node only
+		 * looks for its best neighbor at the next iteration, which saves
+		 * the evaluation of all its costs after each merge, but its
+		 * neighbors can still merge into it during the iteration.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the region merging algorithm.
+		 * const float threshold : threshold for this iteration.
+		 *
+		 * @return a boolean pointing out if there was at least a fusion
+		 * of nodes.
+		 */
+		static bool PerfomOneBucketedIterationWithBF(SegmenterType& seg, const float threshold);
+
+		static bool PerfomAllBucketedIterationsWithBF(SegmenterType& seg);
+
+		/* Bucket of a cost below the threshold */
+		static unsigned int GetCostBucket(const float cost, const float threshold);
+
+		/*
+		 * Given a segmented graph, it merges every region smaller than
+		 * a minimum area into its neighbor with the lowest merging cost,
+		 * whatever the threshold. The regions are taken by increasing
+		 * area from a priority queue, so that a region grown by a merge
+		 * is considered again with its new area.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the region merging algorithm.
+		 * const unsigned int minimumArea : regions of a smaller area are absorbed.
+		 *
+		 * @return the number of merges.
+		 */
+		static std::size_t MergeSmallRegions(SegmenterType& seg, const unsigned int minimumArea);
+
+		/*
+		 * Given a graph covering a rectangular area of the image, it
+		 * freezes the nodes touching the given sides of the area and
+		 * unfreezes the other ones. The frozen nodes do not merge, hence
+		 * the nodes along a side shared with another tile stay single
+		 * pixels until the tiles are stitched.
+		 *
+		 * @params
+		 * GraphType& graph : reference to the graph.
+		 * const lp::BoundingBox& area : area of the image covered by the graph.
+		 * const unsigned int sides : sides to freeze (combination of BorderSide).
+		 */
+		static void FreezeBorderNodes(GraphType& graph,
+									  const lp::BoundingBox& area,
+									  const unsigned int sides);
+
+		/*
+		 * Given a segmenter whose graph covers a tile of an image, it
+		 * serializes the graph with the coordinates of the whole image:
+		 * the internal attributes, the features and the specific
+		 * attributes of the nodes, then their edges.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the segmenter of the tile.
+		 * GraphBuffer& buffer : buffer receiving the graph.
+		 * const unsigned int offsetX : column of the tile in the image.
+		 * const unsigned int offsetY : row of the tile in the image.
+		 * const unsigned int width : width of the image.
+		 */
+		static void WriteGraph(SegmenterType& seg,
+							   GraphBuffer& buffer,
+							   const unsigned int offsetX,
+							   const unsigned int offsetY,
+							   const unsigned int width);
+
+		/*
+		 * Same as WriteGraph for the nodes for which select(node) is
+		 * true: their edges to the other nodes are left out, so that
+		 * the buffer can be read on its own.
+		 *
+		 * @params
+		 * F select : predicate on the nodes (NodePointerType).
+		 */
+		template<class F>
+		static void WriteGraph(SegmenterType& seg,
+							   GraphBuffer& buffer,
+							   const unsigned int offsetX,
+							   const unsigned int offsetY,
+							   const unsigned int width,
+							   F select);
+
+		/*
+		 * Given a graph, it releases the nodes for which remove(node) is
+		 * true and the edges of the other nodes targeting them.
+		 *
+		 * @params
+		 * GraphType& graph : reference to the graph.
+		 * F remove : predicate on the nodes (NodePointerType).
+		 */
+		template<class F>
+		static void RemoveNodes(GraphType& graph, F remove);
 
-		static void ComputeMergingCostsUsingDither(NodePointerType r, SegmenterType& seg);
+		/*
+		 * Given a buffer filled by WriteGraph, it adds its nodes to the
+		 * graph of the segmenter, whose image width has to be the one of
+		 * the whole image. The merging costs of their edges are computed
+		 * again.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the segmenter.
+		 * GraphBuffer& buffer : buffer containing the graph.
+		 */
+		static void ReadGraph(SegmenterType& seg, GraphBuffer& buffer);
+
+		/*
+		 * Given a graph made of the graphs of adjacent tiles, it connects
+		 * the frozen nodes of the tiles: they are single pixels, hence two
+		 * of them are adjacent if their pixels are. The nodes are sorted
+		 * by id so that the result does not depend on the order in which
+		 * the tiles were read.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the segmenter.
+		 */
+		static void StitchGraph(SegmenterType& seg);
+
+		/*
+		 * Given the statistics of an iteration which has just been
+		 * performed, it completes them with the state of the graph and
+		 * forwards them to the segmenter.
+		 *
+		 * @params
+		 * SegmenterType& seg : reference to the region merging algorithm.
+		 * IterationStatistics& stats : statistics of the iteration.
+		 * const std::size_t numberOfCostEvaluations : number of cost
+		 * evaluations before the iteration.
+		 * const std::size_t numberOfCachedCosts : number of costs reused
+		 * from the edges before the iteration.
+		 */
+		static void NotifyIteration(SegmenterType& seg,
+									IterationStatistics& stats,
+									const std::size_t numberOfCostEvaluations,
+									const std::size_t numberOfCachedCosts);
 
 	};
 } // end of namespace lsrm
@@ -34,19 +34,44 @@ namespace grm
 			height = inputImg->GetLargestPossibleRegion().GetSize()[1];
 		}
 		
-		const long unsigned int num_nodes = width * height;
+		const long unsigned int num_nodes = static_cast<long unsigned int>(width) * height;
+		if(num_nodes > std::numeric_limits<unsigned int>::max())
+			throw std::runtime_error("GraphOperations::InitNodes - The image has too many pixels for a single graph: segment it by tiles (DistributedSegmenter)");
+
+		// Release the nodes of a previous segmentation before their storage.
+		seg.m_Graph.Clear();
+		seg.m_Graph.m_FeatureStateSize = seg.GetFeatureAccumulators().GetStateSize();
+
+		// Out-of-core mode: the nodes and their edges are allocated in a
+		// memory-mapped file, in Z-order so that spatial neighbors share pages.
+		// Otherwise they are allocated in an anonymous pool recycling the
+		// records released by the merges.
+		const bool outOfCore = !seg.GetStorageDirectory().empty();
+		if(outOfCore)
+			seg.m_Graph.m_Storage = std::make_shared<MemoryMappedStorage>(seg.GetStorageDirectory());
+		else
+			seg.m_Graph.m_Storage = std::make_shared<MemoryMappedStorage>();
+
+		// The masked pixels do not become nodes: their entries stay null
+		// until the graph is initialized. Their bitmap is kept for the outputs.
+		// The no-data pixels are found by InitFromImage, which reads the
+		// input image anyway: their nodes are removed afterwards.
+		seg.ComputeValidPixels(seg.GetValidPixels(), false);
+		const std::vector<bool>& validPixels = seg.GetValidPixels();
 
-		seg.m_Graph.m_Nodes.reserve(num_nodes);
+		seg.m_Graph.m_Nodes.assign(num_nodes, nullptr);
 
-		for(long unsigned int i = 0;
-			i < num_nodes;
-			++i)
+		auto createNode = [&](long unsigned int i)
 		{
-			NodePointerType n(new NodeType);
+			if(!validPixels.empty() && !validPixels[i])
+				return;
+
+			NodePointerType n = seg.m_Graph.CreateNode();
 			n->m_Id = i;
 			n->m_Valid = true;
 			n->m_Expired = false;
-			n->m_IsMerged = true; // force to compute costs for the first iteration
+			n->m_Frozen = false;
+			n->m_Version = 1; // the edges are created with version 0 to force the first cost computation
 			n->m_Perimeter = 4;
 			n->m_Area = 1;
 			n->m_Bbox.m_UX = i % width;
@@ -60,31 +85,32 @@ namespace grm
 			ContourOperator::Push3(n->m_Contour);
 			ContourOperator::Push0(n->m_Contour);
 			
-			seg.m_Graph.m_Nodes.push_back(n);
-		}
+			seg.m_Graph.m_Nodes[i] = n;
+		};
 
-		if(mask == FOUR)
+		auto createEdges = [&](long unsigned int i)
 		{
-			for(auto& r : seg.m_Graph.m_Nodes)
+			auto& r = seg.m_Graph.m_Nodes[i];
+			if(r == nullptr)
+				return;
+
+			if(mask == FOUR)
 			{
 				long int neighborhood[4];
 				FOURNeighborhood(neighborhood, r->m_Id, width, height);
 				for(short j = 0; j < 4; ++j)
 				{
-					if(neighborhood[j] > -1)
+					if(neighborhood[j] > -1 && seg.m_Graph.m_Nodes[neighborhood[j]] != nullptr)
 						r->m_Edges.push_back(EdgeType( seg.m_Graph.m_Nodes[neighborhood[j]], 0, 1));
 				}
 			}
-		}
-		else
-		{
-			for(auto& r : seg.m_Graph.m_Nodes)
+			else
 			{
 				long int neighborhood[8];
 				EIGHTNeighborhood(neighborhood, r->m_Id, width, height);
 				for(short j = 0; j < 8; ++j)
 				{
-					if(neighborhood[j] > -1)
+					if(neighborhood[j] > -1 && seg.m_Graph.m_Nodes[neighborhood[j]] != nullptr)
 					{
 						if(j % 2 > 0)
 							r->m_Edges.push_back(EdgeType( seg.m_Graph.m_Nodes[neighborhood[j]], 0, 0));
@@ -93,79 +119,158 @@ namespace grm
 					}
 				}
 			}
+		};
+
+		if(outOfCore)
+		{
+			ForEachCellInZOrder(width, height, createNode);
+			ForEachCellInZOrder(width, height, createEdges);
+		}
+		else
+		{
+			for(long unsigned int i = 0; i < num_nodes; ++i)
+				createNode(i);
+			for(long unsigned int i = 0; i < num_nodes; ++i)
+				createEdges(i);
 		}
-		seg.InitFromImage();
-	}
 
-	template<class TSegmenter>
-	void GraphOperations<TSegmenter>::UpdateMergingCosts(SegmenterType& seg)
-	{		
-		float min_cost;
-		long unsigned int min_id  = 0;
-		std::size_t idx, min_idx;
+		seg.InitFromImage();
 
-		for(auto& r : seg.m_Graph.m_Nodes)
+		if(!validPixels.empty())
 		{
-			for(auto& edge : r->m_Edges)
-				edge.m_CostUpdated = false;
+			seg.m_Graph.m_Nodes.erase(std::remove(seg.m_Graph.m_Nodes.begin(), seg.m_Graph.m_Nodes.end(), nullptr),
+									  seg.m_Graph.m_Nodes.end());
+			if(seg.GetUseNoDataValue())
+				RemoveNodes(seg.m_Graph, [&](NodePointerType r){ return !validPixels[r->m_Id]; });
 		}
+	}
 
+	template<class TSegmenter>
+	void GraphOperations<TSegmenter>::UpdateMergingCosts(SegmenterType& seg, const float threshold)
+	{		
 		for(auto& r : seg.m_Graph.m_Nodes)
 		{
-			min_cost = std::numeric_limits<float>::max();
-			idx = 0;
-			min_idx = 0;
-
 			r->m_Expired = false;
 			r->m_Valid = true;
 
-			for(auto& edge : r->m_Edges)
-			{
-				auto neighborR = edge.GetRegion();
+			// Compute the costs if necessary: only the ones below the
+			// threshold can lead to a merge.
+			UpdateMergingCostsOfNode(seg, r, threshold);
+			MoveBestEdgeToFront(r);
+		}
+	}
 
-				// Compute the cost if necessary
-				if(!edge.m_CostUpdated && (neighborR->m_IsMerged || r->m_IsMerged))
-				{
-					auto edgeFromNeighborToR = FindEdge(neighborR, r);
-					edge.m_Cost = seg.ComputeMergingCost(r, neighborR);
-					edgeFromNeighborToR->m_Cost = edge.m_Cost;
-					edge.m_CostUpdated = true;
-					edgeFromNeighborToR->m_CostUpdated = true;
-				}
+	template<class TSegmenter>
+	void GraphOperations<TSegmenter>::MoveBestEdgeToFront(NodePointerType r)
+	{
+		float min_cost = std::numeric_limits<float>::max();
+		long unsigned int min_id  = 0;
+		std::size_t idx = 0, min_idx = 0;
+
+		for(auto& edge : r->m_Edges)
+		{
+			auto neighborR = edge.GetRegion();
 
-				// Check if the cost of the edge is the minimum
-				if(min_cost > edge.m_Cost)
+			// Check if the cost of the edge is the minimum
+			if(min_cost > edge.m_Cost)
+			{
+				min_cost = edge.m_Cost;
+				min_id = neighborR->m_Id;
+				min_idx = idx;
+			}
+			else if(min_cost == edge.m_Cost)
+			{
+				if(min_id > neighborR->m_Id)
 				{
-					min_cost = edge.m_Cost;
 					min_id = neighborR->m_Id;
 					min_idx = idx;
 				}
-				else if(min_cost == edge.m_Cost)
-				{
-					if(min_id > neighborR->m_Id)
-					{
-						min_id = neighborR->m_Id;
-						min_idx = idx;
-					}
-				}
-				++idx;	
 			}
+			++idx;	
+		}
 
-			assert(min_idx < r->m_Edges.size());
+		if(!r->m_Edges.empty())
 			std::swap(r->m_Edges[0], r->m_Edges[min_idx]);
-				
-		}
+	}
+
+	template<class TSegmenter>
+	void GraphOperations<TSegmenter>::InvalidateExceededCosts(SegmenterType& seg, const float threshold)
+	{
+		if(!(threshold > seg.GetExceededCostBound()))
+			return;
 
-		// Reset the merge flag for all the regions.
+		// The versions of the nodes start at 1.
 		for(auto& r : seg.m_Graph.m_Nodes)
-			r->m_IsMerged = false;
+		{
+			for(auto& edge : r->m_Edges)
+			{
+				if(edge.m_Cost == BoundExceededCost())
+					edge.m_SourceVersion = 0;
+			}
+		}
+		seg.SetExceededCostBound(BoundExceededCost());
+	}
+
+	template<class TSegmenter>
+	void GraphOperations<TSegmenter>::UpdateMergingCostsOfNode(SegmenterType& seg,
+															   const NodePointerType& r,
+															   const float bound)
+	{
+		const std::size_t batchSize = 32;
+		EdgeType * edges[batchSize];
+		float costs[batchSize];
+		std::size_t n = 0;
+
+		auto computeBatch = [&]()
+		{
+			seg.ComputeMergingCosts(r, edges, n, costs, bound);
+			seg.GetStatistics().m_NumberOfCostEvaluations += n;
+
+			for(std::size_t i = 0; i < n; ++i)
+			{
+				EdgeType& edge = *(edges[i]);
+				NodePointerType neighborR = edge.GetRegion();
+				edge.m_Cost = (costs[i] < bound) ? costs[i] : BoundExceededCost();
+				if(edge.m_Cost == BoundExceededCost() && bound < seg.GetExceededCostBound())
+					seg.SetExceededCostBound(bound);
+				edge.m_SourceVersion = r->m_Version;
+				edge.m_TargetVersion = neighborR->m_Version;
+
+				// The cost is symmetric: store it in the opposite edge as well.
+				auto edgeFromNeighborToR = FindEdge(neighborR, r);
+				edgeFromNeighborToR->m_Cost = edge.m_Cost;
+				edgeFromNeighborToR->m_SourceVersion = neighborR->m_Version;
+				edgeFromNeighborToR->m_TargetVersion = r->m_Version;
+			}
+			n = 0;
+		};
+
+		for(auto& edge : r->m_Edges)
+		{
+			// A cost which exceeded the threshold is only known exactly if
+			// it was computed without bound.
+			if(edge.m_SourceVersion == r->m_Version && edge.m_TargetVersion == edge.GetRegion()->m_Version &&
+			   (edge.m_Cost < BoundExceededCost() || bound < BoundExceededCost()))
+			{
+				++seg.GetStatistics().m_NumberOfCachedCosts;
+				continue;
+			}
+
+			edges[n++] = &edge;
+			if(n == batchSize)
+				computeBatch();
+		}
+
+		if(n > 0)
+			computeBatch();
 	}
 
 	template<class TSegmenter>
 	typename GraphOperations<TSegmenter>::NodePointerType
 	GraphOperations<TSegmenter>::CheckLMBF(NodePointerType a, float t)
 	{
-		if(a->m_Valid)
+		// A node enclosed by masked pixels has no neighbor.
+		if(a->m_Valid && !a->m_Frozen && !a->m_Edges.empty())
 		{
 			float cost = a->m_Edges.front().m_Cost;
 			
@@ -173,7 +278,7 @@ namespace grm
 			{
 				NodePointerType b = a->m_Edges.front().GetRegion();
 
-				if( b->m_Valid)
+				if( b->m_Valid && !b->m_Frozen)
 				{
 					NodePointerType best_b = b->m_Edges.front().GetRegion();
 
@@ -201,7 +306,7 @@ namespace grm
 	typename GraphOperations<TSegmenter>::NodePointerType
 	GraphOperations<TSegmenter>::CheckBF(NodePointerType a, float t)
 	{
-		if(a->m_Valid)
+		if(a->m_Valid && !a->m_Frozen && !a->m_Edges.empty())
 		{
 			float cost = a->m_Edges.front().m_Cost;
 
@@ -209,7 +314,7 @@ namespace grm
 			{
 				NodePointerType b = a->m_Edges.front().GetRegion();
 
-				if(b->m_Valid)
+				if(b->m_Valid && !b->m_Frozen)
 				{
 					if( a->m_Id < b->m_Id )
 						return a;
@@ -314,10 +419,12 @@ namespace grm
 		a->m_Bbox = mergedBBox;//MergeBoundingBoxes(a->m_Bbox, b->m_Bbox);
 
 		/* Step 2: update the contour */
-		a->m_Contour = mergedContour;
+		a->m_Contour = std::move(mergedContour);
 
 		/* Step 2 : update perimeter and area attributes */
 		EdgeIterator toB = FindEdge(a, b);
+		if(b->m_Area > std::numeric_limits<unsigned int>::max() - a->m_Area)
+			throw std::runtime_error("GraphOperations::UpdateInternalAttributes - The area of a region exceeds 2^32 - 1 pixels");
 		a->m_Perimeter += (b->m_Perimeter - 2 * toB->m_Boundary);
 		a->m_Area += b->m_Area;
 			
@@ -328,43 +435,141 @@ namespace grm
 		a->m_Valid = false;
 		b->m_Valid = false;
 		b->m_Expired = true;
-		a->m_IsMerged = true;
+		if(++a->m_Version == 0)
+			a->m_Version = 1;
+	}
+
+	template<class TSegmenter>
+	void
+	GraphOperations<TSegmenter>::MergeNodes(SegmenterType& seg,
+											NodePointerType a,
+											NodePointerType b)
+	{
+		seg.UpdateSpecificAttributes(a, b);
+		seg.MergeFeatures(a, b);
+		UpdateInternalAttributes(a, b, seg.GetImageWidth());
 	}
 
 	template<class TSegmenter>
 	void
 	GraphOperations<TSegmenter>::RemoveExpiredNodes(GraphType& graph)
 	{
-		NodeIterator nit = std::remove_if(graph.m_Nodes.begin(), graph.m_Nodes.end(), [](NodePointerType r)->bool{
-				return r->m_Expired;
-			});
+		// No edge targets an expired node anymore, hence it can be released.
+		NodeIterator nit = graph.m_Nodes.begin();
+		for(auto& r : graph.m_Nodes)
+		{
+			if(r->m_Expired)
+				graph.DestroyNode(r);
+			else
+				*nit++ = r;
+		}
 		graph.m_Nodes.erase(nit, graph.m_Nodes.end());
 	}
 
+	template<class TSegmenter>
+	void
+	GraphOperations<TSegmenter>::SortNodesAlongZOrderCurve(GraphType& graph)
+	{
+		// The upper left corner of the bounding box is used as key: the Z-order
+		// being monotonic along x and y, a large region comes before most of
+		// its neighbors, which keeps FindEdge on the short edge lists.
+		auto key = [](const NodePointerType& r)->uint64_t{
+			return MortonCode(r->m_Bbox.m_UX, r->m_Bbox.m_UY);
+		};
+
+		std::sort(graph.m_Nodes.begin(), graph.m_Nodes.end(), [&](const NodePointerType& a, const NodePointerType& b)->bool{
+				const uint64_t ka = key(a), kb = key(b);
+				return (ka < kb) || (ka == kb && a->m_Id < b->m_Id);
+			});
+
+		// Move the node records into new ones allocated in the new order,
+		// which the storage places contiguously.
+		NodeList sortedNodes;
+		sortedNodes.reserve(graph.m_Nodes.size());
+		for(std::size_t i = 0; i < graph.m_Nodes.size(); ++i)
+		{
+			sortedNodes.push_back(graph.CreateNode(std::move(*(graph.m_Nodes[i]))));
+
+			// The old node is about to be released: its id is used to
+			// store its new position.
+			graph.m_Nodes[i]->m_Id = i;
+		}
+
+		// Then reallocate the edge lists in the same order while
+		// renumbering their targets.
+		for(auto& r : sortedNodes)
+		{
+			EdgeList edges(r->m_Edges.get_allocator());
+			edges.reserve(r->m_Edges.size());
+			for(auto& edge : r->m_Edges)
+			{
+				edges.push_back(edge);
+				edges.back().m_Target = sortedNodes[edge.GetRegion()->m_Id];
+			}
+			r->m_Edges.swap(edges);
+		}
+
+		for(auto& r : graph.m_Nodes)
+			graph.DestroyNode(r);
+		graph.m_Nodes.swap(sortedNodes);
+	}
+
+	template<class TSegmenter>
+	void
+	GraphOperations<TSegmenter>::NotifyIteration(SegmenterType& seg,
+												 IterationStatistics& stats,
+												 const std::size_t numberOfCostEvaluations,
+												 const std::size_t numberOfCachedCosts)
+	{
+		stats.m_Iteration = seg.GetStatistics().m_Iterations.size() + 1;
+		stats.m_MaximumNumberOfIterations = seg.GetMaximumNumberOfIterations();
+		stats.m_NumberOfNodes = seg.m_Graph.m_Nodes.size();
+		stats.m_NumberOfEdges = 0;
+		for(auto& r : seg.m_Graph.m_Nodes)
+			stats.m_NumberOfEdges += r->m_Edges.size();
+		stats.m_NumberOfCostEvaluations = seg.GetStatistics().m_NumberOfCostEvaluations - numberOfCostEvaluations;
+		stats.m_NumberOfCachedCosts = seg.GetStatistics().m_NumberOfCachedCosts - numberOfCachedCosts;
+		stats.m_MemoryUsage = GetCurrentMemoryUsage();
+		seg.NotifyIteration(stats);
+	}
+
 	template<class TSegmenter>
 	bool
-	GraphOperations<TSegmenter>::PerfomOneIterationWithLMBF(SegmenterType& seg)
+	GraphOperations<TSegmenter>::PerfomOneIterationWithLMBF(SegmenterType& seg, const float threshold)
 	{
+		typedef std::chrono::steady_clock Clock;
 		bool merged = false;
+		IterationStatistics stats = IterationStatistics();
+		stats.m_Threshold = threshold;
+		const std::size_t numberOfCostEvaluations = seg.GetStatistics().m_NumberOfCostEvaluations;
+		const std::size_t numberOfCachedCosts = seg.GetStatistics().m_NumberOfCachedCosts;
 
 		/* Update the costs of merging between adjacent nodes */
-		UpdateMergingCosts(seg);
+		auto start = Clock::now();
+		InvalidateExceededCosts(seg, threshold);
+		UpdateMergingCosts(seg, threshold);
+		stats.m_CostUpdateTime = std::chrono::duration<double>(Clock::now() - start).count();
 
+		start = Clock::now();
 		for(auto& region : seg.m_Graph.m_Nodes)
 		{
 			
-			auto res_node = CheckLMBF(region, seg.GetThreshold());
+			auto res_node = CheckLMBF(region, threshold);
 
 			if(res_node)
 				{
-					seg.UpdateSpecificAttributes(res_node, res_node->m_Edges.front().GetRegion());
-					UpdateInternalAttributes(res_node, res_node->m_Edges.front().GetRegion(),
-											 seg.GetImageWidth());
+					MergeNodes(seg, res_node, res_node->m_Edges.front().GetRegion());
 					merged = true;
+					++stats.m_NumberOfMerges;
 				}
 		}
+		stats.m_MergeTime = std::chrono::duration<double>(Clock::now() - start).count();
 
+		start = Clock::now();
 		RemoveExpiredNodes(seg.m_Graph);
+		stats.m_NodeRemovalTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+		NotifyIteration(seg, stats, numberOfCostEvaluations, numberOfCachedCosts);
 
 		if(seg.m_Graph.m_Nodes.size() < 2)
 			return false;
@@ -374,33 +579,40 @@ namespace grm
 
 	template<class TSegmenter>
 	bool
-	GraphOperations<TSegmenter>::PerfomAllIterationsWithLMBFAndConstThreshold(SegmenterType& seg)
+	GraphOperations<TSegmenter>::PerfomAllIterations(SegmenterType& seg, IterationFunctionType iterate)
 	{
 		bool merged = true;
-		unsigned int maxNumberOfIterations;
+		bool rising = false;
+		const unsigned int maxNumberOfIterations = seg.GetMaximumNumberOfIterations();
 		unsigned int iterations = 0;
-		unsigned int numberOfIterations = seg.GetNumberOfIterations();
-
-		if(numberOfIterations < 1)
-			maxNumberOfIterations = 200;
-		else
-			maxNumberOfIterations = numberOfIterations;
 
-		while(merged &&
+		// An iteration without merge only ends the process once the
+		// threshold has stopped rising.
+		while((merged || rising) &&
 			  iterations < maxNumberOfIterations &&
 			  seg.m_Graph.m_Nodes.size() > 1)
 		{
-			std::cout << "." << std::flush;
 			++iterations;
 
-			merged = PerfomOneIterationWithLMBF(seg);
+			if(seg.GetNodeSortingPeriod() > 0 && iterations % seg.GetNodeSortingPeriod() == 0)
+				SortNodesAlongZOrderCurve(seg.m_Graph);
+
+			// The schedule goes on where the previous calls of MergeRegions stopped.
+			const std::size_t iteration = seg.GetStatistics().m_Iterations.size();
+			rising = seg.GetThresholdSchedule().IsRising(iteration, seg.GetThreshold());
+			merged = iterate(seg, seg.GetThresholdSchedule().GetThreshold(iteration, seg.GetThreshold()));
 		}
-		std::cout << std::endl;
-		
 		if(seg.m_Graph.m_Nodes.size() < 2)
 			return false;
 
-		return merged;
+		return merged || rising;
+	}
+
+	template<class TSegmenter>
+	bool
+	GraphOperations<TSegmenter>::PerfomAllIterationsWithLMBF(SegmenterType& seg)
+	{
+		return PerfomAllIterations(seg, &PerfomOneIterationWithLMBF);
 	}
 
 	/* New !!! utilisation of a dither matrix */
@@ -409,142 +621,505 @@ namespace grm
 	bool
 	GraphOperations<TSegmenter>::PerfomAllDitheredIterationsWithBF(SegmenterType& seg)
 	{
-		bool merged = true;
-		unsigned int maxNumberOfIterations;
-		unsigned int numberOfIterations = seg.GetNumberOfIterations();
-		
-		if(numberOfIterations < 1)
-			maxNumberOfIterations = 200;
-		else
-			maxNumberOfIterations = numberOfIterations;
-
-		unsigned int iterations = 0;
-
-		while(merged &&
-			  iterations < maxNumberOfIterations &&
-			  seg.m_Graph.m_Nodes.size() > 1)
-		{
-			std::cout << "." << std::flush;
-			++iterations;
-
-			merged = PerfomOneDitheredIterationWithBF(seg);
-		}
-		std::cout << std::endl;
-
-		if(seg.m_Graph.m_Nodes.size() < 2)
-			return false;
-
-		return merged;
+		return PerfomAllIterations(seg, &PerfomOneDitheredIterationWithBF);
 	}
 
 	template<class TSegmenter>
 	bool
-	GraphOperations<TSegmenter>::PerfomOneDitheredIterationWithBF(SegmenterType& seg)
+	GraphOperations<TSegmenter>::PerfomOneDitheredIterationWithBF(SegmenterType& seg, const float threshold)
 	{
+		typedef std::chrono::steady_clock Clock;
 		bool merged = false;
-
-		std::vector<long unsigned int> randomIndices(seg.m_Graph.m_Nodes.size());
-		std::iota(randomIndices.begin(), randomIndices.end(), 0);
+		IterationStatistics stats = IterationStatistics();
+		stats.m_Threshold = threshold;
+		const std::size_t numberOfCostEvaluations = seg.GetStatistics().m_NumberOfCostEvaluations;
+		const std::size_t numberOfCachedCosts = seg.GetStatistics().m_NumberOfCachedCosts;
+		auto iterationStart = Clock::now();
+		InvalidateExceededCosts(seg, threshold);
+		stats.m_CostUpdateTime = std::chrono::duration<double>(Clock::now() - iterationStart).count();
+
+		// The positions let the absorbed nodes be removed from the node list during the iteration.
+		auto& nodes = seg.m_Graph.m_Nodes;
+		std::vector<long unsigned int> randomIndices(nodes.size());
+		for(std::size_t i = 0; i < nodes.size(); ++i)
+		{
+			randomIndices[i] = i;
+			nodes[i]->m_Position = i;
+		}
 		std::shuffle(randomIndices.begin(), randomIndices.end(), std::mt19937{std::random_device{}()});
 
 		for(const auto& i : randomIndices)
 		{
-			if(seg.m_Graph.m_Nodes[i]->m_Valid == true)
+			// Node absorbed earlier in this iteration
+			if(nodes[i] == nullptr)
+				continue;
+
+			if(nodes[i]->m_Valid == true && !nodes[i]->m_Frozen)
 			{
-				auto currSeg = seg.m_Graph.m_Nodes[i];
+				auto currSeg = nodes[i];
 			
 				// This segment is marked as used.
 				currSeg->m_Valid = false;
 
 				// Compute cost with all its neighbors
-				ComputeMergingCostsUsingDither(currSeg, seg);
+				auto start = Clock::now();
+				ComputeMergingCostsUsingDither(currSeg, seg, threshold);
+				stats.m_CostUpdateTime += std::chrono::duration<double>(Clock::now() - start).count();
+
+				if(currSeg->m_Edges.empty())
+					continue;
 
 				// Get the most similar segment
 				auto bestSeg = currSeg->m_Edges.front().GetRegion();
 
-				if(currSeg->m_Edges.front().m_Cost < seg.GetThreshold() && !bestSeg->m_Expired)
+				if(currSeg->m_Edges.front().m_Cost < threshold && !bestSeg->m_Frozen)
 				{
 					merged = true;
-				
-					if(currSeg->m_Id < bestSeg->m_Id)
-					{
-						seg.UpdateSpecificAttributes(currSeg, bestSeg);
-						UpdateInternalAttributes(currSeg, bestSeg, seg.GetImageWidth());
-
-						for(auto& edge : currSeg->m_Edges)
-						{
-							edge.m_CostUpdated = false;
-							auto toNeigh = FindEdge(edge.GetRegion(), currSeg);
-							toNeigh->m_CostUpdated = false;
-						}
-					}
-					else
-					{
-						seg.UpdateSpecificAttributes(bestSeg, currSeg);
-						UpdateInternalAttributes(bestSeg, currSeg, seg.GetImageWidth());
-
-						for(auto& edge : bestSeg->m_Edges)
-						{
-							edge.m_CostUpdated = false;
-							auto toNeigh = FindEdge(edge.GetRegion(), bestSeg);
-							toNeigh->m_CostUpdated = false;
-						}
-					}
+					++stats.m_NumberOfMerges;
+
+					// The region keeps the id of its first pixel.
+					NodePointerType a = currSeg, b = bestSeg;
+					if(b->m_Id < a->m_Id)
+						std::swap(a, b);
+					MergeNodes(seg, a, b);
+
+					// UpdateNeighbors removed the edges targeting b: it is recycled at once.
+					nodes[b->m_Position] = nullptr;
+					seg.m_Graph.DestroyNode(b);
+				}
+			}
+		}
+
+		// The merges are interleaved with the cost updates in the loop above.
+		stats.m_MergeTime = std::chrono::duration<double>(Clock::now() - iterationStart).count() - stats.m_CostUpdateTime;
+
+		// Mark all the segments to be valid, dropping the slots of the absorbed ones
+		auto start = Clock::now();
+		NodeIterator nit = nodes.begin();
+		for(auto& r : nodes)
+		{
+			if(r != nullptr)
+			{
+				r->m_Valid = true;
+				*nit++ = r;
+			}
+		}
+		nodes.erase(nit, nodes.end());
+		stats.m_NodeRemovalTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+		NotifyIteration(seg, stats, numberOfCostEvaluations, numberOfCachedCosts);
+
+		if(nodes.size() < 2)
+			return false;
+
+		return merged;
+	}
+
+	template<class TSegmenter>
+	bool
+	GraphOperations<TSegmenter>::PerfomAllBucketedIterationsWithBF(SegmenterType& seg)
+	{
+		return PerfomAllIterations(seg, &PerfomOneBucketedIterationWithBF);
+	}
+
+	template<class TSegmenter>
+	bool
+	GraphOperations<TSegmenter>::PerfomOneBucketedIterationWithBF(SegmenterType& seg, const float threshold)
+	{
+		typedef std::chrono::steady_clock Clock;
+		// A node and its version when it was pushed
+		typedef std::pair<NodePointerType, unsigned int> EntryType;
+		bool merged = false;
+		IterationStatistics stats = IterationStatistics();
+		stats.m_Threshold = threshold;
+		const std::size_t numberOfCostEvaluations = seg.GetStatistics().m_NumberOfCostEvaluations;
+		const std::size_t numberOfCachedCosts = seg.GetStatistics().m_NumberOfCachedCosts;
+		auto iterationStart = Clock::now();
+
+		/* Update the costs of merging between adjacent nodes */
+		InvalidateExceededCosts(seg, threshold);
+		UpdateMergingCosts(seg, threshold);
+		stats.m_CostUpdateTime = std::chrono::duration<double>(Clock::now() - iterationStart).count();
+
+		// Each node waits in the bucket of the cost of its best edge.
+		std::vector<std::vector<EntryType> > buckets(NumberOfCostBuckets);
+		for(auto& r : seg.m_Graph.m_Nodes)
+		{
+			if(!r->m_Frozen && !r->m_Edges.empty() && r->m_Edges.front().m_Cost < threshold)
+				buckets[GetCostBucket(r->m_Edges.front().m_Cost, threshold)].push_back(EntryType(r, static_cast<unsigned int>(r->m_Version)));
+		}
+
+		for(unsigned int k = 0; k < NumberOfCostBuckets; ++k)
+		{
+			// The bucket grows while it is processed.
+			for(std::size_t i = 0; i < buckets[k].size(); ++i)
+			{
+				NodePointerType r = buckets[k][i].first;
+
+				// The node has been absorbed, or it has absorbed a neighbor
+				// and waits for the next iteration.
+				if(r->m_Expired || r->m_Version != buckets[k][i].second || r->m_Edges.empty())
+					continue;
+
+				const EdgeType& best = r->m_Edges.front();
+				if(!r->m_Valid || best.m_SourceVersion != r->m_Version || best.m_TargetVersion != best.GetRegion()->m_Version)
+				{
+					// A merge has changed the best edge: the node goes back
+					// to the bucket of its new best cost, or to the current
+					// one if it is lower.
+					auto start = Clock::now();
+					UpdateMergingCostsOfNode(seg, r, threshold);
+					MoveBestEdgeToFront(r);
+					r->m_Valid = true;
+					stats.m_CostUpdateTime += std::chrono::duration<double>(Clock::now() - start).count();
+
+					const float cost = r->m_Edges.front().m_Cost;
+					if(cost < threshold)
+						buckets[std::max(k, GetCostBucket(cost, threshold))].push_back(EntryType(r, static_cast<unsigned int>(r->m_Version)));
+					continue;
 				}
+
+				NodePointerType a = r;
+				NodePointerType b = best.GetRegion();
+				if(b->m_Frozen)
+					continue;
+				if(b->m_Id < a->m_Id)
+					std::swap(a, b);
+
+				MergeNodes(seg, a, b);
+				merged = true;
+				++stats.m_NumberOfMerges;
 			}
+			std::vector<EntryType>().swap(buckets[k]);
 		}
 
+		// The merges are interleaved with the cost updates in the loop above.
+		stats.m_MergeTime = std::chrono::duration<double>(Clock::now() - iterationStart).count() - stats.m_CostUpdateTime;
+
+		auto start = Clock::now();
 		RemoveExpiredNodes(seg.m_Graph);
+		stats.m_NodeRemovalTime = std::chrono::duration<double>(Clock::now() - start).count();
 
-		// Mark all the segments to be valid
+		NotifyIteration(seg, stats, numberOfCostEvaluations, numberOfCachedCosts);
 
 		if(seg.m_Graph.m_Nodes.size() < 2)
 			return false;
 
+		return merged;
+	}
+
+	template<class TSegmenter>
+	unsigned int
+	GraphOperations<TSegmenter>::GetCostBucket(const float cost, const float threshold)
+	{
+		if(!(cost > 0.0f) || !(threshold > 0.0f))
+			return 0;
+		return std::min<unsigned int>(NumberOfCostBuckets - 1, static_cast<unsigned int>(cost / threshold * NumberOfCostBuckets));
+	}
+
+	template<class TSegmenter>
+	std::size_t
+	GraphOperations<TSegmenter>::MergeSmallRegions(SegmenterType& seg, const unsigned int minimumArea)
+	{
+		// Entries are (area, id, node): the smallest area comes first and
+		// the id breaks the ties for a deterministic order.
+		typedef std::tuple<unsigned int, uint64_t, NodePointerType> EntryType;
+		std::priority_queue<EntryType, std::vector<EntryType>, std::greater<EntryType> > queue;
+
+		for(auto& r : seg.m_Graph.m_Nodes)
+		{
+			if(r->m_Area < minimumArea && !r->m_Frozen && !r->m_Edges.empty())
+				queue.push(EntryType(r->m_Area, r->m_Id, r));
+		}
+
+		std::size_t numberOfMerges = 0;
+		while(!queue.empty())
+		{
+			const unsigned int area = std::get<0>(queue.top());
+			NodePointerType r = std::get<2>(queue.top());
+			queue.pop();
+
+			// The entry is outdated if the region has been absorbed or has grown since.
+			if(r->m_Expired || r->m_Area != area)
+				continue;
+
+			// A region enclosed by masked pixels cannot be absorbed.
+			if(r->m_Edges.empty())
+				continue;
+
+			// Find the neighbor with the lowest merging cost, even above the threshold.
+			UpdateMergingCostsOfNode(seg, r, BoundExceededCost());
+			EdgeType * bestEdge = nullptr;
+			for(auto& edge : r->m_Edges)
+			{
+				if(edge.GetRegion()->m_Frozen)
+					continue;
+
+				if(bestEdge == nullptr || edge.m_Cost < bestEdge->m_Cost ||
+				   (edge.m_Cost == bestEdge->m_Cost && edge.GetRegion()->m_Id < bestEdge->GetRegion()->m_Id))
+					bestEdge = &edge;
+			}
+
+			// Only frozen neighbors: the region is absorbed after the stitching.
+			if(bestEdge == nullptr)
+				continue;
+
+			// Node B is merged into node A which has the smallest id.
+			NodePointerType neighborR = bestEdge->GetRegion();
+			NodePointerType a = (r->m_Id < neighborR->m_Id) ? r : neighborR;
+			NodePointerType b = (a == r) ? neighborR : r;
+			MergeNodes(seg, a, b);
+			++numberOfMerges;
+
+			if(a->m_Area < minimumArea)
+				queue.push(EntryType(a->m_Area, a->m_Id, a));
+		}
+
+		RemoveExpiredNodes(seg.m_Graph);
+
+		// Restore the state of the nodes left by MergeNodes.
 		for(auto& r : seg.m_Graph.m_Nodes)
 			r->m_Valid = true;
 
-		return merged;
+		return numberOfMerges;
 	}
 
 	template<class TSegmenter>
-	void GraphOperations<TSegmenter>::ComputeMergingCostsUsingDither(NodePointerType r, SegmenterType& seg)
+	void
+	GraphOperations<TSegmenter>::FreezeBorderNodes(GraphType& graph,
+												   const lp::BoundingBox& area,
+												   const unsigned int sides)
 	{
+		// The bounding box of a node is tight: it touches a side of the
+		// area if and only if one of its pixels is along this side.
+		for(auto& r : graph.m_Nodes)
+		{
+			const lp::BoundingBox& bbox = r->m_Bbox;
+			r->m_Frozen = ((sides & TOP_SIDE) && bbox.m_UY == area.m_UY) ||
+				((sides & BOTTOM_SIDE) && bbox.m_UY + bbox.m_H == area.m_UY + area.m_H) ||
+				((sides & LEFT_SIDE) && bbox.m_UX == area.m_UX) ||
+				((sides & RIGHT_SIDE) && bbox.m_UX + bbox.m_W == area.m_UX + area.m_W);
+		}
+	}
 
-		float min_cost = std::numeric_limits<float>::max();
-		std::size_t idx = 0, min_idx = 0;
+	template<class TSegmenter>
+	void
+	GraphOperations<TSegmenter>::WriteGraph(SegmenterType& seg,
+											GraphBuffer& buffer,
+											const unsigned int offsetX,
+											const unsigned int offsetY,
+											const unsigned int width)
+	{
+		WriteGraph(seg, buffer, offsetX, offsetY, width, [](const NodePointerType&)->bool{ return true; });
+	}
+
+	template<class TSegmenter>
+	template<class F>
+	void
+	GraphOperations<TSegmenter>::WriteGraph(SegmenterType& seg,
+											GraphBuffer& buffer,
+											const unsigned int offsetX,
+											const unsigned int offsetY,
+											const unsigned int width,
+											F select)
+	{
+		const unsigned int tileWidth = seg.GetImageWidth();
+		auto globalId = [&](const uint64_t id)->uint64_t{
+			return (id / tileWidth + offsetY) * width + id % tileWidth + offsetX;
+		};
 
+		buffer.Write<uint64_t>(std::count_if(seg.m_Graph.m_Nodes.begin(), seg.m_Graph.m_Nodes.end(), select));
+		for(auto& r : seg.m_Graph.m_Nodes)
+		{
+			if(!select(r))
+				continue;
+
+			buffer.Write<uint64_t>(globalId(r->m_Id));
+			buffer.Write<uint32_t>(r->m_Area);
+			buffer.Write<uint32_t>(r->m_Perimeter);
+			buffer.Write<uint32_t>(r->m_Bbox.m_UX + offsetX);
+			buffer.Write<uint32_t>(r->m_Bbox.m_UY + offsetY);
+			buffer.Write<uint32_t>(r->m_Bbox.m_W);
+			buffer.Write<uint32_t>(r->m_Bbox.m_H);
+			buffer.Write<uint8_t>(r->m_Frozen ? 1 : 0);
+
+			// The moves of a contour do not depend on its position.
+			buffer.Write<uint64_t>(r->m_Contour.size());
+			for(auto& run : r->m_Contour)
+				buffer.Write<lp::Run>(run);
+
+			buffer.Write(seg.m_Graph.GetFeatures(r), seg.m_Graph.m_FeatureStateSize);
+			seg.WriteAttributes(buffer, r);
+
+			uint64_t numberOfEdges = 0;
+			for(auto& edge : r->m_Edges)
+			{
+				if(select(edge.GetRegion()))
+					++numberOfEdges;
+			}
 
-		for(auto& edge : r->m_Edges)
+			buffer.Write<uint64_t>(numberOfEdges);
+			for(auto& edge : r->m_Edges)
+			{
+				if(!select(edge.GetRegion()))
+					continue;
+				buffer.Write<uint64_t>(globalId(edge.GetRegion()->m_Id));
+				buffer.Write<uint32_t>(edge.m_Boundary);
+			}
+		}
+	}
+
+	template<class TSegmenter>
+	template<class F>
+	void
+	GraphOperations<TSegmenter>::RemoveNodes(GraphType& graph, F remove)
+	{
+		// The nodes to remove are marked as expired, like the absorbed ones.
+		for(auto& r : graph.m_Nodes)
+			r->m_Expired = remove(r);
+
+		for(auto& r : graph.m_Nodes)
 		{
-			// Compute the cost if the neighbor is not expired and the cost has to be updated
-			if(!edge.GetRegion()->m_Expired)
+			if(r->m_Expired)
+				continue;
+
+			for(auto edge = r->m_Edges.begin(); edge != r->m_Edges.end();)
 			{
-				auto neighborR = edge.GetRegion();
+				if(edge->GetRegion()->m_Expired)
+					edge = r->m_Edges.erase(edge);
+				else
+					++edge;
+			}
+		}
 
-				// Compute the cost if necessary
-				if(!edge.m_CostUpdated)
-				{
-					auto edgeFromNeighborToR = FindEdge(neighborR, r);
-					edge.m_Cost = seg.ComputeMergingCost(r, neighborR);
-					edgeFromNeighborToR->m_Cost = edge.m_Cost;
-					edge.m_CostUpdated = true;
-					edgeFromNeighborToR->m_CostUpdated = true;
-				}
+		RemoveExpiredNodes(graph);
+	}
 
-				// Check if the cost of the edge is the minimum
-				if(min_cost > edge.m_Cost)
-				{
-					min_cost = edge.m_Cost;
-					min_idx = idx;
-				}
-				
-				++idx;	
+	template<class TSegmenter>
+	void
+	GraphOperations<TSegmenter>::ReadGraph(SegmenterType& seg, GraphBuffer& buffer)
+	{
+		if(!seg.m_Graph.m_Storage)
+		{
+			if(seg.GetStorageDirectory().empty())
+				seg.m_Graph.m_Storage = std::make_shared<MemoryMappedStorage>();
+			else
+				seg.m_Graph.m_Storage = std::make_shared<MemoryMappedStorage>(seg.GetStorageDirectory());
+		}
+
+		// The features are the ones of the accumulators of the segmenter.
+		if(seg.m_Graph.m_Nodes.empty())
+			seg.m_Graph.m_FeatureStateSize = seg.GetFeatureAccumulators().GetStateSize();
+
+		const uint64_t numberOfNodes = buffer.Read<uint64_t>();
+		const std::size_t first = seg.m_Graph.m_Nodes.size();
+		if(numberOfNodes > std::numeric_limits<unsigned int>::max() - first)
+			throw std::runtime_error("GraphOperations::ReadGraph - The graph has too many nodes");
+		seg.m_Graph.m_Nodes.reserve(first + numberOfNodes);
+
+		// The edges are resolved once all the nodes are created.
+		std::unordered_map<uint64_t, NodePointerType> nodes;
+		std::vector<std::pair<uint64_t, uint32_t> > edges;
+		std::vector<uint64_t> numberOfEdges;
+		numberOfEdges.reserve(numberOfNodes);
+
+		for(uint64_t i = 0; i < numberOfNodes; ++i)
+		{
+			NodePointerType r = seg.m_Graph.CreateNode();
+			seg.m_Graph.m_Nodes.push_back(r);
+			r->m_Id = buffer.Read<uint64_t>();
+			r->m_Area = buffer.Read<uint32_t>();
+			r->m_Perimeter = buffer.Read<uint32_t>();
+			r->m_Bbox.m_UX = buffer.Read<uint32_t>();
+			r->m_Bbox.m_UY = buffer.Read<uint32_t>();
+			r->m_Bbox.m_W = buffer.Read<uint32_t>();
+			r->m_Bbox.m_H = buffer.Read<uint32_t>();
+			r->m_Frozen = (buffer.Read<uint8_t>() != 0);
+			r->m_Valid = true;
+			r->m_Expired = false;
+			r->m_Version = 1; // the edges are created with version 0 to force the cost computation
+
+			const uint64_t numberOfRuns = buffer.Read<uint64_t>();
+			r->m_Contour.reserve(numberOfRuns);
+			for(uint64_t j = 0; j < numberOfRuns; ++j)
+				r->m_Contour.push_back(buffer.Read<lp::Run>());
+
+			buffer.Read(seg.m_Graph.GetFeatures(r), seg.m_Graph.m_FeatureStateSize);
+			seg.ReadAttributes(buffer, r);
+
+			numberOfEdges.push_back(buffer.Read<uint64_t>());
+			for(uint64_t j = 0; j < numberOfEdges.back(); ++j)
+			{
+				const uint64_t target = buffer.Read<uint64_t>();
+				const uint32_t boundary = buffer.Read<uint32_t>();
+				edges.push_back(std::make_pair(target, boundary));
+			}
+
+			if(!nodes.insert(std::make_pair(r->m_Id, r)).second)
+				throw std::runtime_error("GraphOperations::ReadGraph - Two nodes have the same id");
+		}
+
+		std::size_t e = 0;
+		for(uint64_t i = 0; i < numberOfNodes; ++i)
+		{
+			NodePointerType r = seg.m_Graph.m_Nodes[first + i];
+			r->m_Edges.reserve(numberOfEdges[i]);
+			for(uint64_t j = 0; j < numberOfEdges[i]; ++j, ++e)
+			{
+				auto target = nodes.find(edges[e].first);
+				if(target == nodes.end())
+					throw std::runtime_error("GraphOperations::ReadGraph - An edge targets an unknown node");
+				r->m_Edges.push_back(EdgeType(target->second, 0, edges[e].second));
+			}
+		}
+	}
+
+	template<class TSegmenter>
+	void
+	GraphOperations<TSegmenter>::StitchGraph(SegmenterType& seg)
+	{
+		std::sort(seg.m_Graph.m_Nodes.begin(), seg.m_Graph.m_Nodes.end(), [](const NodePointerType& a, const NodePointerType& b)->bool{
+				return a->m_Id < b->m_Id;
+			});
+
+		// A frozen node is a single pixel identified by its position.
+		std::unordered_map<uint64_t, NodePointerType> frozenNodes;
+		for(auto& r : seg.m_Graph.m_Nodes)
+		{
+			if(r->m_Frozen && r->m_Area == 1)
+				frozenNodes[r->m_Id] = r;
+		}
+
+		long int neighborhood[4];
+		for(auto& r : seg.m_Graph.m_Nodes)
+		{
+			if(!r->m_Frozen || r->m_Area != 1)
+				continue;
+
+			FOURNeighborhood(neighborhood, r->m_Id, seg.GetImageWidth(), seg.GetImageHeight());
+			for(short j = 0; j < 4; ++j)
+			{
+				if(neighborhood[j] < 0)
+					continue;
+
+				auto neighbor = frozenNodes.find(neighborhood[j]);
+				if(neighbor == frozenNodes.end() || FindEdge(r, neighbor->second) != r->m_Edges.end())
+					continue;
+
+				r->m_Edges.push_back(EdgeType(neighbor->second, 0, 1));
+				neighbor->second->m_Edges.push_back(EdgeType(r, 0, 1));
 			}
 		}
-		assert(min_idx < r->m_Edges.size());
-		std::swap(r->m_Edges[0], r->m_Edges[min_idx]);			
-	}	
+	}
+
+	template<class TSegmenter>
+	void GraphOperations<TSegmenter>::ComputeMergingCostsUsingDither(NodePointerType r, SegmenterType& seg, const float threshold)
+	{
+		// The edges of the absorbed nodes are removed when they are merged,
+		// hence all the neighbors are alive.
+		UpdateMergingCostsOfNode(seg, r, threshold);
+		MoveBestEdgeToFront(r);
+	}
 } // end of namespace grm
 
 #endif
\ No newline at end of file
@@ -25,12 +25,23 @@
 #include <otbImageFileWriter.h>
 #include "grmGraph.h"
 #include <string>
-#include <stdlib.h>
-#include <time.h>
+#include <vector>
 #include "lpContour.h"
+#include "grmMacroGenerator.h"
+#include "grmParallel.h"
 
 namespace grm
 {
+	/*
+	 * Values of the label images: sequential labels 1, 2, 3... or the
+	 * global ids of the regions plus 1 (0 is left for the masked pixels).
+	 */
+	enum LabelMode
+	{
+		SEQUENTIAL_LABELS,
+		GLOBAL_ID_LABELS
+	};
+
 	template<class TGraph>
 	class GraphToOtbImage
 	{
@@ -39,22 +50,128 @@ namespace grm
 		/* Some convenient typedefs */
 		typedef TGraph GraphType;
 		typedef typename GraphType::NodeType NodeType;
-		typedef std::vector< std::shared_ptr<NodeType> > NodeList;
+		typedef typename GraphType::NodeListType NodeList;
 		typedef typename NodeList::const_iterator NodeConstIterator;
 		typedef unsigned int LabelPixelType;
 		typedef otb::Image<LabelPixelType, 2> LabelImageType;
+		typedef uint64_t GlobalLabelPixelType;
+		typedef otb::Image<GlobalLabelPixelType, 2> GlobalLabelImageType;
 		typedef unsigned char ClusterPixelType;
 		typedef otb::VectorImage<ClusterPixelType, 2> ClusteredImageType;
+		typedef float MeanPixelType;
+		typedef otb::VectorImage<MeanPixelType, 2> MeanImageType;
 		using ContourOperator = lp::ContourOperations;
+
+		GraphToOtbImage() : m_NumberOfThreads(0) {}
+
+		/* Number of threads of the rasterization (0: see GetNumberOfThreads) */
+		GRMSetMacro(unsigned int, NumberOfThreads);
+		GRMGetMacro(unsigned int, NumberOfThreads);
 		
 
+		/* Label image where the i-th node of the graph has the label i + 1 */
 		LabelImageType::Pointer GetLabelImage(const GraphType& graph,
 											  const unsigned int width,
 											  const unsigned int height);
 
-		ClusteredImageType::Pointer GetClusteredOutput(const GraphType& graph,
-													   const unsigned int width,
-													   const unsigned int height);	
+		/* Label image where the i-th node of the graph has the label labels[i] */
+		template<class TLabelImage>
+		typename TLabelImage::Pointer GetLabelImage(const GraphType& graph,
+													const unsigned int width,
+													const unsigned int height,
+													const std::vector<typename TLabelImage::PixelType>& labels);
+
+		/*
+		 * Label image of a tile of the image: the i-th node of the graph
+		 * has the label i + 1 (or labels[i]) in every tile. Each region
+		 * is filled from its contour and the regions are drawn by
+		 * decreasing area of their bounding box, so that the regions
+		 * enclosed by another one are drawn over it. The regions are
+		 * filled in parallel, then drawn by bands of rows in parallel.
+		 */
+		LabelImageType::Pointer GetTileLabelImage(const GraphType& graph,
+												  const unsigned int width,
+												  const lp::BoundingBox& tile);
+
+		template<class TLabelImage>
+		typename TLabelImage::Pointer GetTileLabelImage(const GraphType& graph,
+														const unsigned int width,
+														const lp::BoundingBox& tile,
+														const std::vector<typename TLabelImage::PixelType>& labels);
+
+		/*
+		 * Image of numberOfComponents bands where the i-th node is
+		 * painted with the values colors[i * numberOfComponents...],
+		 * for instance the means of the regions in each band. The
+		 * pixels outside the regions are null.
+		 */
+		template<class TImage>
+		typename TImage::Pointer GetClusteredOutput(const GraphType& graph,
+													const unsigned int width,
+													const unsigned int height,
+													const unsigned int numberOfComponents,
+													const std::vector<typename TImage::InternalPixelType>& colors);
+
+		/* Deterministic RGB color of a region given its id, never dark */
+		static void GetHashColor(const uint64_t id, ClusterPixelType * color);
+
+		/*
+		 * Given the number of pixels of a tile and the number of regions
+		 * drawn on it, this method estimates the memory (in bytes) of the
+		 * work buffers of GetTileLabelImage, the label image excepted: the
+		 * labels and the drawing order of the regions, their runs (at most
+		 * one per pixel), the lists of the bands of rows, and the grid and
+		 * flood fill stack of the largest bounding box (at most the tile).
+		 */
+		static std::size_t EstimateDrawingMemoryUsage(const std::size_t numberOfPixels,
+													  const std::size_t numberOfRegions);
+
+	private:
+
+		/* Run of pixels [m_X0, m_X1) of the row m_Y */
+		struct Span
+		{
+			unsigned int m_Y;
+			unsigned int m_X0;
+			unsigned int m_X1;
+		};
+
+		/* Labels 1, 2, 3... of the nodes of a graph */
+		static std::vector<LabelPixelType> GetSequentialLabels(const GraphType& graph);
+
+		/*
+		 * Calls draw(i, y, x0, x1) for each run of pixels [x0, x1) of the
+		 * row y of the tile inside the contour of the i-th node. The
+		 * runs of the regions are computed in parallel, then each thread
+		 * draws the runs of its own bands of rows from the runs of the
+		 * regions, by decreasing area of their bounding box.
+		 */
+		template<class F>
+		void DrawRegions(const GraphType& graph,
+						 const unsigned int width,
+						 const lp::BoundingBox& tile,
+						 F draw);
+
+		/*
+		 * Given a node, this method appends the runs of pixels of the
+		 * tile which are inside its contour, by increasing row (the
+		 * regions it encloses are included).
+		 *
+		 * @params
+		 * const NodeType * node : the node.
+		 * const unsigned int width : width of the image.
+		 * const lp::BoundingBox& tile : area of the image to cover.
+		 * std::vector<Span>& spans : runs of the region.
+		 * std::vector<unsigned char>& grid, std::vector<std::size_t>& stack : work buffers.
+		 */
+		static void GetFilledSpans(const NodeType * node,
+								   const unsigned int width,
+								   const lp::BoundingBox& tile,
+								   std::vector<Span>& spans,
+								   std::vector<unsigned char>& grid,
+								   std::vector<std::size_t>& stack);
+
+		unsigned int m_NumberOfThreads;
 	};
 	
 } // end of namespace grm
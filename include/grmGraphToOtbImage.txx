@@ -19,123 +19,306 @@
 #define GRM_GRAPH_TO_OTBIMAGE_TXX
 #include "grmGraphToOtbImage.h"
 #include "itkImageRegionIterator.h"
-#include "itkGrayscaleFillholeImageFilter.h"
+#include <algorithm>
+#include <mutex>
+#include <numeric>
 
 namespace grm
 {
+	template<class TGraph>
+	std::vector<typename GraphToOtbImage<TGraph>::LabelPixelType>
+	GraphToOtbImage<TGraph>::GetSequentialLabels(const GraphType& graph)
+	{
+		// Start at 1 (value 0 can be used for invalid pixels)
+		std::vector<LabelPixelType> labels(graph.m_Nodes.size());
+		for(std::size_t i = 0; i < labels.size(); ++i)
+			labels[i] = i + 1;
+		return labels;
+	}
+
 	template<class TGraph>
 	typename GraphToOtbImage<TGraph>::LabelImageType::Pointer
 	GraphToOtbImage<TGraph>::GetLabelImage(const GraphType& graph,
 										   const unsigned int width,
 										   const unsigned int height)
 	{
-		LabelImageType::IndexType index;
-		LabelImageType::SizeType size;
-		LabelImageType::RegionType region;
+		return GetLabelImage<LabelImageType>(graph, width, height, GetSequentialLabels(graph));
+	}
+
+	template<class TGraph>
+	template<class TLabelImage>
+	typename TLabelImage::Pointer
+	GraphToOtbImage<TGraph>::GetLabelImage(const GraphType& graph,
+										   const unsigned int width,
+										   const unsigned int height,
+										   const std::vector<typename TLabelImage::PixelType>& labels)
+	{
+		const lp::BoundingBox image = {0, 0, width, height};
+		return GetTileLabelImage<TLabelImage>(graph, width, image, labels);
+	}
+
+	template<class TGraph>
+	typename GraphToOtbImage<TGraph>::LabelImageType::Pointer
+	GraphToOtbImage<TGraph>::GetTileLabelImage(const GraphType& graph,
+											   const unsigned int width,
+											   const lp::BoundingBox& tile)
+	{
+		return GetTileLabelImage<LabelImageType>(graph, width, tile, GetSequentialLabels(graph));
+	}
+
+	template<class TGraph>
+	template<class TLabelImage>
+	typename TLabelImage::Pointer
+	GraphToOtbImage<TGraph>::GetTileLabelImage(const GraphType& graph,
+											   const unsigned int width,
+											   const lp::BoundingBox& tile,
+											   const std::vector<typename TLabelImage::PixelType>& labels)
+	{
+		typename TLabelImage::IndexType index;
+		typename TLabelImage::SizeType size;
+		typename TLabelImage::RegionType region;
 
 		index[0] = 0; index[1] = 0;
-		size[0] = width; size[1] = height;
+		size[0] = tile.m_W; size[1] = tile.m_H;
 		region.SetIndex(index);
 		region.SetSize(size);
 
-		LabelImageType::Pointer label_img = LabelImageType::New();
+		typename TLabelImage::Pointer label_img = TLabelImage::New();
 		label_img->SetRegions(region);
 		label_img->Allocate();
+		label_img->FillBuffer(0);
+		typename TLabelImage::PixelType * pixels = label_img->GetBufferPointer();
 
-		using LabelImageIterator = itk::ImageRegionIterator<LabelImageType>;
-		LabelImageIterator it(label_img, label_img->GetLargestPossibleRegion());
-		for(it.GoToBegin();!it.IsAtEnd(); ++it)
-			it.Set(0);
-		
-		// Start at 1 (value 0 can be used for invalid pixels)
-		unsigned int label = 1;
-		for(auto& node : graph.m_Nodes)
+		DrawRegions(graph, width, tile, [&](const std::size_t i, const unsigned int y, const unsigned int x0, const unsigned int x1)
+			{
+				typename TLabelImage::PixelType * first = pixels + static_cast<std::size_t>(y - tile.m_UY) * tile.m_W + x0 - tile.m_UX;
+				std::fill(first, first + (x1 - x0), labels[i]);
+			});
+
+		return label_img;
+	}
+
+	template<class TGraph>
+	void
+	GraphToOtbImage<TGraph>::GetFilledSpans(const NodeType * node,
+											const unsigned int width,
+											const lp::BoundingBox& tile,
+											std::vector<Span>& spans,
+											std::vector<unsigned char>& grid,
+											std::vector<std::size_t>& stack)
+	{
+		// Grid of the bounding box with a margin of one cell: the cells
+		// which cannot be reached from the margin without crossing the
+		// border of the region are inside it.
+		const unsigned char Unknown = 0, Border = 1, Outside = 2;
+		const lp::BoundingBox& bbox = node->m_Bbox;
+		const std::size_t gridWidth = bbox.m_W + 2, gridHeight = bbox.m_H + 2;
+		grid.assign(gridWidth * gridHeight, Unknown);
+
+		lp::CellLists borderPixels;
+		ContourOperator::GenerateBorderCells(borderPixels, node->m_Contour, node->m_Id, width);
+		for(auto& pix : borderPixels)
+			grid[(pix / width - bbox.m_UY + 1) * gridWidth + pix % width - bbox.m_UX + 1] = Border;
+
+		grid[0] = Outside;
+		stack.assign(1, 0);
+		while(!stack.empty())
 		{
-			lp::CellLists borderPixels;
-			ContourOperator::GenerateBorderCells(borderPixels, node->m_Contour, node->m_Id, width);
-			
-			for (auto& pix: borderPixels)
+			const std::size_t c = stack.back();
+			stack.pop_back();
+			const std::size_t x = c % gridWidth, y = c / gridWidth;
+			const std::size_t neighbors[4] = {c - gridWidth, c + 1, c + gridWidth, c - 1};
+			const bool exists[4] = {y > 0, x + 1 < gridWidth, y + 1 < gridHeight, x > 0};
+			for(short j = 0; j < 4; ++j)
 			{
-				index[0] = pix % width;
-				index[1] = pix / width;
-				label_img->SetPixel(index, label);
+				if(exists[j] && grid[neighbors[j]] == Unknown)
+				{
+					grid[neighbors[j]] = Outside;
+					stack.push_back(neighbors[j]);
+				}
 			}
-			++label;
 		}
 
-        // Fill holes
-		typedef itk::GrayscaleFillholeImageFilter<LabelImageType,LabelImageType>  FillholeFilterType;
-		FillholeFilterType::Pointer fillFilter = FillholeFilterType::New();
-		fillFilter->SetInput(label_img);
-		fillFilter->Update();
-		
-		return fillFilter->GetOutput();
+		const unsigned int x0 = std::max(bbox.m_UX, tile.m_UX), x1 = std::min(bbox.m_UX + bbox.m_W, tile.m_UX + tile.m_W);
+		const unsigned int y0 = std::max(bbox.m_UY, tile.m_UY), y1 = std::min(bbox.m_UY + bbox.m_H, tile.m_UY + tile.m_H);
+		for(unsigned int y = y0; y < y1; ++y)
+		{
+			const std::size_t row = (y - bbox.m_UY + 1) * gridWidth + 1 - bbox.m_UX;
+			for(unsigned int x = x0; x < x1; ++x)
+			{
+				if(grid[row + x] == Outside)
+					continue;
+
+				Span span = {y, x, x + 1};
+				while(span.m_X1 < x1 && grid[row + span.m_X1] != Outside)
+					++span.m_X1;
+				spans.push_back(span);
+				x = span.m_X1;
+			}
+		}
 	}
 
 	template<class TGraph>
-	typename GraphToOtbImage<TGraph>::ClusteredImageType::Pointer
+	template<class F>
+	void
+	GraphToOtbImage<TGraph>::DrawRegions(const GraphType& graph,
+										 const unsigned int width,
+										 const lp::BoundingBox& tile,
+										 F draw)
+	{
+		std::vector<std::size_t> nodes;
+		for(std::size_t i = 0; i < graph.m_Nodes.size(); ++i)
+		{
+			const lp::BoundingBox& bbox = graph.m_Nodes[i]->m_Bbox;
+			if(bbox.m_UX < tile.m_UX + tile.m_W && tile.m_UX < bbox.m_UX + bbox.m_W &&
+			   bbox.m_UY < tile.m_UY + tile.m_H && tile.m_UY < bbox.m_UY + bbox.m_H)
+				nodes.push_back(i);
+		}
+
+		std::stable_sort(nodes.begin(), nodes.end(), [&](const std::size_t a, const std::size_t b)->bool{
+				const lp::BoundingBox& ba = graph.m_Nodes[a]->m_Bbox;
+				const lp::BoundingBox& bb = graph.m_Nodes[b]->m_Bbox;
+				return static_cast<uint64_t>(ba.m_W) * ba.m_H > static_cast<uint64_t>(bb.m_W) * bb.m_H;
+			});
+
+		// The shapes of the regions are independent: they are computed in
+		// parallel. The runs of the regions of a block are stored in one
+		// array, whose buffer does not move when the array is moved.
+		typedef std::pair<const Span *, const Span *> SpanRangeType;
+		std::vector<SpanRangeType> spans(nodes.size());
+		std::vector< std::vector<Span> > blocks;
+		std::mutex blocksMutex;
+		ParallelFor(0, nodes.size(), m_NumberOfThreads, [&](const std::size_t begin, const std::size_t end)
+			{
+				std::vector<Span> blockSpans;
+				std::vector<std::size_t> ends(end - begin);
+				std::vector<unsigned char> grid;
+				std::vector<std::size_t> stack;
+				for(std::size_t k = begin; k < end; ++k)
+				{
+					GetFilledSpans(graph.m_Nodes[nodes[k]], width, tile, blockSpans, grid, stack);
+					ends[k - begin] = blockSpans.size();
+				}
+				blockSpans.shrink_to_fit();
+
+				for(std::size_t k = begin; k < end; ++k)
+					spans[k] = SpanRangeType(blockSpans.data() + ((k > begin) ? ends[k - begin - 1] : 0),
+											 blockSpans.data() + ends[k - begin]);
+
+				std::lock_guard<std::mutex> lock(blocksMutex);
+				blocks.push_back(std::move(blockSpans));
+			});
+
+		// The regions are drawn straight from their runs by bands of rows
+		// in parallel: each band lists the regions which intersect it in
+		// the drawing order (counting sort), and only the runs of its rows
+		// are visited, the runs of a region being sorted by row.
+		const std::size_t numberOfBands = std::max<std::size_t>(1, std::min<std::size_t>(tile.m_H, 8 * grm::GetNumberOfThreads(m_NumberOfThreads)));
+		const std::size_t bandHeight = (tile.m_H + numberOfBands - 1) / numberOfBands;
+		auto firstBand = [&](const std::size_t k){ return (spans[k].first->m_Y - tile.m_UY) / bandHeight; };
+		auto lastBand = [&](const std::size_t k){ return ((spans[k].second - 1)->m_Y - tile.m_UY) / bandHeight; };
+
+		std::vector<std::size_t> offsets(numberOfBands + 1, 0);
+		for(std::size_t k = 0; k < nodes.size(); ++k)
+		{
+			if(spans[k].first == spans[k].second)
+				continue;
+			for(std::size_t band = firstBand(k); band <= lastBand(k); ++band)
+				++offsets[band + 1];
+		}
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+		std::vector<std::size_t> bandRegions(offsets.back());
+		std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+		for(std::size_t k = 0; k < nodes.size(); ++k)
+		{
+			if(spans[k].first == spans[k].second)
+				continue;
+			for(std::size_t band = firstBand(k); band <= lastBand(k); ++band)
+				bandRegions[next[band]++] = k;
+		}
+
+		ParallelFor(0, numberOfBands, m_NumberOfThreads, [&](const std::size_t begin, const std::size_t end)
+			{
+				for(std::size_t band = begin; band < end; ++band)
+				{
+					const unsigned int y0 = tile.m_UY + band * bandHeight;
+					const unsigned int y1 = std::min<std::size_t>(y0 + bandHeight, tile.m_UY + tile.m_H);
+					for(std::size_t pos = offsets[band]; pos < offsets[band + 1]; ++pos)
+					{
+						const std::size_t k = bandRegions[pos];
+						const Span * span = std::lower_bound(spans[k].first, spans[k].second, y0, [](const Span& s, const unsigned int y)->bool{
+								return s.m_Y < y;
+							});
+						for(; span != spans[k].second && span->m_Y < y1; ++span)
+							draw(nodes[k], span->m_Y, span->m_X0, span->m_X1);
+					}
+				}
+			});
+	}
+
+	template<class TGraph>
+	std::size_t
+	GraphToOtbImage<TGraph>::EstimateDrawingMemoryUsage(const std::size_t numberOfPixels,
+														const std::size_t numberOfRegions)
+	{
+		// A region has a label, an entry in the drawing order, the range
+		// of its runs and usually an entry in a single band.
+		const std::size_t regionSize = sizeof(LabelPixelType) + 2 * sizeof(std::size_t) + 2 * sizeof(const Span *);
+		const std::size_t pixelSize = sizeof(Span) + sizeof(unsigned char) + sizeof(std::size_t);
+		return numberOfRegions * regionSize + numberOfPixels * pixelSize;
+	}
+
+	template<class TGraph>
+	void
+	GraphToOtbImage<TGraph>::GetHashColor(const uint64_t id, ClusterPixelType * color)
+	{
+		// Finalizer of splitmix64: close ids get unrelated colors.
+		uint64_t h = id + 0x9E3779B97F4A7C15ULL;
+		h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+		h = h ^ (h >> 31);
+
+		// Dark colors are avoided: black is the color of the masked pixels.
+		for(short c = 0; c < 3; ++c)
+			color[c] = 32 + (h >> (16 * c)) % 224;
+	}
+
+	template<class TGraph>
+	template<class TImage>
+	typename TImage::Pointer
 	GraphToOtbImage<TGraph>::GetClusteredOutput(const GraphType& graph,
 												const unsigned int width,
-												const unsigned int height)
+												const unsigned int height,
+												const unsigned int numberOfComponents,
+												const std::vector<typename TImage::InternalPixelType>& colors)
 	{
-		ClusteredImageType::IndexType index;
-		ClusteredImageType::SizeType size;
-		ClusteredImageType::RegionType region;
+		typename TImage::IndexType index;
+		typename TImage::SizeType size;
+		typename TImage::RegionType region;
 
 		index[0] = 0; index[1] = 0;
 		size[0] = width; size[1] = height;
 		region.SetIndex(index);
 		region.SetSize(size);
 
-		ClusteredImageType::Pointer clusterImg = ClusteredImageType::New();
+		typename TImage::Pointer clusterImg = TImage::New();
 		clusterImg->SetRegions(region);
-		clusterImg->SetNumberOfComponentsPerPixel(3);
+		clusterImg->SetNumberOfComponentsPerPixel(numberOfComponents);
 		clusterImg->Allocate();
 
-		ClusteredImageType::PixelType pixelValue;
-		pixelValue.Reserve(3);
-		pixelValue[0] = 255;
-		pixelValue[1] = 255;
-		pixelValue[2] = 255;
-
-		using ClusterImageIterator = itk::ImageRegionIterator<ClusteredImageType>;
-		ClusterImageIterator it(clusterImg, clusterImg->GetLargestPossibleRegion());
-		for(it.GoToBegin();!it.IsAtEnd(); ++it)
-			it.Set(pixelValue);
+		typename TImage::InternalPixelType * pixels = clusterImg->GetBufferPointer();
+		std::fill(pixels, pixels + static_cast<std::size_t>(width) * height * numberOfComponents, 0);
 
-		srand(time(NULL));
-		unsigned char c1, c2, c3;
-		for(auto& node : graph.m_Nodes)
-		{
-			auto rv = rand() % 255;
-			c1 = rv;//rand() % 256;
-			c2 = rv;//rand() % 256;
-			c3 = rv;//rand() % 256;
-
-			lp::CellLists borderPixels;
-			ContourOperator::GenerateBorderCells(borderPixels, node->m_Contour, node->m_Id, width);
-			
-			for (auto& pix : borderPixels)
+		const lp::BoundingBox image = {0, 0, width, height};
+		DrawRegions(graph, width, image, [&](const std::size_t i, const unsigned int y, const unsigned int x0, const unsigned int x1)
 			{
-				index[0] = pix % width;
-				index[1] = pix / width;
-				pixelValue[0] = c1;
-				pixelValue[1] = c2;
-				pixelValue[2] = c3;
-				clusterImg->SetPixel(index, pixelValue);
-			}
-		}
+				const typename TImage::InternalPixelType * color = &colors[i * numberOfComponents];
+				typename TImage::InternalPixelType * pixel = pixels + (static_cast<std::size_t>(y) * width + x0) * numberOfComponents;
+				for(unsigned int x = x0; x < x1; ++x, pixel += numberOfComponents)
+					std::copy(color, color + numberOfComponents, pixel);
+			});
 
-		
-		for(it.GoToBegin(); !it.IsAtEnd(); ++it)
-		{
-			auto pixel = it.Get();
-			if(pixel[0] == 255 && pixel[1] == 255 && pixel[2] == 255)
-				it.Set(pixelValue);
-			else
-				pixelValue = pixel;
-		}
-		
 		return clusterImg;
 	}
 		
@@ -0,0 +1,130 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_MEMORY_MAPPED_STORAGE_H
+#define GRM_MEMORY_MAPPED_STORAGE_H
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
+
+namespace grm
+{
+	/*
+	 * Memory pool carved out of a file mapped in memory. The file is created
+	 * in a user-given directory (typically on a local SSD) and unlinked
+	 * right away, so the operating system can page the graph out to it
+	 * instead of the swap and nothing is left behind if the process dies.
+	 *
+	 * The file grows by segments which are never moved, hence the returned
+	 * pointers stay valid until the storage is destroyed. Released blocks
+	 * are chained in free lists by rounded size and reused first.
+	 *
+	 * A storage built without a directory maps anonymous memory instead of
+	 * a file: it is then only a pool recycling the released blocks.
+	 */
+	class MemoryMappedStorage
+	{
+	public:
+
+		MemoryMappedStorage(const std::size_t segmentSize = 64 * 1024 * 1024);
+		MemoryMappedStorage(const std::string& directory,
+							const std::size_t segmentSize = 64 * 1024 * 1024);
+		~MemoryMappedStorage();
+
+		MemoryMappedStorage(const MemoryMappedStorage&) = delete;
+		MemoryMappedStorage& operator=(const MemoryMappedStorage&) = delete;
+
+		void * Allocate(const std::size_t numberOfBytes);
+		void Deallocate(void * ptr, const std::size_t numberOfBytes);
+
+		/* Number of bytes (of the file if any) currently mapped in memory */
+		std::size_t GetMappedSize() const { return m_FileSize; }
+
+		/* Size of the block taken by an allocation of the given number of bytes */
+		static std::size_t RoundSize(const std::size_t numberOfBytes);
+
+	private:
+		void MapNewSegment(const std::size_t minimumSize);
+
+		int m_FileDescriptor;
+		std::size_t m_FileSize;
+		std::size_t m_SegmentSize;
+
+		/* Mapped segments of the file (address, length) */
+		std::vector< std::pair<char *, std::size_t> > m_Segments;
+
+		/* Unused part of the last segment */
+		char * m_Cursor;
+		char * m_End;
+
+		/* Heads of the intrusive free lists indexed by rounded size */
+		std::unordered_map<std::size_t, void *> m_FreeLists;
+	};
+
+	/*
+	 * Standard allocator forwarding to a MemoryMappedStorage. A default
+	 * constructed allocator (null storage) falls back on the heap, so
+	 * containers using it behave as usual when no storage is set.
+	 */
+	template<class T>
+	struct StorageAllocator
+	{
+		typedef T value_type;
+		typedef std::true_type propagate_on_container_copy_assignment;
+		typedef std::true_type propagate_on_container_move_assignment;
+		typedef std::true_type propagate_on_container_swap;
+
+		StorageAllocator() : m_Storage(nullptr) {}
+		explicit StorageAllocator(MemoryMappedStorage * storage) : m_Storage(storage) {}
+		template<class U>
+		StorageAllocator(const StorageAllocator<U>& other) : m_Storage(other.m_Storage) {}
+
+		T * allocate(std::size_t n)
+		{
+			if(m_Storage == nullptr)
+				return static_cast<T*>(::operator new(n * sizeof(T)));
+			return static_cast<T*>(m_Storage->Allocate(n * sizeof(T)));
+		}
+
+		void deallocate(T * ptr, std::size_t n)
+		{
+			if(m_Storage == nullptr)
+				::operator delete(ptr);
+			else
+				m_Storage->Deallocate(ptr, n * sizeof(T));
+		}
+
+		MemoryMappedStorage * m_Storage;
+	};
+
+	template<class T, class U>
+	inline bool operator==(const StorageAllocator<T>& a, const StorageAllocator<U>& b)
+	{
+		return a.m_Storage == b.m_Storage;
+	}
+
+	template<class T, class U>
+	inline bool operator!=(const StorageAllocator<T>& a, const StorageAllocator<U>& b)
+	{
+		return a.m_Storage != b.m_Storage;
+	}
+	
+} // end of namespace grm
+#endif
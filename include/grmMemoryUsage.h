@@ -0,0 +1,45 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_MEMORY_USAGE_H
+#define GRM_MEMORY_USAGE_H
+#include <cstddef>
+
+namespace grm
+{
+	/* Resident set size of the process in bytes (0 if unknown). */
+	std::size_t GetCurrentMemoryUsage();
+
+	/* Peak resident set size of the process in bytes (0 if unknown). */
+	std::size_t GetPeakMemoryUsage();
+
+	/*
+	  Reset the peak resident set size to the current one so that the
+	  next call to GetPeakMemoryUsage only covers what follows.
+	  Only effective on Linux, ignored elsewhere.
+	*/
+	void ResetPeakMemoryUsage();
+
+	/*
+	  Size of the block taken on the heap by an allocation of the given
+	  number of bytes (0 for none): the usual allocators add a header and
+	  round the blocks to 16 bytes.
+	*/
+	std::size_t GetHeapBlockSize(const std::size_t numberOfBytes);
+	
+} // end of namespace grm
+#endif
@@ -0,0 +1,195 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_MULTI_RESOLUTION_SEGMENTER_H
+#define GRM_MULTI_RESOLUTION_SEGMENTER_H
+#include <itkRegionOfInterestImageFilter.h>
+#include "grmMacroGenerator.h"
+#include "grmMemoryMappedStorage.h"
+#include "grmNeighborhood.h"
+#include "lpContour.h"
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace grm
+{
+	/*
+	 * Coarse-to-fine region merging segmentation.
+	 *
+	 * The image is first shrunk by averaging blocks of m_ShrinkFactor x
+	 * m_ShrinkFactor pixels and the shrunk image is segmented. A block
+	 * whose 8 neighbors have its label is inside a coarse region: the
+	 * 4-connected groups of such blocks become the initial regions of
+	 * the full resolution graph (cores), and only the pixels of the
+	 * other blocks, along the borders of the coarse regions, start as
+	 * single pixels. The merging iterations then go on at full
+	 * resolution, the pixels refining the borders between the cores.
+	 *
+	 * The graph of the whole image is built by strips: the pixels of a
+	 * strip get their attributes from a segmenter initialized on it and
+	 * are accumulated into their core with UpdateSpecificAttributes,
+	 * which has to only depend on the attributes and on the areas of
+	 * both nodes (the built-in criteria). The mask and the no-data value
+	 * are not supported.
+	 *
+	 * A core is never split: a coarse region gathering pixels which the
+	 * full resolution segmentation would separate stays merged, hence
+	 * the threshold of the coarse level can be lowered with
+	 * SetCoarseThresholdFactor.
+	 *
+	 * The memory budget of the configured segmenter applies to both
+	 * levels: the coarse level is checked by its Update, and the full
+	 * resolution segmentation once the number of refined pixels is
+	 * known, before the graph is built.
+	 */
+	template<class TSegmenter>
+	class MultiResolutionSegmenter
+	{
+	public:
+
+		/* Some convenient typedefs */
+		typedef TSegmenter SegmenterType;
+		typedef typename SegmenterType::ImageType ImageType;
+		typedef typename SegmenterType::GraphOperatorType GraphOperatorType;
+		typedef typename GraphOperatorType::NodePointerType NodePointerType;
+		typedef typename SegmenterType::EdgeType EdgeType;
+		typedef itk::RegionOfInterestImageFilter<ImageType, ImageType> ExtractFilterType;
+
+		/* Function setting the parameters of the segmenters (criterion, threshold...) */
+		typedef std::function<void(SegmenterType&)> ConfigureFunctionType;
+
+		MultiResolutionSegmenter() :
+			m_InputImage(nullptr), m_ShrinkFactor(4), m_CoarseThresholdFactor(1.0f),
+			m_ImageWidth(0), m_ImageHeight(0), m_NumberOfCores(0), m_NumberOfRefinedPixels(0) {}
+
+		/*
+		 * This method segments the shrunk image, builds the full
+		 * resolution graph from its regions and performs the merging
+		 * iterations on it. With a shrink factor of 1, it is the
+		 * segmentation of the full resolution image.
+		 */
+		void Update();
+
+		/* Set methods */
+		GRMSetMacro(unsigned int, ShrinkFactor);
+		GRMSetMacro(float, CoarseThresholdFactor);
+		GRMSetMacro(ConfigureFunctionType, ConfigureFunction);
+		inline void SetInput(ImageType * in){ m_InputImage = in;}
+
+		/* Get methods */
+		GRMGetMacro(unsigned int, ShrinkFactor);
+		GRMGetMacro(float, CoarseThresholdFactor);
+
+		/* Number of initial regions taken from the coarse level and of pixels starting alone (set by Update) */
+		GRMGetMacro(std::size_t, NumberOfCores);
+		GRMGetMacro(std::size_t, NumberOfRefinedPixels);
+
+		/* Segmenter holding the graph of the whole image after Update */
+		GRMGetRefMacro(SegmenterType, Segmenter);
+
+	private:
+
+		/* Core of the pixels of a block along the borders of the coarse regions */
+		static const unsigned int NoCore = std::numeric_limits<unsigned int>::max();
+
+		/* Number of pixels of the strips of the graph construction if the segmenter does not set it */
+		static const std::size_t DefaultNumberOfPixelsPerStrip = 1024 * 1024;
+
+		/*
+		 * Averages the blocks of the input image, segments the shrunk
+		 * image and returns the label of each block (row-major order).
+		 */
+		void SegmentCoarseLevel(std::vector<unsigned int>& coarseLabels);
+
+		/*
+		 * Given the labels of the blocks, this method returns the core of
+		 * each block (NoCore along the borders of the coarse regions) and
+		 * the blocks of each core, in row-major order.
+		 */
+		void GetCores(const std::vector<unsigned int>& coarseLabels,
+					  std::vector<unsigned int>& coreOfBlock,
+					  std::vector<std::vector<std::size_t> >& blocksOfCore);
+
+		/*
+		 * Given the cores, this method estimates the peak memory (in
+		 * bytes) of the full resolution segmentation: the graph of the
+		 * cores and of the refined pixels, the graph of a strip during
+		 * the construction, and the outputs (see
+		 * Segmenter::EstimateMemoryUsage).
+		 */
+		std::size_t EstimateMemoryUsage(const std::vector<unsigned int>& coreOfBlock,
+										const std::vector<std::vector<std::size_t> >& blocksOfCore);
+
+		/* Number of rows of the strips of the graph construction */
+		unsigned int GetStripHeight();
+
+		/*
+		 * Builds the full resolution graph strip by strip: a node per
+		 * core and per pixel outside the cores.
+		 */
+		void BuildGraph(const std::vector<unsigned int>& coreOfBlock,
+						const std::vector<std::vector<std::size_t> >& blocksOfCore);
+
+		/* Sets the area, perimeter, bounding box and contour of a core from its blocks */
+		void SetCoreShape(NodePointerType core,
+						  const unsigned int coreIndex,
+						  const std::vector<unsigned int>& coreOfBlock,
+						  const std::vector<std::size_t>& blocks);
+
+		/* Core of a pixel of the full resolution image */
+		unsigned int GetCore(const std::vector<unsigned int>& coreOfBlock,
+							 const unsigned int x,
+							 const unsigned int y) const
+		{
+			return coreOfBlock[static_cast<std::size_t>(y / m_ShrinkFactor) * GetCoarseWidth() + x / m_ShrinkFactor];
+		}
+
+		/* Size of the shrunk image (the last blocks of a row or a column may be smaller) */
+		unsigned int GetCoarseWidth() const { return (m_ImageWidth + m_ShrinkFactor - 1) / m_ShrinkFactor; }
+		unsigned int GetCoarseHeight() const { return (m_ImageHeight + m_ShrinkFactor - 1) / m_ShrinkFactor; }
+
+		/* Area of the full resolution image covered by a block */
+		lp::BoundingBox GetBlock(const std::size_t block) const;
+
+		/* Applies the configuration function to a segmenter */
+		void Configure(SegmenterType& seg);
+
+		typename ExtractFilterType::Pointer ExtractStrip(const unsigned int y, const unsigned int numberOfLines);
+
+		/* Input image of full resolution */
+		ImageType * m_InputImage;
+
+		/* Size (in pixels) of the side of the blocks averaged into a pixel of the coarse level */
+		unsigned int m_ShrinkFactor;
+
+		/* Threshold of the coarse level relative to the threshold of the configuration */
+		float m_CoarseThresholdFactor;
+
+		ConfigureFunctionType m_ConfigureFunction;
+
+		unsigned int m_ImageWidth;
+		unsigned int m_ImageHeight;
+
+		std::size_t m_NumberOfCores;
+		std::size_t m_NumberOfRefinedPixels;
+
+		SegmenterType m_Segmenter;
+	};
+} // end of namespace grm
+#include "grmMultiResolutionSegmenter.txx"
+#endif
@@ -0,0 +1,491 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_MULTI_RESOLUTION_SEGMENTER_TXX
+#define GRM_MULTI_RESOLUTION_SEGMENTER_TXX
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <itkImageRegionIterator.h>
+#include "grmMultiResolutionSegmenter.h"
+
+namespace grm
+{
+	template<class TSegmenter>
+	void
+	MultiResolutionSegmenter<TSegmenter>::Update()
+	{
+		if(m_InputImage == nullptr)
+			throw std::runtime_error("MultiResolutionSegmenter::Update - No input image is set");
+		if(m_ShrinkFactor == 0)
+			throw std::runtime_error("MultiResolutionSegmenter::Update - The shrink factor has to be at least 1");
+
+		Configure(m_Segmenter);
+		m_Segmenter.SetInput(m_InputImage);
+		m_NumberOfCores = 0;
+		m_NumberOfRefinedPixels = 0;
+		if(m_ShrinkFactor == 1)
+		{
+			m_Segmenter.Update();
+			return;
+		}
+
+		m_Segmenter.GetStatistics().Clear();
+		auto start = std::chrono::steady_clock::now();
+
+		m_InputImage->UpdateOutputInformation();
+		m_ImageWidth = m_InputImage->GetLargestPossibleRegion().GetSize()[0];
+		m_ImageHeight = m_InputImage->GetLargestPossibleRegion().GetSize()[1];
+		if(static_cast<uint64_t>(m_ImageWidth) * m_ImageHeight > std::numeric_limits<unsigned int>::max())
+			throw std::runtime_error("MultiResolutionSegmenter::Update - The image has too many pixels for a single graph");
+
+		m_Segmenter.GetValidPixels().clear();
+		if(m_Segmenter.GetMask() != nullptr || m_Segmenter.GetUseNoDataValue())
+			throw std::runtime_error("MultiResolutionSegmenter::Update - The mask and the no-data value are not supported");
+
+		m_Segmenter.SetImageWidth(m_ImageWidth);
+		m_Segmenter.SetImageHeight(m_ImageHeight);
+		m_Segmenter.SetNumberOfComponentsPerPixel(m_InputImage->GetNumberOfComponentsPerPixel());
+		m_Segmenter.GetFeatureAccumulators().SetNumberOfComponentsPerPixel(m_InputImage->GetNumberOfComponentsPerPixel());
+
+		std::vector<unsigned int> coreOfBlock;
+		std::vector<std::vector<std::size_t> > blocksOfCore;
+		{
+			std::vector<unsigned int> coarseLabels;
+			SegmentCoarseLevel(coarseLabels);
+			GetCores(coarseLabels, coreOfBlock, blocksOfCore);
+		}
+
+		const std::size_t estimate = EstimateMemoryUsage(coreOfBlock, blocksOfCore);
+		const std::size_t memoryBudget = m_Segmenter.GetMemoryBudget();
+		m_Segmenter.GetStatistics().m_EstimatedMemoryUsage = estimate;
+		if(memoryBudget > 0 && estimate > memoryBudget)
+		{
+			throw std::runtime_error("MultiResolutionSegmenter::Update - The full resolution segmentation needs about " +
+									 std::to_string(estimate / (1024 * 1024) + 1) + " MB, more than the memory budget of " +
+									 std::to_string(memoryBudget / (1024 * 1024)) +
+									 " MB: build the graph by shorter strips (SetNumberOfLinesPerStrip) or segment the image by tiles (DistributedSegmenter)");
+		}
+
+		BuildGraph(coreOfBlock, blocksOfCore);
+
+		m_Segmenter.GetStatistics().m_InitializationTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		m_Segmenter.GetStatistics().m_InitialNumberOfNodes = m_Segmenter.m_Graph.m_Nodes.size();
+
+		m_Segmenter.MergeRegions();
+	}
+
+	template<class TSegmenter>
+	void
+	MultiResolutionSegmenter<TSegmenter>::SegmentCoarseLevel(std::vector<unsigned int>& coarseLabels)
+	{
+		typedef typename ImageType::InternalPixelType InternalPixelType;
+
+		const unsigned int coarseWidth = GetCoarseWidth();
+		const unsigned int coarseHeight = GetCoarseHeight();
+		const std::size_t bands = m_InputImage->GetNumberOfComponentsPerPixel();
+
+		// Sums of the blocks, the input image being read by strips.
+		std::vector<double> sums(static_cast<std::size_t>(coarseWidth) * coarseHeight * bands, 0.0);
+		m_Segmenter.ForEachPixelByStrips(m_InputImage, [&](const std::size_t idx, const typename ImageType::PixelType& pixel)
+			{
+				const std::size_t x = idx % m_ImageWidth, y = idx / m_ImageWidth;
+				double * sum = &sums[((y / m_ShrinkFactor) * coarseWidth + x / m_ShrinkFactor) * bands];
+				for(std::size_t b = 0; b < bands; ++b)
+					sum[b] += static_cast<double>(pixel[b]);
+			});
+
+		typename ImageType::Pointer coarseImage = ImageType::New();
+		typename ImageType::RegionType region;
+		region.SetIndex(0, 0);
+		region.SetIndex(1, 0);
+		region.SetSize(0, coarseWidth);
+		region.SetSize(1, coarseHeight);
+		coarseImage->SetRegions(region);
+		coarseImage->SetNumberOfComponentsPerPixel(bands);
+		coarseImage->Allocate();
+
+		// The means of the integer images are rounded.
+		typename ImageType::PixelType mean(bands);
+		std::size_t block = 0;
+		itk::ImageRegionIterator<ImageType> it(coarseImage, region);
+		for(it.GoToBegin(); !it.IsAtEnd(); ++it, ++block)
+		{
+			const lp::BoundingBox area = GetBlock(block);
+			const double numberOfPixels = static_cast<double>(area.m_W) * area.m_H;
+			for(std::size_t b = 0; b < bands; ++b)
+			{
+				const double value = sums[block * bands + b] / numberOfPixels;
+				mean[b] = static_cast<InternalPixelType>(std::is_integral<InternalPixelType>::value ? std::round(value) : value);
+			}
+			it.Set(mean);
+		}
+		std::vector<double>().swap(sums);
+
+		SegmenterType seg;
+		Configure(seg);
+		seg.SetThreshold(seg.GetThreshold() * m_CoarseThresholdFactor);
+		seg.SetMinimumRegionSize(0);
+		seg.SetInput(coarseImage);
+		seg.Update();
+
+		auto labelImage = seg.GetLabeledClusteredOutput();
+		const auto * labels = labelImage->GetBufferPointer();
+		coarseLabels.assign(labels, labels + static_cast<std::size_t>(coarseWidth) * coarseHeight);
+	}
+
+	template<class TSegmenter>
+	void
+	MultiResolutionSegmenter<TSegmenter>::GetCores(const std::vector<unsigned int>& coarseLabels,
+												   std::vector<unsigned int>& coreOfBlock,
+												   std::vector<std::vector<std::size_t> >& blocksOfCore)
+	{
+		const unsigned int coarseWidth = GetCoarseWidth();
+		const unsigned int coarseHeight = GetCoarseHeight();
+
+		// A block is inside its coarse region if its 8 neighbors have its label.
+		const unsigned int noCore = NoCore, Unvisited = NoCore - 1;
+		coreOfBlock.assign(coarseLabels.size(), noCore);
+		long int neighborhood[8];
+		for(std::size_t block = 0; block < coarseLabels.size(); ++block)
+		{
+			EIGHTNeighborhood(neighborhood, block, coarseWidth, coarseHeight);
+			bool inside = true;
+			for(short j = 0; j < 8 && inside; ++j)
+				inside = (neighborhood[j] < 0 || coarseLabels[neighborhood[j]] == coarseLabels[block]);
+			if(inside)
+				coreOfBlock[block] = Unvisited;
+		}
+
+		// The 4-connected groups of inner blocks are the cores, numbered
+		// by their first block. Two of them are never adjacent: the inner
+		// neighbors of an inner block have its label, hence its core.
+		blocksOfCore.clear();
+		std::vector<std::size_t> stack;
+		for(std::size_t first = 0; first < coreOfBlock.size(); ++first)
+		{
+			if(coreOfBlock[first] != Unvisited)
+				continue;
+
+			const unsigned int core = blocksOfCore.size();
+			blocksOfCore.emplace_back();
+			coreOfBlock[first] = core;
+			stack.assign(1, first);
+			while(!stack.empty())
+			{
+				const std::size_t block = stack.back();
+				stack.pop_back();
+				blocksOfCore.back().push_back(block);
+
+				FOURNeighborhood(neighborhood, block, coarseWidth, coarseHeight);
+				for(short j = 0; j < 4; ++j)
+				{
+					if(neighborhood[j] > -1 && coreOfBlock[neighborhood[j]] == Unvisited)
+					{
+						coreOfBlock[neighborhood[j]] = core;
+						stack.push_back(neighborhood[j]);
+					}
+				}
+			}
+			std::sort(blocksOfCore.back().begin(), blocksOfCore.back().end());
+		}
+		m_NumberOfCores = blocksOfCore.size();
+	}
+
+	template<class TSegmenter>
+	std::size_t
+	MultiResolutionSegmenter<TSegmenter>::EstimateMemoryUsage(const std::vector<unsigned int>& coreOfBlock,
+															  const std::vector<std::vector<std::size_t> >& blocksOfCore)
+	{
+		const unsigned int bands = m_InputImage->GetNumberOfComponentsPerPixel();
+		const std::size_t numberOfPixels = static_cast<std::size_t>(m_ImageWidth) * m_ImageHeight;
+
+		std::size_t numberOfRefinedPixels = 0, numberOfBorderBlocks = 0;
+		for(std::size_t block = 0; block < coreOfBlock.size(); ++block)
+		{
+			if(coreOfBlock[block] == NoCore)
+			{
+				const lp::BoundingBox b = GetBlock(block);
+				numberOfRefinedPixels += static_cast<std::size_t>(b.m_W) * b.m_H;
+				++numberOfBorderBlocks;
+			}
+		}
+		const std::size_t numberOfNodes = blocksOfCore.size() + numberOfRefinedPixels;
+
+		// The edges of the cores lead to the refined pixels along them.
+		const std::size_t graphSize = numberOfNodes * m_Segmenter.EstimateNodeMemoryUsage(bands) +
+			numberOfRefinedPixels * sizeof(EdgeType);
+
+		// The graph of a strip, always in memory and never merged, and its pixels
+		SegmenterType seg;
+		Configure(seg);
+		seg.SetStorageDirectory("");
+		const std::size_t stripPixels = static_cast<std::size_t>(GetStripHeight()) * m_ImageWidth;
+		const std::size_t stripSize = stripPixels * (seg.EstimatePixelMemoryUsage(bands) + bands * sizeof(typename ImageType::InternalPixelType));
+
+		// Cores of the blocks, blocks of the cores and the last two rows of nodes
+		const std::size_t coresSize = coreOfBlock.size() * sizeof(unsigned int) +
+			(coreOfBlock.size() - numberOfBorderBlocks) * sizeof(std::size_t) +
+			blocksOfCore.size() * (sizeof(std::vector<std::size_t>) + sizeof(NodePointerType)) +
+			2 * static_cast<std::size_t>(m_ImageWidth) * sizeof(NodePointerType);
+
+		// The strips are released before the outputs are drawn.
+		return graphSize + std::max(stripSize + coresSize, m_Segmenter.EstimateOutputMemoryUsage(numberOfPixels, numberOfNodes));
+	}
+
+	template<class TSegmenter>
+	unsigned int
+	MultiResolutionSegmenter<TSegmenter>::GetStripHeight()
+	{
+		unsigned int numberOfLines = m_Segmenter.GetNumberOfLinesPerStrip();
+		if(numberOfLines == 0)
+			numberOfLines = DefaultNumberOfPixelsPerStrip / m_ImageWidth;
+		return std::max(1u, std::min(numberOfLines, m_ImageHeight));
+	}
+
+	template<class TSegmenter>
+	void
+	MultiResolutionSegmenter<TSegmenter>::BuildGraph(const std::vector<unsigned int>& coreOfBlock,
+													 const std::vector<std::vector<std::size_t> >& blocksOfCore)
+	{
+		typedef typename SegmenterType::GraphType::EdgeListType EdgeListType;
+
+		auto& graph = m_Segmenter.m_Graph;
+		graph.Clear();
+		graph.m_FeatureStateSize = m_Segmenter.GetFeatureAccumulators().GetStateSize();
+		if(m_Segmenter.GetStorageDirectory().empty())
+			graph.m_Storage = std::make_shared<MemoryMappedStorage>();
+		else
+			graph.m_Storage = std::make_shared<MemoryMappedStorage>(m_Segmenter.GetStorageDirectory());
+
+		// The node of a pixel is moved from the segmenter of its strip
+		// into the graph, with a new edge list.
+		auto moveNode = [&](NodePointerType pixel, const unsigned int x, const unsigned int y)->NodePointerType
+		{
+			NodePointerType n = graph.CreateNode(std::move(*pixel));
+			n->m_Edges = EdgeListType(StorageAllocator<EdgeType>(graph.m_Storage.get()));
+			n->m_Id = y * m_ImageWidth + x;
+			n->m_Bbox.m_UX = x;
+			n->m_Bbox.m_UY = y;
+			graph.m_Nodes.push_back(n);
+			return n;
+		};
+
+		// The edges between a pixel and a core are only created on the
+		// side of the pixel, which has few of them: the edges of the
+		// cores are added once the graph is built.
+		auto connect = [&](NodePointerType a, const bool aIsCore, NodePointerType b, const bool bIsCore)
+		{
+			if(a == b)
+				return;
+			if(!aIsCore && !bIsCore)
+			{
+				a->m_Edges.push_back(EdgeType(b, 0, 1));
+				b->m_Edges.push_back(EdgeType(a, 0, 1));
+				return;
+			}
+
+			NodePointerType pixel = aIsCore ? b : a;
+			NodePointerType core = aIsCore ? a : b;
+			auto edge = GraphOperatorType::FindEdge(pixel, core);
+			if(edge == pixel->m_Edges.end())
+				pixel->m_Edges.push_back(EdgeType(core, 0, 1));
+			else
+				++edge->m_Boundary;
+		};
+
+		const unsigned int numberOfLines = GetStripHeight();
+		std::vector<NodePointerType> cores(blocksOfCore.size(), nullptr);
+		std::vector<NodePointerType> previousRow(m_ImageWidth, nullptr), currentRow(m_ImageWidth, nullptr);
+		for(unsigned int y0 = 0; y0 < m_ImageHeight; y0 += numberOfLines)
+		{
+			const unsigned int lines = std::min(numberOfLines, m_ImageHeight - y0);
+			auto extract = ExtractStrip(y0, lines);
+
+			// The graph of the strip only provides the attributes of its pixels.
+			SegmenterType seg;
+			Configure(seg);
+			seg.SetStorageDirectory("");
+			seg.SetInput(extract->GetOutput());
+			seg.GetFeatureAccumulators().SetNumberOfComponentsPerPixel(m_InputImage->GetNumberOfComponentsPerPixel());
+			GraphOperatorType::InitNodes(extract->GetOutput(), seg, FOUR);
+
+			for(unsigned int y = y0; y < y0 + lines; ++y)
+			{
+				for(unsigned int x = 0; x < m_ImageWidth; ++x)
+				{
+					NodePointerType pixel = seg.m_Graph.m_Nodes[static_cast<std::size_t>(y - y0) * m_ImageWidth + x];
+					const unsigned int core = GetCore(coreOfBlock, x, y);
+					NodePointerType n;
+					if(core == NoCore)
+					{
+						n = moveNode(pixel, x, y);
+						++m_NumberOfRefinedPixels;
+					}
+					else if(cores[core] == nullptr)
+					{
+						n = moveNode(pixel, x, y);
+						cores[core] = n;
+					}
+					else
+					{
+						// The areas of both nodes are the ones before the merge.
+						n = cores[core];
+						m_Segmenter.UpdateSpecificAttributes(n, pixel);
+						m_Segmenter.MergeFeatures(n, pixel);
+						++n->m_Area;
+					}
+
+					if(x > 0)
+						connect(n, core != NoCore, currentRow[x - 1], GetCore(coreOfBlock, x - 1, y) != NoCore);
+					if(y > 0)
+						connect(n, core != NoCore, previousRow[x], GetCore(coreOfBlock, x, y - 1) != NoCore);
+					currentRow[x] = n;
+				}
+				std::swap(previousRow, currentRow);
+			}
+		}
+
+		for(auto& n : graph.m_Nodes)
+		{
+			if(GetCore(coreOfBlock, n->m_Id % m_ImageWidth, n->m_Id / m_ImageWidth) != NoCore)
+				continue;
+			for(auto& edge : n->m_Edges)
+			{
+				NodePointerType target = edge.GetRegion();
+				if(GetCore(coreOfBlock, target->m_Id % m_ImageWidth, target->m_Id / m_ImageWidth) != NoCore)
+					target->m_Edges.push_back(EdgeType(n, 0, edge.m_Boundary));
+			}
+		}
+
+		for(std::size_t core = 0; core < cores.size(); ++core)
+			SetCoreShape(cores[core], core, coreOfBlock, blocksOfCore[core]);
+	}
+
+	template<class TSegmenter>
+	void
+	MultiResolutionSegmenter<TSegmenter>::SetCoreShape(NodePointerType core,
+														const unsigned int coreIndex,
+														const std::vector<unsigned int>& coreOfBlock,
+														const std::vector<std::size_t>& blocks)
+	{
+		const unsigned int coarseWidth = GetCoarseWidth();
+		const unsigned int coarseHeight = GetCoarseHeight();
+		auto inCore = [&](const long int x, const long int y)->bool
+		{
+			return x >= 0 && y >= 0 && x < m_ImageWidth && y < m_ImageHeight &&
+				GetCore(coreOfBlock, x, y) == coreIndex;
+		};
+
+		// Area, perimeter and bounding box of the union of the blocks: a
+		// side of a block is on the border if the adjacent block is not in
+		// the core.
+		unsigned int x0 = m_ImageWidth, y0 = m_ImageHeight, x1 = 0, y1 = 0;
+		unsigned int area = 0, perimeter = 0;
+		long int neighborhood[4];
+		for(auto& block : blocks)
+		{
+			const lp::BoundingBox b = GetBlock(block);
+			x0 = std::min(x0, b.m_UX);
+			y0 = std::min(y0, b.m_UY);
+			x1 = std::max(x1, b.m_UX + b.m_W);
+			y1 = std::max(y1, b.m_UY + b.m_H);
+			area += b.m_W * b.m_H;
+
+			FOURNeighborhood(neighborhood, block, coarseWidth, coarseHeight);
+			for(short j = 0; j < 4; ++j)
+			{
+				if(neighborhood[j] < 0 || coreOfBlock[neighborhood[j]] != coreIndex)
+					perimeter += (j % 2 == 0) ? b.m_W : b.m_H;
+			}
+		}
+
+		if(area != core->m_Area)
+			throw std::runtime_error("MultiResolutionSegmenter::SetCoreShape - The pixels of a core do not match its blocks");
+
+		core->m_Perimeter = perimeter;
+		core->m_Bbox.m_UX = x0;
+		core->m_Bbox.m_UY = y0;
+		core->m_Bbox.m_W = x1 - x0;
+		core->m_Bbox.m_H = y1 - y0;
+
+		// The border cells (with a neighbor out of the core) are on the
+		// sides of the blocks.
+		lp::CellLists borderCells;
+		for(auto& block : blocks)
+		{
+			const lp::BoundingBox b = GetBlock(block);
+			for(unsigned int y = b.m_UY; y < b.m_UY + b.m_H; ++y)
+			{
+				const bool side = (y == b.m_UY || y + 1 == b.m_UY + b.m_H);
+				for(unsigned int x = b.m_UX; x < b.m_UX + b.m_W; x += (side || b.m_W < 2) ? 1 : b.m_W - 1)
+				{
+					bool border = false;
+					for(long int dy = -1; dy <= 1 && !border; ++dy)
+					{
+						for(long int dx = -1; dx <= 1 && !border; ++dx)
+							border = !inCore(static_cast<long int>(x) + dx, static_cast<long int>(y) + dy);
+					}
+					if(border)
+						borderCells.insert(static_cast<std::size_t>(y - y0) * core->m_Bbox.m_W + x - x0);
+				}
+			}
+		}
+
+		core->m_Contour.clear();
+		lp::ContourOperations::CreateNewContour(core->m_Contour,
+												lp::ContourOperations::GridToBBox(core->m_Id, core->m_Bbox, m_ImageWidth),
+												borderCells, core->m_Bbox.m_W, core->m_Bbox.m_H);
+	}
+
+	template<class TSegmenter>
+	lp::BoundingBox
+	MultiResolutionSegmenter<TSegmenter>::GetBlock(const std::size_t block) const
+	{
+		const unsigned int x = (block % GetCoarseWidth()) * m_ShrinkFactor;
+		const unsigned int y = (block / GetCoarseWidth()) * m_ShrinkFactor;
+		const lp::BoundingBox b = {x, y, std::min(m_ShrinkFactor, m_ImageWidth - x), std::min(m_ShrinkFactor, m_ImageHeight - y)};
+		return b;
+	}
+
+	template<class TSegmenter>
+	void
+	MultiResolutionSegmenter<TSegmenter>::Configure(SegmenterType& seg)
+	{
+		if(m_ConfigureFunction)
+			m_ConfigureFunction(seg);
+	}
+
+	template<class TSegmenter>
+	typename MultiResolutionSegmenter<TSegmenter>::ExtractFilterType::Pointer
+	MultiResolutionSegmenter<TSegmenter>::ExtractStrip(const unsigned int y, const unsigned int numberOfLines)
+	{
+		typename ImageType::RegionType region = m_InputImage->GetLargestPossibleRegion();
+		region.SetIndex(1, region.GetIndex()[1] + y);
+		region.SetSize(1, numberOfLines);
+
+		auto filter = ExtractFilterType::New();
+		filter->SetInput(m_InputImage);
+		filter->SetRegionOfInterest(region);
+		filter->UpdateOutputInformation();
+		return filter;
+	}
+} // end of namespace grm
+#endif
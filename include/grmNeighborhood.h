@@ -22,6 +22,9 @@ enum CONNECTIVITY{FOUR = 0, EIGHT};
 
 namespace grm
 {
+	/* Sides of a rectangular area of the image, combined as bit flags */
+	enum BorderSide{TOP_SIDE = 1, RIGHT_SIDE = 2, BOTTOM_SIDE = 4, LEFT_SIDE = 8};
+
 	void FOURNeighborhood(long int * neighborhood,
 						  const long unsigned int id,
 						  const unsigned int width,
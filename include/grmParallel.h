@@ -0,0 +1,46 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_PARALLEL_H
+#define GRM_PARALLEL_H
+#include <cstddef>
+#include <functional>
+
+namespace grm
+{
+	/*
+	  Number of threads of a parallel loop given the requested one: 0
+	  stands for ITK_GLOBAL_DEFAULT_NUMBER_OF_THREADS if it is set, for
+	  the number of hardware threads otherwise.
+	*/
+	unsigned int GetNumberOfThreads(const unsigned int requested);
+
+	/*
+	  Calls f(begin, end) on blocks of [first, last) from several threads
+	  (see GetNumberOfThreads). The blocks are handed out in increasing
+	  order to the threads as they become idle, so that the work is
+	  balanced even if its cost varies along the range. The calling
+	  thread takes part in the loop and the first exception thrown by f
+	  is rethrown once all the threads are done.
+	*/
+	void ParallelFor(const std::size_t first,
+					 const std::size_t last,
+					 const unsigned int numberOfThreads,
+					 const std::function<void(std::size_t, std::size_t)>& f);
+
+} // end of namespace grm
+#endif
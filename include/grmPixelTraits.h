@@ -0,0 +1,49 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_PIXEL_TRAITS_H
+#define GRM_PIXEL_TRAITS_H
+#include <cstdint>
+#include <type_traits>
+
+namespace grm
+{
+	/*
+	 * Types of the sums of the pixel values (and of their squares) of a
+	 * region given the type of a band of the image. The sums of the
+	 * integer bands of at most 16 bits are exact 64-bit integers: a
+	 * region has less than 2^32 pixels, hence even the sum of the squares
+	 * of 16-bit values cannot overflow. The other bands are summed in
+	 * double precision.
+	 */
+	template<class TValue,
+			 bool IsSmallInteger = (std::is_integral<TValue>::value && sizeof(TValue) <= 2)>
+	struct AccumulatorTraits
+	{
+		typedef double SumType;
+		typedef double SquareSumType;
+	};
+
+	template<class TValue>
+	struct AccumulatorTraits<TValue, true>
+	{
+		typedef typename std::conditional<std::is_signed<TValue>::value, int64_t, uint64_t>::type SumType;
+		typedef uint64_t SquareSumType;
+	};
+
+} // end of namespace grm
+#endif
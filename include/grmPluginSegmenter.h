@@ -0,0 +1,92 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_PLUGIN_SEGMENTER_H
+#define GRM_PLUGIN_SEGMENTER_H
+#include "grmSegmenter.h"
+#include "grmCriterionPlugin.h"
+
+namespace grm
+{
+	struct PluginNode : Node<PluginNode>
+	{
+		/* Attributes laid out by the criterion */
+		std::vector<double> m_Attributes;
+	};
+
+	struct PluginParam
+	{
+		PluginParam() : m_Criterion(nullptr) {}
+
+		/* Criterion registered by a plugin library */
+		const GRMCriterionPlugin * m_Criterion;
+
+		/* Parameters given to the criterion ("key=value" pairs separated by spaces) */
+		std::string m_Parameters;
+	};
+
+	/*
+	 * Segmenter running a criterion loaded at runtime. The costs are
+	 * computed by batches of edges, so that the kernels of the plugin are
+	 * called once per batch rather than once per edge.
+	 */
+	template<class TImage>
+	class PluginSegmenter : public Segmenter< TImage, PluginNode, PluginParam>
+	{
+	public:
+
+		/* Some convenient typedefs */
+		typedef Segmenter<TImage, PluginNode, PluginParam> Superclass;
+		typedef TImage ImageType;
+		typedef PluginParam ParameterType;
+		typedef typename Superclass::GraphType GraphType;
+		typedef PluginNode NodeType;
+		typedef typename Superclass::EdgeType EdgeType;
+		typedef typename Superclass::NodePointerType NodePointerType;
+		typedef typename Superclass::GraphOperatorType GraphOperatorType;
+		typedef GraphToOtbImage<GraphType> IOType;
+
+		PluginSegmenter() : m_Context(nullptr), m_ContextCriterion(nullptr) {}
+		~PluginSegmenter() { DestroyContext(); }
+
+		float ComputeMergingCost(NodePointerType n1, NodePointerType n2);
+		void ComputeMergingCosts(NodePointerType r, EdgeType * const * edges, const std::size_t n, float * costs, const float bound);
+		void UpdateSpecificAttributes(NodePointerType n1, NodePointerType n2);
+		void InitFromImage();
+		std::size_t EstimateAttributesMemoryUsage(const unsigned int numberOfComponents);
+		void WriteAttributes(GraphBuffer& buffer, NodePointerType n);
+		void ReadAttributes(GraphBuffer& buffer, NodePointerType n);
+
+	private:
+
+		/* Creates the state of the criterion for the current number of bands */
+		void CreateContext();
+		void DestroyContext();
+
+		static GRMPluginRegion GetRegion(NodePointerType n);
+
+		/* State of the criterion for the current image and criterion which created it */
+		void * m_Context;
+		const GRMCriterionPlugin * m_ContextCriterion;
+
+		/* Buffers of the batches given to the kernels */
+		std::vector<GRMPluginRegion> m_Neighbors;
+		std::vector<unsigned int> m_Boundaries;
+	};
+} // end of namespace grm
+#include "grmPluginSegmenter.txx"
+#endif
@@ -0,0 +1,186 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_PLUGIN_SEGMENTER_TXX
+#define GRM_PLUGIN_SEGMENTER_TXX
+#include <stdexcept>
+#include "grmPluginSegmenter.h"
+
+namespace grm
+{
+
+	template<class TImage>
+	void
+	PluginSegmenter<TImage>::InitFromImage()
+	{
+		typedef typename TImage::PixelType PixelType;
+
+		this->m_ImageWidth = this->m_InputImage->GetLargestPossibleRegion().GetSize()[0];
+		this->m_ImageHeight =this->m_InputImage->GetLargestPossibleRegion().GetSize()[1];
+		this->m_NumberOfComponentsPerPixel = this->m_InputImage->GetNumberOfComponentsPerPixel();
+
+		CreateContext();
+
+		const GRMCriterionPlugin * criterion = m_ContextCriterion;
+		const unsigned int numberOfAttributes = criterion->m_GetNumberOfAttributes(m_Context);
+		const std::size_t bands = this->m_NumberOfComponentsPerPixel;
+
+		// The pixels of a row are initialized in one call.
+		std::vector<float> pixels;
+		std::vector<double> attributes;
+		std::vector<std::size_t> indices;
+		pixels.reserve(this->m_ImageWidth * bands);
+		indices.reserve(this->m_ImageWidth);
+
+		auto initBatch = [&]()
+		{
+			attributes.resize(indices.size() * numberOfAttributes);
+			criterion->m_InitAttributes(m_Context, pixels.data(), indices.size(), attributes.data());
+			for(std::size_t i = 0; i < indices.size(); ++i)
+			{
+				this->m_Graph.m_Nodes[indices[i]]->m_Attributes.assign(attributes.begin() + i * numberOfAttributes,
+																		attributes.begin() + (i + 1) * numberOfAttributes);
+			}
+			pixels.clear();
+			indices.clear();
+		};
+
+		this->ForEachValidPixel([&](const std::size_t idx, const PixelType& pixel)
+			{
+				if(!indices.empty() && idx / this->m_ImageWidth != indices.front() / this->m_ImageWidth)
+					initBatch();
+
+				for(std::size_t b = 0; b < bands; ++b)
+					pixels.push_back(pixel[b]);
+				indices.push_back(idx);
+				this->InitFeatures(idx, pixel);
+			});
+		if(!indices.empty())
+			initBatch();
+	}
+
+	template<class TImage>
+	GRMPluginRegion
+	PluginSegmenter<TImage>::GetRegion(NodePointerType n)
+	{
+		GRMPluginRegion region;
+		region.m_Attributes = n->m_Attributes.data();
+		region.m_Area = n->m_Area;
+		region.m_Perimeter = n->m_Perimeter;
+		region.m_UX = n->m_Bbox.m_UX;
+		region.m_UY = n->m_Bbox.m_UY;
+		region.m_W = n->m_Bbox.m_W;
+		region.m_H = n->m_Bbox.m_H;
+		return region;
+	}
+
+	template<class TImage>
+	float
+	PluginSegmenter<TImage>::ComputeMergingCost(NodePointerType n1, NodePointerType n2)
+	{
+		const GRMPluginRegion r1 = GetRegion(n1), r2 = GetRegion(n2);
+		const unsigned int boundary = (GraphOperatorType::FindEdge(n1, n2))->m_Boundary;
+		float cost;
+		m_ContextCriterion->m_ComputeMergingCosts(m_Context, &r1, &r2, &boundary, 1, &cost);
+		return cost;
+	}
+
+	template<class TImage>
+	void
+	PluginSegmenter<TImage>::ComputeMergingCosts(NodePointerType r,
+												 EdgeType * const * edges,
+												 const std::size_t n,
+												 float * costs,
+												 const float)
+	{
+		// The kernels of the plugins always compute the exact costs.
+		const GRMPluginRegion region = GetRegion(r);
+		m_Neighbors.resize(n);
+		m_Boundaries.resize(n);
+		for(std::size_t i = 0; i < n; ++i)
+		{
+			m_Neighbors[i] = GetRegion(edges[i]->GetRegion());
+			m_Boundaries[i] = edges[i]->m_Boundary;
+		}
+		m_ContextCriterion->m_ComputeMergingCosts(m_Context, &region, m_Neighbors.data(),
+														 m_Boundaries.data(), n, costs);
+	}
+
+	template<class TImage>
+	void
+	PluginSegmenter<TImage>::UpdateSpecificAttributes(NodePointerType n1, NodePointerType n2)
+	{
+		GRMPluginRegion r1 = GetRegion(n1);
+		const GRMPluginRegion r2 = GetRegion(n2);
+		const unsigned int boundary = (GraphOperatorType::FindEdge(n1, n2))->m_Boundary;
+		m_ContextCriterion->m_MergeAttributes(m_Context, &r1, &r2, boundary);
+	}
+
+	template<class TImage>
+	std::size_t
+	PluginSegmenter<TImage>::EstimateAttributesMemoryUsage(const unsigned int numberOfComponents)
+	{
+		// The number of attributes depends on the number of bands.
+		this->m_NumberOfComponentsPerPixel = numberOfComponents;
+		CreateContext();
+		return GetHeapBlockSize(m_ContextCriterion->m_GetNumberOfAttributes(m_Context) * sizeof(double));
+	}
+
+	template<class TImage>
+	void
+	PluginSegmenter<TImage>::CreateContext()
+	{
+		const GRMCriterionPlugin * criterion = this->m_Param.m_Criterion;
+		if(criterion == nullptr)
+			throw std::runtime_error("PluginSegmenter::CreateContext - No criterion is set");
+
+		DestroyContext();
+		m_Context = criterion->m_CreateContext(this->m_Param.m_Parameters.c_str(), this->m_NumberOfComponentsPerPixel);
+		m_ContextCriterion = criterion;
+		if(m_Context == nullptr)
+			throw std::runtime_error("PluginSegmenter::CreateContext - Invalid parameters for the criterion " +
+									 std::string(criterion->m_Name) + ": " + this->m_Param.m_Parameters);
+	}
+
+	template<class TImage>
+	void
+	PluginSegmenter<TImage>::DestroyContext()
+	{
+		if(m_Context != nullptr)
+			m_ContextCriterion->m_DestroyContext(m_Context);
+		m_Context = nullptr;
+	}
+
+	template<class TImage>
+	void
+	PluginSegmenter<TImage>::WriteAttributes(GraphBuffer& buffer, NodePointerType n)
+	{
+		buffer.Write(n->m_Attributes);
+	}
+
+	template<class TImage>
+	void
+	PluginSegmenter<TImage>::ReadAttributes(GraphBuffer& buffer, NodePointerType n)
+	{
+		// The graph of a stitched tile is not initialized from an image.
+		if(m_Context == nullptr)
+			CreateContext();
+
+		buffer.Read(n->m_Attributes);
+	}
+} // end of namespace grm
+#endif
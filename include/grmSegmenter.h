@@ -17,9 +17,19 @@
 =========================================================================*/
 #ifndef GRM_SEGMENTER_H
 #define GRM_SEGMENTER_H
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
 #include "grmMacroGenerator.h"
 #include "grmGraphOperations.h"
 #include "grmGraphToOtbImage.h"
+#include "grmStatistics.h"
+#include "grmFeatureAccumulators.h"
+#include "grmMemoryUsage.h"
+#include "grmParallel.h"
+#include "grmThresholdSchedule.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 
 namespace grm
 {
@@ -40,14 +50,29 @@ namespace grm
 		typedef typename GraphOperatorType::NodePointerType NodePointerType;
 		typedef GraphToOtbImage<GraphType> IOType;
 		typedef typename IOType::LabelImageType LabelImageType;
+		typedef typename IOType::GlobalLabelImageType GlobalLabelImageType;
 		typedef typename IOType::ClusteredImageType ClusteredImageType;
+		typedef typename IOType::MeanImageType MeanImageType;
+		typedef otb::Image<unsigned char, 2> MaskImageType;
 
 		/* Default constructor and destructor */
 		
 		Segmenter(){
-			this->m_DoFastSegmentation = false;
+			this->m_MergingHeuristic = LMBF_HEURISTIC;
 			this->m_NumberOfIterations = 0;
 			this->m_Complete = false;
+			this->m_NodeSortingPeriod = 0;
+			this->m_MinimumRegionSize = 0;
+			this->m_NumberOfLinesPerStrip = 0;
+			this->m_UseNoDataValue = false;
+			this->m_NoDataValue = 0.0f;
+			this->m_FrozenSides = 0;
+			this->m_SceneOffsetX = 0;
+			this->m_SceneOffsetY = 0;
+			this->m_SceneWidth = 0;
+			this->m_NumberOfThreads = 0;
+			this->m_ExceededCostBound = GraphOperatorType::BoundExceededCost();
+			this->m_MemoryBudget = 0;
 		};
 		~Segmenter(){};
 
@@ -56,43 +81,320 @@ namespace grm
 		 */
 		virtual void Update()
 		{
+			this->m_Statistics.Clear();
+			ResetPeakMemoryUsage();
+			this->m_Statistics.m_InitialMemoryUsage = GetCurrentMemoryUsage();
+			auto start = std::chrono::steady_clock::now();
+
+			// Only the information of the input is needed: its pixels are read by strips.
+			this->m_InputImage->UpdateOutputInformation();
+			this->m_FeatureAccumulators.SetNumberOfComponentsPerPixel(this->m_InputImage->GetNumberOfComponentsPerPixel());
+
+			const auto size = this->m_InputImage->GetLargestPossibleRegion().GetSize();
+			const std::size_t estimate = EstimateMemoryUsage(size[0], size[1], this->m_InputImage->GetNumberOfComponentsPerPixel());
+			this->m_Statistics.m_EstimatedMemoryUsage = estimate;
+			if(this->m_MemoryBudget > 0 && estimate > this->m_MemoryBudget)
+			{
+				throw std::runtime_error("Segmenter::Update - The segmentation of the image needs about " +
+										 std::to_string(estimate / (1024 * 1024) + 1) + " MB, more than the memory budget of " +
+										 std::to_string(this->m_MemoryBudget / (1024 * 1024)) +
+										 " MB: segment it by tiles (DistributedSegmenter) or in out-of-core mode (SetStorageDirectory)");
+			}
+
 			GraphOperatorType::InitNodes(this->m_InputImage, *this, FOUR);
+
+			if(this->m_FrozenSides != 0)
+			{
+				const lp::BoundingBox area = {0, 0, this->m_ImageWidth, this->m_ImageHeight};
+				GraphOperatorType::FreezeBorderNodes(this->m_Graph, area, this->m_FrozenSides);
+			}
+
+			this->m_Statistics.m_InitializationTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			this->m_Statistics.m_InitialNumberOfNodes = this->m_Graph.m_Nodes.size();
+
+			MergeRegions();
+		}
+
+		/*
+		 * This method performs the merging iterations on the current
+		 * graph, then merges the small regions. It is called by Update
+		 * and can be called again on a graph which has been modified,
+		 * for instance after stitching the graphs of several tiles.
+		 */
+		void MergeRegions()
+		{
 			bool prev_merged = false;
 
-			if(this->m_DoFastSegmentation)
+			if(this->m_NodeSortingPeriod > 0)
+				GraphOperatorType::SortNodesAlongZOrderCurve(this->m_Graph);
+
+			if(this->m_MergingHeuristic == DITHERED_BF_HEURISTIC)
 			{
 				prev_merged = GraphOperatorType::PerfomAllDitheredIterationsWithBF(*this);
 			}
+			else if(this->m_MergingHeuristic == BUCKETED_BF_HEURISTIC)
+			{
+				prev_merged = GraphOperatorType::PerfomAllBucketedIterationsWithBF(*this);
+			}
 			else
 			{
-				prev_merged = GraphOperatorType::PerfomAllIterationsWithLMBFAndConstThreshold(*this);
+				prev_merged = GraphOperatorType::PerfomAllIterationsWithLMBF(*this);
 			}
 
 			this->m_Complete = !prev_merged;
+
+			if(this->m_MinimumRegionSize > 1)
+			{
+				auto start = std::chrono::steady_clock::now();
+				this->m_Statistics.m_NumberOfSmallRegionMerges =
+					GraphOperatorType::MergeSmallRegions(*this, this->m_MinimumRegionSize);
+				this->m_Statistics.m_SmallRegionMergingTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			this->m_Statistics.m_PeakMemoryUsage = GetPeakMemoryUsage();
+		}
+
+		/*
+		 * Called by the graph operations at the end of each iteration:
+		 * records the statistics and forwards them to the user callback.
+		 */
+		void NotifyIteration(const IterationStatistics& stats)
+		{
+			this->m_Statistics.m_Iterations.push_back(stats);
+			if(this->m_IterationCallback)
+				this->m_IterationCallback(stats);
+		}
+
+		/* Add a feature to compute for each segment during the segmentation */
+		void AddFeatureAccumulator(std::shared_ptr<FeatureAccumulator> accumulator)
+		{
+			this->m_FeatureAccumulators.Add(accumulator);
+		}
+
+		/*
+		 * Called by InitFromImage for each pixel: initializes the states of
+		 * the feature accumulators of the corresponding node.
+		 */
+		template<class TPixel>
+		void InitFeatures(const std::size_t idx, const TPixel& pixel)
+		{
+			if(this->m_FeatureAccumulators.Empty())
+				return;
+
+			this->m_PixelBuffer.resize(this->m_NumberOfComponentsPerPixel);
+			for(std::size_t b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+				this->m_PixelBuffer[b] = pixel[b];
+
+			this->m_FeatureAccumulators.Initialize(this->m_Graph.GetFeatures(this->m_Graph.m_Nodes[idx]), this->m_PixelBuffer.data());
+		}
+
+		/* Called when the node n2 merges into the node n1, before their areas are added */
+		void MergeFeatures(NodePointerType n1, NodePointerType n2)
+		{
+			if(!this->m_FeatureAccumulators.Empty())
+				this->m_FeatureAccumulators.Merge(this->m_Graph.GetFeatures(n1), n1->m_Area,
+												  this->m_Graph.GetFeatures(n2), n2->m_Area);
+		}
+
+		/*
+		 * Write the features of the segments in CSV, one line per segment
+		 * with the label of the label image output (sequential labels or
+		 * global ids plus 1).
+		 */
+		void WriteFeatures(const std::string& fileName, const LabelMode mode = SEQUENTIAL_LABELS)
+		{
+			std::ofstream os(fileName);
+			if(!os)
+				throw std::runtime_error("Segmenter::WriteFeatures - Cannot open " + fileName);
+
+			os << "label,area";
+			for(auto& name : this->m_FeatureAccumulators.GetFeatureNames())
+				os << "," << name;
+			os << std::endl;
+
+			std::vector<double> features;
+			uint64_t label = 1;
+			for(auto& node : this->m_Graph.m_Nodes)
+			{
+				features.clear();
+				this->m_FeatureAccumulators.GetFeatures(this->m_Graph.GetFeatures(node), node->m_Area, features);
+				os << ((mode == GLOBAL_ID_LABELS) ? GetGlobalId(node) + 1 : label++) << "," << node->m_Area;
+				for(auto& f : features)
+					os << "," << f;
+				os << std::endl;
+			}
+		}
+
+		/*
+		 * Given a node, this method returns the global id of its region:
+		 * the index of its first pixel in the scene which the input image
+		 * is a part of (see SetSceneOffsetX, SetSceneOffsetY and
+		 * SetSceneWidth; the scene is the input image by default).
+		 *
+		 * Unlike m_Id, the start cell of the contour in the input image,
+		 * it does not depend on the tiling of the scene: the regions of
+		 * different tiles have different ids, and a region keeps the id
+		 * of its first pixel when it absorbs its neighbors.
+		 */
+		uint64_t GetGlobalId(NodePointerType n) const
+		{
+			const uint64_t sceneWidth = (this->m_SceneWidth > 0) ? this->m_SceneWidth : this->m_ImageWidth;
+			return (static_cast<uint64_t>(this->m_SceneOffsetY) + n->m_Id / this->m_ImageWidth) * sceneWidth +
+				this->m_SceneOffsetX + n->m_Id % this->m_ImageWidth;
+		}
+
+		/*
+		 * Given the size of an image, this method estimates the peak
+		 * memory (in bytes) of its segmentation by Update: the initial
+		 * graph (see EstimateNodeMemoryUsage), the strip of the input
+		 * image being read, and the outputs, i.e. the label image and the
+		 * buffers of its drawing while the graph is still held (see
+		 * GraphToOtbImage::EstimateDrawingMemoryUsage).
+		 *
+		 * @params
+		 * const unsigned int width : number of columns of the image.
+		 * const unsigned int height : number of rows of the image.
+		 * const unsigned int numberOfComponents : number of bands.
+		 * CONNECTIVITY mask : neighborhood of the pixels (FOUR for Update).
+		 *
+		 * @return the estimated memory in bytes.
+		 */
+		std::size_t EstimateMemoryUsage(const unsigned int width,
+										const unsigned int height,
+										const unsigned int numberOfComponents,
+										CONNECTIVITY mask = FOUR)
+		{
+			const std::size_t numberOfPixels = static_cast<std::size_t>(width) * height;
+
+			// Bitmap of the valid pixels, kept for the outputs
+			const std::size_t validPixelsSize = (this->m_Mask.IsNotNull() || this->m_UseNoDataValue) ? (numberOfPixels + 7) / 8 : 0;
+
+			return numberOfPixels * EstimateNodeMemoryUsage(numberOfComponents, mask) +
+				EstimateStripMemoryUsage(width, height, numberOfComponents) +
+				EstimateOutputMemoryUsage(numberOfPixels, numberOfPixels) + validPixelsSize;
+		}
+
+		/*
+		 * Given the number of bands, this method estimates the memory (in
+		 * bytes) of a node of the initial graph: the node of its pixel
+		 * (see EstimatePixelMemoryUsage), its entry in the working arrays
+		 * of the iterations, its edge list if longer than the one stored
+		 * in the node, and its share of the edge lists of the regions
+		 * formed by the first iterations.
+		 */
+		std::size_t EstimateNodeMemoryUsage(const unsigned int numberOfComponents,
+											CONNECTIVITY mask = FOUR)
+		{
+			// Up to 4 edges are stored in the node record. About one region
+			// per two pixels is formed by the first iterations, whose edge
+			// list moves to the storage with twice the capacity of a pixel.
+			std::size_t nodeSize = EstimatePixelMemoryUsage(numberOfComponents) + sizeof(std::size_t);
+			if(this->m_StorageDirectory.empty())
+			{
+				const std::size_t numberOfNeighbors = (mask == EIGHT) ? 8 : 4;
+				if(mask == EIGHT)
+					nodeSize += MemoryMappedStorage::RoundSize(numberOfNeighbors * sizeof(EdgeType));
+				nodeSize += MemoryMappedStorage::RoundSize(2 * numberOfNeighbors * sizeof(EdgeType)) / 2;
+			}
+			return nodeSize;
+		}
+
+		/*
+		 * Given the number of bands, this method estimates the memory (in
+		 * bytes) of the node of a pixel before any merge: the node record
+		 * followed by the states of the features, its entry in the node
+		 * list and its specific attributes. In out-of-core mode, the node
+		 * records are in the mapped file and are not counted.
+		 */
+		std::size_t EstimatePixelMemoryUsage(const unsigned int numberOfComponents)
+		{
+			this->m_FeatureAccumulators.SetNumberOfComponentsPerPixel(numberOfComponents);
+			std::size_t nodeSize = sizeof(NodePointerType) + this->EstimateAttributesMemoryUsage(numberOfComponents);
+			if(this->m_StorageDirectory.empty())
+				nodeSize += MemoryMappedStorage::RoundSize(sizeof(NodeType) + this->m_FeatureAccumulators.GetStateSize() * sizeof(double));
+			return nodeSize;
+		}
+
+		/* Memory (in bytes) of the strip of the input image being read by the segmentation of an image */
+		std::size_t EstimateStripMemoryUsage(const unsigned int width,
+											 const unsigned int height,
+											 const unsigned int numberOfComponents)
+		{
+			const std::size_t lineSize = static_cast<std::size_t>(width) * numberOfComponents * sizeof(typename TImage::InternalPixelType);
+			std::size_t numberOfLines = this->m_NumberOfLinesPerStrip;
+			if(numberOfLines == 0)
+				numberOfLines = DefaultStripSize / std::max<std::size_t>(lineSize, 1);
+			numberOfLines = std::max<std::size_t>(1, std::min<std::size_t>(numberOfLines, height));
+			return numberOfLines * lineSize;
+		}
+
+		/*
+		 * Memory (in bytes) of the label image of numberOfPixels pixels
+		 * and of the buffers of its drawing from numberOfRegions regions.
+		 */
+		std::size_t EstimateOutputMemoryUsage(const std::size_t numberOfPixels,
+											  const std::size_t numberOfRegions)
+		{
+			return numberOfPixels * sizeof(typename LabelImageType::PixelType) +
+				IOType::EstimateDrawingMemoryUsage(numberOfPixels, numberOfRegions);
+		}
+
+		/* Number of iterations to perform (200 if not set) */
+		unsigned int GetMaximumNumberOfIterations()
+		{
+			return (this->m_NumberOfIterations < 1) ? 200 : this->m_NumberOfIterations;
 		}
 
 		/* methods to overload */
 
 		/*
-		 * Given 2 smart adjacent node pointers (boost::shared_ptr), this
+		 * Given 2 adjacent node pointers (owned by the graph), this
 		 * method has to compute the merging cost which is coded as a float.
 		 *
 		 * @params
-		 * NodePointerType n1 : Smart pointer to node 1
-		 * NodePointerType n2 : Smart pointer to node 2
+		 * NodePointerType n1 : pointer to node 1
+		 * NodePointerType n2 : pointer to node 2
 		 *
 		 * @return the merging cost.
 		 */
 		virtual float ComputeMergingCost(NodePointerType n1, NodePointerType n2) = 0;
 
 		/*
-		 * Given 2 smart adjacent node pointers (boost::shared_ptr), this
+		 * Given a node and a batch of its edges, this method computes the
+		 * merging costs with the targets of the edges. It can be overloaded
+		 * to compute a whole batch in one call.
+		 *
+		 * The costs below the bound have to be exact. A criterion can stop
+		 * the evaluation of a cost as soon as it knows that the cost is not
+		 * below the bound and return any value not below it: only the
+		 * merges whose cost is below the threshold matter to the region
+		 * merging.
+		 *
+		 * @params
+		 * NodePointerType r : pointer to the node
+		 * EdgeType * const * edges : edges from r to its neighbors
+		 * const std::size_t n : number of edges
+		 * float * costs : merging costs with the targets of the edges
+		 * const float bound : upper bound of the costs of interest
+		 */
+		virtual void ComputeMergingCosts(NodePointerType r,
+										 EdgeType * const * edges,
+										 const std::size_t n,
+										 float * costs,
+										 const float /*bound*/)
+		{
+			for(std::size_t i = 0; i < n; ++i)
+				costs[i] = this->ComputeMergingCost(r, edges[i]->GetRegion());
+		}
+
+		/*
+		 * Given 2 adjacent node pointers (owned by the graph), this
 		 * method merges th node n2 into the node n1 by updating the customized
 		 * attributes of the node n1.
 		 *
 		 * @params
-		 * NodePointerType n1 : Smart pointer to node 1
-		 * NodePointerType n2 : Smart pointer to node 2
+		 * NodePointerType n1 : pointer to node 1
+		 * NodePointerType n2 : pointer to node 2
 		 *
 		 */
 		virtual void UpdateSpecificAttributes(NodePointerType n1, NodePointerType n2) = 0;
@@ -106,38 +408,320 @@ namespace grm
 		 */
 		virtual void InitFromImage() = 0;
 
-		/* Return the label image */
+		/*
+		 * Given the number of bands, this method returns the heap memory
+		 * (in bytes) taken by the specific attributes of a pixel node,
+		 * for EstimatePixelMemoryUsage (0 if not overloaded).
+		 *
+		 * @params
+		 * const unsigned int numberOfComponents : number of bands.
+		 */
+		virtual std::size_t EstimateAttributesMemoryUsage(const unsigned int)
+		{
+			return 0;
+		}
+
+		/*
+		 * Given the input image, the mask and the no-data value, this
+		 * method computes the pixels which become nodes (nothing if
+		 * neither the mask nor the no-data value is set). InitNodes
+		 * keeps them in ValidPixels for the outputs.
+		 *
+		 * @params
+		 * std::vector<bool>& valid : true for the pixels to segment.
+		 * const bool testNoData : whether to read the input image for the
+		 * no-data pixels. InitNodes only reads the mask: the no-data
+		 * pixels are found by InitFromImage (see ForEachValidPixel).
+		 */
+		void ComputeValidPixels(std::vector<bool>& valid, const bool testNoData = true)
+		{
+			valid.clear();
+			if(this->m_Mask.IsNull() && !this->m_UseNoDataValue)
+				return;
+
+			const auto region = this->m_InputImage->GetLargestPossibleRegion();
+			valid.assign(region.GetNumberOfPixels(), true);
+
+			if(this->m_Mask.IsNotNull())
+			{
+				this->m_Mask->UpdateOutputInformation();
+				if(this->m_Mask->GetLargestPossibleRegion().GetSize() != region.GetSize())
+					throw std::runtime_error("Segmenter::ComputeValidPixels - The mask and the input image have different sizes");
+
+				ForEachPixelByStrips(this->m_Mask.GetPointer(), [&](const std::size_t idx, const typename MaskImageType::PixelType& pixel)
+					{
+						valid[idx] = (pixel != 0);
+					});
+			}
+
+			if(this->m_UseNoDataValue && testNoData)
+			{
+				ForEachPixelByStrips(this->m_InputImage, [&](const std::size_t idx, const typename TImage::PixelType& pixel)
+					{
+						if(IsNoData(pixel))
+							valid[idx] = false;
+					});
+			}
+		}
+
+		/*
+		 * Given an image, this method calls f(idx, pixel) for each of its
+		 * pixels in row-major order. The image of a pipeline is requested
+		 * by strips of m_NumberOfLinesPerStrip lines (automatic if 0) and
+		 * released at the end, so that it is never entirely in memory; an
+		 * image without source is read from its buffer.
+		 *
+		 * @params
+		 * TInputImage * img : image to read.
+		 * F f : function called with the index and the value of each pixel.
+		 */
+		template<class TInputImage, class F>
+		void ForEachPixelByStrips(TInputImage * img, F f)
+		{
+			img->UpdateOutputInformation();
+			const typename TInputImage::RegionType largestRegion = img->GetLargestPossibleRegion();
+			const std::size_t width = largestRegion.GetSize()[0];
+			const std::size_t height = largestRegion.GetSize()[1];
+
+			const bool streaming = (img->GetSource() != nullptr);
+			std::size_t numberOfLines = height;
+			if(streaming)
+			{
+				numberOfLines = this->m_NumberOfLinesPerStrip;
+				if(numberOfLines == 0)
+				{
+					const std::size_t lineSize = width * img->GetNumberOfComponentsPerPixel() *
+						sizeof(typename TInputImage::InternalPixelType);
+					numberOfLines = DefaultStripSize / std::max<std::size_t>(lineSize, 1);
+				}
+				numberOfLines = std::max<std::size_t>(1, std::min(numberOfLines, height));
+			}
+
+			std::size_t idx = 0;
+			for(std::size_t y = 0; y < height; y += numberOfLines)
+			{
+				typename TInputImage::RegionType strip = largestRegion;
+				strip.SetIndex(1, largestRegion.GetIndex()[1] + y);
+				strip.SetSize(1, std::min(numberOfLines, height - y));
+
+				if(streaming)
+				{
+					img->SetRequestedRegion(strip);
+					img->PropagateRequestedRegion();
+					img->UpdateOutputData();
+				}
+
+				itk::ImageRegionConstIterator<TInputImage> it(img, strip);
+				for(it.GoToBegin(); !it.IsAtEnd(); ++it, ++idx)
+					f(idx, it.Get());
+			}
+
+			if(streaming)
+				img->ReleaseData();
+		}
+
+		/*
+		 * Called by InitFromImage to read the input image: this method
+		 * calls f(idx, pixel) for each pixel which has a node and is not
+		 * no-data, in row-major order. The no-data pixels are only found
+		 * here, so that the input image is read once: they are cleared in
+		 * ValidPixels and InitNodes removes their nodes afterwards.
+		 *
+		 * @params
+		 * F f : function called with the index and the value of each pixel.
+		 */
+		template<class F>
+		void ForEachValidPixel(F f)
+		{
+			ForEachPixelByStrips(this->m_InputImage, [&](const std::size_t idx, const typename TImage::PixelType& pixel)
+				{
+					// Masked pixel
+					if(this->m_Graph.m_Nodes[idx] == nullptr)
+						return;
+
+					if(this->m_UseNoDataValue && IsNoData(pixel))
+					{
+						this->m_ValidPixels[idx] = false;
+						return;
+					}
+
+					f(idx, pixel);
+				});
+		}
+
+		/* As in OTB, a pixel is no-data if one of its bands is */
+		template<class TPixel>
+		bool IsNoData(const TPixel& pixel) const
+		{
+			const unsigned int numberOfComponents = this->m_InputImage->GetNumberOfComponentsPerPixel();
+			for(unsigned int b = 0; b < numberOfComponents; ++b)
+			{
+				if(pixel[b] == this->m_NoDataValue)
+					return true;
+			}
+			return false;
+		}
+
+		/* Return the label image (label 0 for the masked pixels) */
 		inline typename LabelImageType::Pointer GetLabeledClusteredOutput()
 			{
 				IOType io;
+				io.SetNumberOfThreads(this->m_NumberOfThreads);
 				auto labelImg = io.GetLabelImage(this->m_Graph, this->m_ImageWidth, this->m_ImageHeight);
+				ResetMaskedPixels<LabelImageType>(labelImg, 0);
 				return labelImg;
 			}
 
+		/*
+		 * Return the label image where the label of a region is its
+		 * global id plus 1 (label 0 for the masked pixels): the label
+		 * images of the tiles of a scene can be mosaicked without
+		 * relabeling them.
+		 */
+		inline typename GlobalLabelImageType::Pointer GetGlobalIdLabelOutput()
+			{
+				if(this->m_SceneWidth > 0 && this->m_SceneOffsetX + this->m_ImageWidth > this->m_SceneWidth)
+					throw std::runtime_error("Segmenter::GetGlobalIdLabelOutput - The image exceeds the width of the scene");
+
+				std::vector<typename GlobalLabelImageType::PixelType> labels;
+				labels.reserve(this->m_Graph.m_Nodes.size());
+				for(auto& node : this->m_Graph.m_Nodes)
+					labels.push_back(GetGlobalId(node) + 1);
+
+				IOType io;
+				io.SetNumberOfThreads(this->m_NumberOfThreads);
+				auto labelImg = io.template GetLabelImage<GlobalLabelImageType>(this->m_Graph, this->m_ImageWidth, this->m_ImageHeight, labels);
+				ResetMaskedPixels<GlobalLabelImageType>(labelImg, 0);
+				return labelImg;
+			}
+
+		/*
+		 * Return the RGB image where each region has the color of its
+		 * global id (black for the masked pixels): the colors are the
+		 * same at each run and in every tile of a scene.
+		 */
 		inline typename ClusteredImageType::Pointer GetClusteredImageOutput()
 			{
+				std::vector<typename IOType::ClusterPixelType> colors(3 * this->m_Graph.m_Nodes.size());
+				for(std::size_t i = 0; i < this->m_Graph.m_Nodes.size(); ++i)
+					IOType::GetHashColor(GetGlobalId(this->m_Graph.m_Nodes[i]), &colors[3 * i]);
+
 				IOType io;
-				auto clusteredImg = io.GetClusteredOutput(this->m_Graph, this->m_ImageWidth, this->m_ImageHeight);
+				io.SetNumberOfThreads(this->m_NumberOfThreads);
+				auto clusteredImg = io.template GetClusteredOutput<ClusteredImageType>(this->m_Graph, this->m_ImageWidth, this->m_ImageHeight, 3, colors);
+				typename ClusteredImageType::PixelType black(3);
+				black.Fill(0);
+				ResetMaskedPixels<ClusteredImageType>(clusteredImg, black);
 				return clusteredImg;
 			}
+
+		/*
+		 * Return the image where each region is painted with its mean
+		 * value in each band of the input image (0 for the masked
+		 * pixels). The criterion has to provide the means (GetMeans).
+		 */
+		inline typename MeanImageType::Pointer GetMeanImageOutput()
+			{
+				const std::size_t numberOfBands = this->m_NumberOfComponentsPerPixel;
+				std::vector<typename MeanImageType::InternalPixelType> means(numberOfBands * this->m_Graph.m_Nodes.size());
+				for(std::size_t i = 0; i < this->m_Graph.m_Nodes.size(); ++i)
+					this->GetMeans(this->m_Graph.m_Nodes[i], &means[numberOfBands * i]);
+
+				IOType io;
+				io.SetNumberOfThreads(this->m_NumberOfThreads);
+				auto meanImg = io.template GetClusteredOutput<MeanImageType>(this->m_Graph, this->m_ImageWidth, this->m_ImageHeight, numberOfBands, means);
+				typename MeanImageType::PixelType zero(numberOfBands);
+				zero.Fill(0);
+				ResetMaskedPixels<MeanImageType>(meanImg, zero);
+				return meanImg;
+			}
+
+		/*
+		 * Given a node, this method writes the mean value of its region
+		 * in each band of the input image (see GetMeanImageOutput).
+		 *
+		 * @params
+		 * NodePointerType n : pointer to the node.
+		 * float * means : m_NumberOfComponentsPerPixel values.
+		 */
+		virtual void GetMeans(NodePointerType, float *)
+		{
+			throw std::runtime_error("Segmenter::GetMeans - The criterion does not provide the means of the regions");
+		}
 		
+		/*
+		 * Given a node, this method writes its specific attributes in a
+		 * buffer to send its graph to another process (distributed
+		 * segmentation). ReadAttributes reads them back in the same order.
+		 *
+		 * @params
+		 * GraphBuffer& buffer : buffer receiving the attributes.
+		 * NodePointerType n : pointer to the node.
+		 */
+		virtual void WriteAttributes(GraphBuffer&, NodePointerType)
+		{
+			throw std::runtime_error("Segmenter::WriteAttributes - The criterion does not support the distributed segmentation");
+		}
+
+		virtual void ReadAttributes(GraphBuffer&, NodePointerType)
+		{
+			throw std::runtime_error("Segmenter::ReadAttributes - The criterion does not support the distributed segmentation");
+		}
+
 		/* Set methods */
-		GRMSetMacro(bool, DoFastSegmentation);
+		GRMSetMacro(MergingHeuristic, MergingHeuristic);
 		GRMSetMacro(unsigned int, NumberOfIterations);
 		GRMSetMacro(float, Threshold);
 		GRMSetMacro(ParamType, Param);
 		GRMSetMacro(unsigned int, ImageWidth);
 		GRMSetMacro(unsigned int, ImageHeight);
 		GRMSetMacro(unsigned int, NumberOfComponentsPerPixel);
+		GRMSetMacro(std::string, StorageDirectory);
+		GRMSetMacro(unsigned int, NodeSortingPeriod);
+		GRMSetMacro(unsigned int, MinimumRegionSize);
+		GRMSetMacro(unsigned int, NumberOfLinesPerStrip);
+		GRMSetMacro(IterationCallbackType, IterationCallback);
+		GRMSetMacro(unsigned int, FrozenSides);
+		GRMSetMacro(unsigned int, SceneOffsetX);
+		GRMSetMacro(unsigned int, SceneOffsetY);
+		GRMSetMacro(unsigned int, SceneWidth);
+		GRMSetMacro(unsigned int, NumberOfThreads);
+		GRMSetMacro(ThresholdSchedule, ThresholdSchedule);
+		GRMSetMacro(float, ExceededCostBound);
+		GRMSetMacro(std::size_t, MemoryBudget);
 		inline void SetInput(TImage * in){ m_InputImage = in;}
+		inline void SetMask(MaskImageType * mask){ m_Mask = mask;}
+		inline MaskImageType * GetMask(){ return m_Mask.GetPointer();}
+		inline void SetNoDataValue(const float value){ m_NoDataValue = value; m_UseNoDataValue = true;}
 		inline bool GetComplete(){ return this->m_Complete;}
+		inline void SetDoFastSegmentation(const bool fast){ m_MergingHeuristic = fast ? DITHERED_BF_HEURISTIC : LMBF_HEURISTIC;}
 
 		/* Get methods */
 		GRMGetMacro(float, Threshold);
+		GRMGetMacro(MergingHeuristic, MergingHeuristic);
 		GRMGetMacro(unsigned int, ImageWidth);
 		GRMGetMacro(unsigned int, ImageHeight);
 		GRMGetMacro(unsigned int, NumberOfComponentsPerPixel);
 		GRMGetMacro(unsigned int, NumberOfIterations);
+		GRMGetMacro(std::string, StorageDirectory);
+		GRMGetMacro(unsigned int, NodeSortingPeriod);
+		GRMGetMacro(unsigned int, MinimumRegionSize);
+		GRMGetMacro(unsigned int, NumberOfLinesPerStrip);
+		GRMGetMacro(float, NoDataValue);
+		GRMGetMacro(bool, UseNoDataValue);
+		GRMGetMacro(unsigned int, FrozenSides);
+		GRMGetMacro(unsigned int, SceneOffsetX);
+		GRMGetMacro(unsigned int, SceneOffsetY);
+		GRMGetMacro(unsigned int, SceneWidth);
+		GRMGetMacro(unsigned int, NumberOfThreads);
+		GRMGetMacro(float, ExceededCostBound);
+		GRMGetMacro(std::size_t, MemoryBudget);
+		GRMGetRefMacro(ThresholdSchedule, ThresholdSchedule);
+		GRMGetRefMacro(SegmentationStatistics, Statistics);
+		GRMGetRefMacro(FeatureAccumulatorSet, FeatureAccumulators);
+
+		/* Validity of the pixels of the image computed by InitNodes (empty: all the pixels are valid) */
+		GRMGetRefMacro(std::vector<bool>, ValidPixels);
 		
 		/* Graph */
 		GraphType m_Graph;
@@ -148,8 +732,8 @@ namespace grm
 		/* Boolean indicating if the segmentation procedure is achieved */
 		bool m_Complete;
 
-		/* Activate the fast segmentation */
-		bool m_DoFastSegmentation;
+		/* Heuristic of the merging iterations (SetDoFastSegmentation selects the dithered one) */
+		MergingHeuristic m_MergingHeuristic;
 
 		/* Number of iterations for the Local Mutual Best Fitting segmentation */
 		unsigned int m_NumberOfIterations;
@@ -157,6 +741,17 @@ namespace grm
 		/* Limit threshold for the region merging criterion  */
 		float m_Threshold;
 
+		/* Threshold of each iteration relative to m_Threshold (constant by default) */
+		ThresholdSchedule m_ThresholdSchedule;
+
+		/*
+		  Lowest bound of the evaluations which left merging costs at
+		  BoundExceededCost in the graph: these costs are only known to
+		  be above it, hence they are evaluated again by the iterations
+		  with a higher threshold
+		*/
+		float m_ExceededCostBound;
+
 		/* Specific parameters required for the region merging criterion */
 		ParamType m_Param;
 
@@ -165,6 +760,104 @@ namespace grm
 		unsigned int m_ImageHeight; // NUmber of rows
 		unsigned int m_NumberOfComponentsPerPixel; // Number of spectral bands
 
+		/* Directory of the memory-mapped graph storage (empty: graph in RAM) */
+		std::string m_StorageDirectory;
+
+		/*
+		  Sort the nodes along the Z-order curve after the initialization
+		  and every m_NodeSortingPeriod iterations (0: keep the row-major order)
+		*/
+		unsigned int m_NodeSortingPeriod;
+
+		/*
+		  Minimum area (in pixels) of the final regions: the smaller ones
+		  are absorbed into their most similar neighbor after the merging
+		  iterations (0 or 1: no minimum)
+		*/
+		unsigned int m_MinimumRegionSize;
+
+		/*
+		  Number of lines of the strips in which the input image is read
+		  (0: strips of about DefaultStripSize bytes)
+		*/
+		unsigned int m_NumberOfLinesPerStrip;
+
+		/*
+		  Sides of the image shared with other tiles (combination of
+		  BorderSide): the nodes along them are frozen by Update
+		*/
+		unsigned int m_FrozenSides;
+
+		/*
+		  Position of the input image in the scene it is a tile of, and
+		  width of the scene (0: the scene is the input image), which
+		  define the global ids of the regions
+		*/
+		unsigned int m_SceneOffsetX;
+		unsigned int m_SceneOffsetY;
+		unsigned int m_SceneWidth;
+
+		/*
+		  Memory (in bytes) which the segmentation may take: Update refuses
+		  to start if EstimateMemoryUsage exceeds it (0: no limit)
+		*/
+		std::size_t m_MemoryBudget;
+
+		/* Number of threads of the export of the label images (0: see GetNumberOfThreads) */
+		unsigned int m_NumberOfThreads;
+		static const std::size_t DefaultStripSize = 64 * 1024 * 1024;
+
+		/* Statistics of the last segmentation and function called after each iteration */
+		SegmentationStatistics m_Statistics;
+		IterationCallbackType m_IterationCallback;
+
+		/*
+		 * The filling of the label image cannot tell the masked pixels
+		 * enclosed by a segment from a hole: they are reset afterwards.
+		 */
+		template<class TOutputImage>
+		void ResetMaskedPixels(TOutputImage * img, const typename TOutputImage::PixelType& value)
+		{
+			// The validity of a graph which was not built by InitNodes
+			// (read from a buffer for instance) is computed once here.
+			if(this->m_ValidPixels.empty())
+				ComputeValidPixels(this->m_ValidPixels);
+			if(this->m_ValidPixels.empty())
+				return;
+
+			const std::vector<bool>& valid = this->m_ValidPixels;
+
+			// The bands of rows are reset in parallel.
+			const typename TOutputImage::RegionType largestRegion = img->GetLargestPossibleRegion();
+			const std::size_t width = largestRegion.GetSize()[0];
+			ParallelFor(0, largestRegion.GetSize()[1], this->m_NumberOfThreads, [&](const std::size_t begin, const std::size_t end)
+				{
+					typename TOutputImage::RegionType band = largestRegion;
+					band.SetIndex(1, largestRegion.GetIndex()[1] + begin);
+					band.SetSize(1, end - begin);
+
+					std::size_t idx = begin * width;
+					itk::ImageRegionIterator<TOutputImage> it(img, band);
+					for(it.GoToBegin(); !it.IsAtEnd(); ++it, ++idx)
+					{
+						if(!valid[idx])
+							it.Set(value);
+					}
+				});
+		}
+
+		/* Pixels excluded from the segmentation: null pixels of the mask and no-data pixels */
+		typename MaskImageType::Pointer m_Mask;
+		bool m_UseNoDataValue;
+		float m_NoDataValue;
+
+		/* Bitmap of the pixels which are neither masked nor no-data (empty: all) */
+		std::vector<bool> m_ValidPixels;
+
+		/* Features computed for each segment and conversion buffer of a pixel */
+		FeatureAccumulatorSet m_FeatureAccumulators;
+		std::vector<float> m_PixelBuffer;
+
 		/* Pointer to the input image to segment */
 		TImage * m_InputImage;
 	};
@@ -0,0 +1,238 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_SMALL_VECTOR_H
+#define GRM_SMALL_VECTOR_H
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace grm
+{
+	/*
+	 * Sequence container with the subset of the std::vector interface used
+	 * by the graph. The first N elements are stored inside the object
+	 * itself, so the edge lists of the small regions (most of them at the
+	 * beginning of the segmentation) need no allocation at all. Larger
+	 * lists overflow into memory obtained from the allocator.
+	 *
+	 * Iterators are plain pointers and are invalidated by any insertion,
+	 * by erase (after the erased element) and by swap or move.
+	 */
+	template<class T, unsigned int N, class TAllocator = std::allocator<T> >
+	class SmallVector
+	{
+	public:
+
+		typedef T value_type;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef T* iterator;
+		typedef const T* const_iterator;
+		typedef std::size_t size_type;
+		typedef TAllocator allocator_type;
+
+		SmallVector() : m_Data(InlineData()), m_Size(0), m_Capacity(N) {}
+
+		explicit SmallVector(const TAllocator& allocator) :
+			m_Allocator(allocator), m_Data(InlineData()), m_Size(0), m_Capacity(N) {}
+
+		SmallVector(const SmallVector& other) :
+			m_Allocator(other.m_Allocator), m_Data(InlineData()), m_Size(0), m_Capacity(N)
+		{
+			CopyFrom(other);
+		}
+
+		SmallVector(SmallVector&& other) :
+			m_Allocator(other.m_Allocator), m_Data(InlineData()), m_Size(0), m_Capacity(N)
+		{
+			StealFrom(other);
+		}
+
+		~SmallVector()
+		{
+			clear();
+			Release();
+		}
+
+		SmallVector& operator=(const SmallVector& other)
+		{
+			if(this != &other)
+			{
+				clear();
+				Release();
+				m_Allocator = other.m_Allocator;
+				CopyFrom(other);
+			}
+			return *this;
+		}
+
+		SmallVector& operator=(SmallVector&& other)
+		{
+			if(this != &other)
+			{
+				clear();
+				Release();
+				m_Allocator = other.m_Allocator;
+				StealFrom(other);
+			}
+			return *this;
+		}
+
+		iterator begin() { return m_Data; }
+		iterator end() { return m_Data + m_Size; }
+		const_iterator begin() const { return m_Data; }
+		const_iterator end() const { return m_Data + m_Size; }
+
+		size_type size() const { return m_Size; }
+		size_type capacity() const { return m_Capacity; }
+		bool empty() const { return m_Size == 0; }
+
+		reference operator[](size_type i) { return m_Data[i]; }
+		const_reference operator[](size_type i) const { return m_Data[i]; }
+		reference front() { return m_Data[0]; }
+		const_reference front() const { return m_Data[0]; }
+		reference back() { return m_Data[m_Size - 1]; }
+		const_reference back() const { return m_Data[m_Size - 1]; }
+
+		allocator_type get_allocator() const { return m_Allocator; }
+
+		/* Are the elements stored inside the object */
+		bool IsInline() const { return m_Data == InlineData(); }
+
+		void push_back(const T& value)
+		{
+			if(m_Size == m_Capacity)
+			{
+				// value may be an element of this container.
+				T copy(value);
+				reserve(2 * m_Capacity);
+				::new(static_cast<void*>(m_Data + m_Size)) T(std::move(copy));
+			}
+			else
+				::new(static_cast<void*>(m_Data + m_Size)) T(value);
+			++m_Size;
+		}
+
+		void push_back(T&& value)
+		{
+			if(m_Size == m_Capacity)
+			{
+				T moved(std::move(value));
+				reserve(2 * m_Capacity);
+				::new(static_cast<void*>(m_Data + m_Size)) T(std::move(moved));
+			}
+			else
+				::new(static_cast<void*>(m_Data + m_Size)) T(std::move(value));
+			++m_Size;
+		}
+
+		iterator erase(iterator position)
+		{
+			std::move(position + 1, end(), position);
+			--m_Size;
+			m_Data[m_Size].~T();
+			return position;
+		}
+
+		void clear()
+		{
+			for(unsigned int i = 0; i < m_Size; ++i)
+				m_Data[i].~T();
+			m_Size = 0;
+		}
+
+		void reserve(size_type capacity)
+		{
+			if(capacity <= m_Capacity)
+				return;
+
+			T * data = m_Allocator.allocate(capacity);
+			for(unsigned int i = 0; i < m_Size; ++i)
+			{
+				::new(static_cast<void*>(data + i)) T(std::move(m_Data[i]));
+				m_Data[i].~T();
+			}
+			Release();
+			m_Data = data;
+			m_Capacity = static_cast<unsigned int>(capacity);
+		}
+
+		void swap(SmallVector& other)
+		{
+			SmallVector tmp(std::move(other));
+			other = std::move(*this);
+			*this = std::move(tmp);
+		}
+
+	private:
+
+		T * InlineData() { return reinterpret_cast<T*>(m_Buffer); }
+		const T * InlineData() const { return reinterpret_cast<const T*>(m_Buffer); }
+
+		/* Give the overflow memory back to the allocator (the container must be empty) */
+		void Release()
+		{
+			if(!IsInline())
+			{
+				m_Allocator.deallocate(m_Data, m_Capacity);
+				m_Data = InlineData();
+				m_Capacity = N;
+			}
+		}
+
+		/* The container must be empty and inline */
+		void CopyFrom(const SmallVector& other)
+		{
+			reserve(other.m_Size);
+			std::uninitialized_copy(other.begin(), other.end(), m_Data);
+			m_Size = other.m_Size;
+		}
+
+		/* The container must be empty and inline, other is left empty */
+		void StealFrom(SmallVector& other)
+		{
+			if(other.IsInline())
+			{
+				for(unsigned int i = 0; i < other.m_Size; ++i)
+					::new(static_cast<void*>(m_Data + i)) T(std::move(other.m_Data[i]));
+				m_Size = other.m_Size;
+				other.clear();
+			}
+			else
+			{
+				m_Data = other.m_Data;
+				m_Size = other.m_Size;
+				m_Capacity = other.m_Capacity;
+				other.m_Data = other.InlineData();
+				other.m_Size = 0;
+				other.m_Capacity = N;
+			}
+		}
+
+		TAllocator m_Allocator;
+		T * m_Data;
+		unsigned int m_Size;
+		unsigned int m_Capacity;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type m_Buffer[N];
+	};
+
+} // end of namespace grm
+#endif
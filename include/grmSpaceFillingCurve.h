@@ -0,0 +1,78 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_SPACE_FILLING_CURVE_H
+#define GRM_SPACE_FILLING_CURVE_H
+#include <cstdint>
+
+namespace grm
+{
+	/* Spread the 32 bits of v over the even bits of a 64 bits word. */
+	inline uint64_t SpreadBits(uint64_t v)
+	{
+		v &= 0x00000000ffffffffULL;
+		v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+		v = (v | (v << 8))  & 0x00ff00ff00ff00ffULL;
+		v = (v | (v << 4))  & 0x0f0f0f0f0f0f0f0fULL;
+		v = (v | (v << 2))  & 0x3333333333333333ULL;
+		v = (v | (v << 1))  & 0x5555555555555555ULL;
+		return v;
+	}
+
+	/* Position of the cell (x, y) along the Z-order (Morton) curve. */
+	inline uint64_t MortonCode(const uint64_t x, const uint64_t y)
+	{
+		return SpreadBits(x) | (SpreadBits(y) << 1);
+	}
+
+	/*
+	 * Visit the cells of a width x height grid along the Z-order curve,
+	 * calling f(id) with the row-major index of each cell. Quadrants lying
+	 * outside of the grid are pruned so the cost is linear in the number
+	 * of cells whatever the shape of the grid.
+	 */
+	template<class TFunction>
+	void ForEachCellInZOrder(const uint64_t x0, const uint64_t y0, const uint64_t size,
+							 const uint64_t width, const uint64_t height, TFunction& f)
+	{
+		if(x0 >= width || y0 >= height)
+			return;
+
+		if(size == 1)
+		{
+			f(y0 * width + x0);
+			return;
+		}
+
+		const uint64_t half = size / 2;
+		ForEachCellInZOrder(x0, y0, half, width, height, f);
+		ForEachCellInZOrder(x0 + half, y0, half, width, height, f);
+		ForEachCellInZOrder(x0, y0 + half, half, width, height, f);
+		ForEachCellInZOrder(x0 + half, y0 + half, half, width, height, f);
+	}
+
+	template<class TFunction>
+	void ForEachCellInZOrder(const uint64_t width, const uint64_t height, TFunction f)
+	{
+		uint64_t size = 1;
+		while(size < width || size < height)
+			size <<= 1;
+		ForEachCellInZOrder(0, 0, size, width, height, f);
+	}
+	
+} // end of namespace grm
+#endif
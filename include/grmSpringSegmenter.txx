@@ -28,35 +28,58 @@ namespace grm
 	void
 	SpringSegmenter<TImage>::InitFromImage()
 	{
-		typedef itk::ImageRegionIterator<TImage> ImageIterator;
+		typedef typename TImage::PixelType PixelType;
 
 		this->m_ImageWidth = this->m_InputImage->GetLargestPossibleRegion().GetSize()[0];
 		this->m_ImageHeight =this->m_InputImage->GetLargestPossibleRegion().GetSize()[1];
 		this->m_NumberOfComponentsPerPixel = this->m_InputImage->GetNumberOfComponentsPerPixel();
 
-		std::size_t idx = 0;
-		ImageIterator it(this->m_InputImage, this->m_InputImage->GetLargestPossibleRegion());
-		for(it.GoToBegin(); !it.IsAtEnd(); ++it)
-		{
-			this->m_Graph.m_Nodes[idx]->m_Means.reserve(this->m_NumberOfComponentsPerPixel);
-
-			for(std::size_t b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+		this->ForEachValidPixel([&](const std::size_t idx, const PixelType& pixel)
 			{
-				this->m_Graph.m_Nodes[idx]->m_Means.push_back(it.Get()[b]);
-			}	
-			++idx;
-		}
+				this->m_Graph.m_Nodes[idx]->m_Means.reserve(this->m_NumberOfComponentsPerPixel);
+
+				for(std::size_t b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+				{
+					this->m_Graph.m_Nodes[idx]->m_Means.push_back(pixel[b]);
+				}
+				this->InitFeatures(idx, pixel);
+			});
 	}
 
 	template<class TImage>
 	float
 	SpringSegmenter<TImage>::ComputeMergingCost(NodePointerType n1, NodePointerType n2)
 	{
+		return ComputeBoundedMergingCost(n1, n2, 0, std::numeric_limits<float>::max());
+	}
+
+	template<class TImage>
+	void
+	SpringSegmenter<TImage>::ComputeMergingCosts(NodePointerType r,
+												 EdgeType * const * edges,
+												 const std::size_t n,
+												 float * costs,
+												 const float bound)
+	{
+		for(std::size_t i = 0; i < n; ++i)
+			costs[i] = ComputeBoundedMergingCost(r, edges[i]->GetRegion(), edges[i]->m_Boundary, bound);
+	}
+
+	template<class TImage>
+	float
+	SpringSegmenter<TImage>::ComputeBoundedMergingCost(NodePointerType n1, NodePointerType n2,
+													   const unsigned int, const float bound)
+	{
+		const float squaredBound = bound * bound;
 		float eucDist = 0.0;
 
 		for(unsigned int b = 0; b < this->m_NumberOfComponentsPerPixel; b++)
 		{
 			eucDist += (n1->m_Means[b] - n2->m_Means[b])*(n1->m_Means[b] - n2->m_Means[b]);
+
+			// The next bands can only increase the distance.
+			if(eucDist >= squaredBound && std::sqrt(eucDist) >= bound)
+				break;
 		}
 
 		return (static_cast<float>(std::sqrt(eucDist)));
@@ -75,5 +98,26 @@ namespace grm
 			n1->m_Means[b] = (a1 * n1->m_Means[b] + a2 * n2->m_Means[b]) / a_sum;
 		}
 	}
+
+	template<class TImage>
+	void
+	SpringSegmenter<TImage>::WriteAttributes(GraphBuffer& buffer, NodePointerType n)
+	{
+		buffer.Write(n->m_Means);
+	}
+
+	template<class TImage>
+	void
+	SpringSegmenter<TImage>::ReadAttributes(GraphBuffer& buffer, NodePointerType n)
+	{
+		buffer.Read(n->m_Means);
+	}
+
+	template<class TImage>
+	void
+	SpringSegmenter<TImage>::GetMeans(NodePointerType n, float * means)
+	{
+		std::copy(n->m_Means.begin(), n->m_Means.end(), means);
+	}
 } // end of namespace grm
 #endif
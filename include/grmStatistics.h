@@ -0,0 +1,106 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_STATISTICS_H
+#define GRM_STATISTICS_H
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace grm
+{
+	/* What happened during one iteration of the merging process. */
+	struct IterationStatistics
+	{
+		/* Iteration number (starting at 1) and maximum number of iterations */
+		unsigned int m_Iteration;
+		unsigned int m_MaximumNumberOfIterations;
+
+		/* Threshold of the criterion during the iteration (see ThresholdSchedule) */
+		float m_Threshold;
+
+		/* State of the graph at the end of the iteration */
+		std::size_t m_NumberOfNodes;
+		std::size_t m_NumberOfEdges;
+
+		/* Work done during the iteration */
+		std::size_t m_NumberOfMerges;
+		std::size_t m_NumberOfCostEvaluations;
+
+		/* Number of edge costs reused because neither node changed */
+		std::size_t m_NumberOfCachedCosts;
+
+		/* Time (in seconds) spent in each step of the iteration */
+		double m_CostUpdateTime;
+		double m_MergeTime;
+		double m_NodeRemovalTime;
+
+		/* Resident memory of the process (in bytes) at the end of the iteration */
+		std::size_t m_MemoryUsage;
+	};
+
+	/* Function called at the end of each iteration. */
+	typedef std::function<void(const IterationStatistics&)> IterationCallbackType;
+
+	/* Record of a whole segmentation. */
+	struct SegmentationStatistics
+	{
+		SegmentationStatistics() { Clear(); }
+
+		void Clear();
+
+		/* Write the per-iteration records in CSV or JSON */
+		void WriteCSV(std::ostream& os) const;
+		void WriteJSON(std::ostream& os) const;
+
+		/* Write in JSON if the file name ends with .json, in CSV otherwise */
+		void Write(const std::string& fileName) const;
+
+		/* Time (in seconds) spent to build the initial graph */
+		double m_InitializationTime;
+
+		/* Number of nodes of the initial graph */
+		std::size_t m_InitialNumberOfNodes;
+
+		/* Running count of the merging cost evaluations */
+		std::size_t m_NumberOfCostEvaluations;
+
+		/* Running count of the edge costs reused without evaluation */
+		std::size_t m_NumberOfCachedCosts;
+
+		/* Small regions absorbed by the minimum size pass and time (in seconds) spent in it */
+		std::size_t m_NumberOfSmallRegionMerges;
+		double m_SmallRegionMergingTime;
+
+		/*
+		  Resident memory of the process (in bytes) at the start of the
+		  segmentation, peak resident memory during the segmentation (the
+		  whole life of the process where the peak cannot be reset) and
+		  memory estimated before the segmentation (see
+		  Segmenter::EstimateMemoryUsage; 0 if not estimated)
+		*/
+		std::size_t m_InitialMemoryUsage;
+		std::size_t m_PeakMemoryUsage;
+		std::size_t m_EstimatedMemoryUsage;
+
+		std::vector<IterationStatistics> m_Iterations;
+	};
+	
+} // end of namespace grm
+#endif
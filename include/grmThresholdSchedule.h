@@ -0,0 +1,93 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef GRM_THRESHOLD_SCHEDULE_H
+#define GRM_THRESHOLD_SCHEDULE_H
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace grm
+{
+	/*
+	 * Threshold of each iteration of the merging process, as a factor of
+	 * the threshold of the segmenter (of its square for the Baatz
+	 * criterion). A schedule starting below 1 only lets the most similar
+	 * regions merge during the first iterations, the threshold being
+	 * relaxed up to the one of the segmenter afterwards:
+	 *
+	 * - constant: factor 1 at each iteration (default),
+	 * - linear: from startFactor at the first iteration to 1 at the
+	 *   iteration numberOfIterations + 1, by equal steps,
+	 * - geometric: same with a constant ratio between two iterations,
+	 * - table: the given factors for the first iterations, the last one
+	 *   being kept afterwards.
+	 */
+	class ThresholdSchedule
+	{
+	public:
+
+		/* Constant schedule */
+		ThresholdSchedule();
+
+		static ThresholdSchedule Linear(const float startFactor, const unsigned int numberOfIterations);
+		static ThresholdSchedule Geometric(const float startFactor, const unsigned int numberOfIterations);
+		static ThresholdSchedule Table(const std::vector<float>& factors);
+
+		/*
+		 * Given a description "constant", "linear:start:iterations",
+		 * "geometric:start:iterations" or "table:f1,f2,...", it returns
+		 * the corresponding schedule.
+		 */
+		static ThresholdSchedule Parse(const std::string& description);
+
+		/*
+		 * Given the index of an iteration (0 for the first one) and the
+		 * threshold of the segmenter, it returns the threshold of the
+		 * iteration.
+		 */
+		float GetThreshold(const std::size_t iteration, const float threshold) const;
+
+		/*
+		 * True if the threshold of the iteration following the given one
+		 * is higher: the merging has to go on even if nothing merged.
+		 */
+		bool IsRising(const std::size_t iteration, const float threshold) const;
+
+		bool IsConstant() const { return m_Type == CONSTANT; }
+
+	private:
+
+		enum ScheduleType
+		{
+			CONSTANT,
+			LINEAR,
+			GEOMETRIC,
+			TABLE
+		};
+
+		/* Factor of the threshold of the segmenter at an iteration */
+		float GetFactor(const std::size_t iteration) const;
+
+		ScheduleType m_Type;
+		float m_StartFactor;
+		unsigned int m_NumberOfIterations;
+		std::vector<float> m_Factors;
+	};
+
+} // end of namespace grm
+#endif
@@ -24,7 +24,8 @@
 #include <utility>
 #include <unordered_set>
 #include <unordered_map>
-#include <boost/dynamic_bitset.hpp>
+#include <cstdint>
+#include "grmSmallVector.h"
 
 // Improvement: do not use a boolean matrix but a collection because
 // at the end of the process matrices are sparses.
@@ -32,24 +33,34 @@
 namespace lp
 {
 	/* Move along a contour: 4 possibles: top (0), right(1), bottom (2), left(3). */
-	using Move = std::bitset<2>;
-	/* A contour is a list of moves represented by a pair of bits*/
-	using Contour = boost::dynamic_bitset<>;
+	using Move = short;
+
+	/*
+	  Run of identical moves: the move is coded on the 2 lower bits
+	  and the number of moves on the 30 upper bits.
+	 */
+	using Run = std::uint32_t;
+
+	/*
+	  A contour is a list of runs of moves. Two consecutive runs have
+	  different moves, so long straight borders only take one run and
+	  the contour of a pixel (4 runs) is stored without allocation.
+	 */
+	using Contour = grm::SmallVector<Run, 4>;
  
-	using ContourIndex = boost::dynamic_bitset<>::size_type;
-
 	/* Index of a cell in the grid */
 	using CellIndex = std::size_t;
 
 	/* List of cell indices */
 	using CellLists = std::unordered_set<CellIndex>;
 	
+	/* Coordinates and size in 32 bits: the grids are less than 2^32 cells wide and high */
 	struct BoundingBox
 	{
-		std::size_t m_UX;
-		std::size_t m_UY;
-		std::size_t m_W;
-		std::size_t m_H;
+		unsigned int m_UX;
+		unsigned int m_UY;
+		unsigned int m_W;
+		unsigned int m_H;
 	};
 
 	class ContourOperations
@@ -61,9 +72,12 @@ namespace lp
 		static void Push2(Contour& contour); // Push a move to the bottom.
 		static void Push3(Contour& contour); // Push a move to the left.
 		
+		static void Push(Contour& contour, const Move m); // Push a move m.
+		
 		/* Methods to access to elements of a contour. */
-		static Move GetMove2(ContourIndex idx, const Contour& contour); // Retrieve a move
-		static short GetMove10(const Move& m); // Transform the move into a 10 base number (0,1,2 or 3).
+		static Move GetRunMove(const Run r) { return static_cast<Move>(r & 3); } // Move of a run.
+		static std::size_t GetRunLength(const Run r) { return r >> 2; } // Number of moves of a run.
+		static std::size_t GetNumberOfMoves(const Contour& contour); // Total number of moves.
 
 		/* Main methods */
 		static void MergeContour(Contour& mergedContour,
@@ -0,0 +1,165 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "grmCommunicator.h"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#ifdef GRM_USE_MPI
+#include <mpi.h>
+#endif
+
+namespace grm
+{
+	Communicator::Communicator() : m_Rank(0), m_Size(1), m_UseMPI(false), m_Finalize(false)
+	{
+	}
+
+#ifdef GRM_USE_MPI
+	namespace
+	{
+		/* MPI counts are ints: the buffers are exchanged by chunks */
+		const std::size_t ChunkSize = std::size_t(1) << 30;
+
+		void Check(const int error, const char * function)
+		{
+			if(error != MPI_SUCCESS)
+				throw std::runtime_error(std::string("Communicator - ") + function + " failed");
+		}
+	}
+
+	Communicator::Communicator(int * argc, char *** argv) : m_Rank(0), m_Size(1), m_UseMPI(true), m_Finalize(false)
+	{
+		int initialized = 0;
+		Check(MPI_Initialized(&initialized), "MPI_Initialized");
+		if(!initialized)
+		{
+			Check(MPI_Init(argc, argv), "MPI_Init");
+			m_Finalize = true;
+		}
+		Check(MPI_Comm_rank(MPI_COMM_WORLD, &m_Rank), "MPI_Comm_rank");
+		Check(MPI_Comm_size(MPI_COMM_WORLD, &m_Size), "MPI_Comm_size");
+	}
+
+	Communicator::~Communicator()
+	{
+		if(m_Finalize)
+			MPI_Finalize();
+	}
+
+	bool Communicator::IsMPIEnabled()
+	{
+		return true;
+	}
+
+	void Communicator::Send(const std::vector<char>& data, const int destination)
+	{
+		if(!m_UseMPI)
+			throw std::runtime_error("Communicator::Send - The communicator has a single process");
+
+		uint64_t size = data.size();
+		Check(MPI_Send(&size, 1, MPI_UINT64_T, destination, 0, MPI_COMM_WORLD), "MPI_Send");
+		for(std::size_t offset = 0; offset < data.size(); offset += ChunkSize)
+		{
+			const int count = static_cast<int>(std::min(ChunkSize, data.size() - offset));
+			Check(MPI_Send(const_cast<char*>(data.data()) + offset, count, MPI_BYTE, destination, 0, MPI_COMM_WORLD), "MPI_Send");
+		}
+	}
+
+	void Communicator::Receive(std::vector<char>& data, const int source)
+	{
+		if(!m_UseMPI)
+			throw std::runtime_error("Communicator::Receive - The communicator has a single process");
+
+		uint64_t size = 0;
+		Check(MPI_Recv(&size, 1, MPI_UINT64_T, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE), "MPI_Recv");
+		data.resize(size);
+		for(std::size_t offset = 0; offset < data.size(); offset += ChunkSize)
+		{
+			const int count = static_cast<int>(std::min(ChunkSize, data.size() - offset));
+			Check(MPI_Recv(data.data() + offset, count, MPI_BYTE, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE), "MPI_Recv");
+		}
+	}
+
+	void Communicator::Broadcast(std::vector<char>& data, const int root)
+	{
+		if(!m_UseMPI)
+			return;
+
+		uint64_t size = data.size();
+		Check(MPI_Bcast(&size, 1, MPI_UINT64_T, root, MPI_COMM_WORLD), "MPI_Bcast");
+		data.resize(size);
+		for(std::size_t offset = 0; offset < data.size(); offset += ChunkSize)
+		{
+			const int count = static_cast<int>(std::min(ChunkSize, data.size() - offset));
+			Check(MPI_Bcast(data.data() + offset, count, MPI_BYTE, root, MPI_COMM_WORLD), "MPI_Bcast");
+		}
+	}
+
+	void Communicator::Barrier()
+	{
+		if(!m_UseMPI)
+			return;
+		Check(MPI_Barrier(MPI_COMM_WORLD), "MPI_Barrier");
+	}
+
+	void Communicator::Abort(const int errorCode)
+	{
+		if(m_UseMPI)
+			MPI_Abort(MPI_COMM_WORLD, errorCode);
+	}
+#else
+	// Without MPI there is a single process, which never exchanges messages.
+
+	Communicator::Communicator(int *, char ***) : m_Rank(0), m_Size(1), m_UseMPI(false), m_Finalize(false)
+	{
+	}
+
+	Communicator::~Communicator()
+	{
+	}
+
+	bool Communicator::IsMPIEnabled()
+	{
+		return false;
+	}
+
+	void Communicator::Send(const std::vector<char>&, const int)
+	{
+		throw std::runtime_error("Communicator::Send - The library is built without MPI");
+	}
+
+	void Communicator::Receive(std::vector<char>&, const int)
+	{
+		throw std::runtime_error("Communicator::Receive - The library is built without MPI");
+	}
+
+	void Communicator::Broadcast(std::vector<char>&, const int)
+	{
+	}
+
+	void Communicator::Barrier()
+	{
+	}
+
+	void Communicator::Abort(const int)
+	{
+	}
+#endif
+
+} // end of namespace grm
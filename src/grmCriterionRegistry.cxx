@@ -0,0 +1,167 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "grmCriterionRegistry.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <dirent.h>
+#include <dlfcn.h>
+
+namespace grm
+{
+	namespace
+	{
+		/* Registry given to the entry point of a library */
+		struct Registration
+		{
+			CriterionRegistry * m_Registry;
+			std::string m_Error;
+		};
+
+		/* No exception is thrown through the library: the first error is reported after its entry point returns */
+		void RegisterCriterion(void * registry, const GRMCriterionPlugin * criterion)
+		{
+			Registration * registration = static_cast<Registration*>(registry);
+			try
+			{
+				registration->m_Registry->Register(criterion);
+			}
+			catch(const std::exception& e)
+			{
+				if(registration->m_Error.empty())
+					registration->m_Error = e.what();
+			}
+		}
+
+		bool HasExtension(const std::string& fileName, const std::string& extension)
+		{
+			return fileName.size() > extension.size() &&
+				fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0;
+		}
+	} // end of anonymous namespace
+
+	const char * const CriterionRegistry::PluginPathVariable = "GRM_CRITERION_PLUGIN_PATH";
+
+	CriterionRegistry::~CriterionRegistry()
+	{
+		for(auto& library : m_Libraries)
+			dlclose(library);
+	}
+
+	void CriterionRegistry::Register(const GRMCriterionPlugin * criterion)
+	{
+		if(criterion == nullptr || criterion->m_Name == nullptr)
+			throw std::runtime_error("CriterionRegistry::Register - Invalid criterion");
+
+		// The name is the value of a parameter of the application.
+		const std::string name(criterion->m_Name);
+		if(name.empty() || name.find_first_not_of("abcdefghijklmnopqrstuvwxyz0123456789") != std::string::npos)
+			throw std::runtime_error("CriterionRegistry::Register - The name of criterion " + name +
+									 " has to be made of lower case letters and digits");
+
+		if(criterion->m_AbiVersion != GRM_CRITERION_PLUGIN_ABI_VERSION)
+		{
+			std::ostringstream os;
+			os << "CriterionRegistry::Register - Criterion " << name << " is built for the ABI version "
+			   << criterion->m_AbiVersion << " instead of " << GRM_CRITERION_PLUGIN_ABI_VERSION;
+			throw std::runtime_error(os.str());
+		}
+
+		if(criterion->m_CreateContext == nullptr || criterion->m_DestroyContext == nullptr ||
+		   criterion->m_GetNumberOfAttributes == nullptr || criterion->m_InitAttributes == nullptr ||
+		   criterion->m_ComputeMergingCosts == nullptr || criterion->m_MergeAttributes == nullptr)
+			throw std::runtime_error("CriterionRegistry::Register - Criterion " + name + " does not define all its kernels");
+
+		if(Find(name) != nullptr)
+			throw std::runtime_error("CriterionRegistry::Register - Criterion " + name + " is already registered");
+
+		m_Criteria.push_back(criterion);
+	}
+
+	void CriterionRegistry::LoadLibrary(const std::string& fileName)
+	{
+		void * library = dlopen(fileName.c_str(), RTLD_NOW | RTLD_LOCAL);
+		if(library == nullptr)
+			throw std::runtime_error("CriterionRegistry::LoadLibrary - " + std::string(dlerror()));
+
+		GRMRegisterCriteriaFunction entryPoint =
+			reinterpret_cast<GRMRegisterCriteriaFunction>(dlsym(library, GRM_CRITERION_PLUGIN_ENTRY_POINT));
+		if(entryPoint == nullptr)
+		{
+			dlclose(library);
+			throw std::runtime_error("CriterionRegistry::LoadLibrary - " + fileName + " does not export " +
+									 GRM_CRITERION_PLUGIN_ENTRY_POINT);
+		}
+
+		// The library is kept even if one of its criteria is rejected, since
+		// the other ones may be registered.
+		m_Libraries.push_back(library);
+		Registration registration = {this, std::string()};
+		entryPoint(&RegisterCriterion, &registration);
+		if(!registration.m_Error.empty())
+			throw std::runtime_error(registration.m_Error + " (" + fileName + ")");
+	}
+
+	void CriterionRegistry::LoadDirectory(const std::string& directory)
+	{
+		DIR * dir = opendir(directory.c_str());
+		if(dir == nullptr)
+			throw std::runtime_error("CriterionRegistry::LoadDirectory - Cannot open " + directory);
+
+		// Load the libraries in a reproducible order.
+		std::vector<std::string> fileNames;
+		while(struct dirent * entry = readdir(dir))
+		{
+			const std::string fileName(entry->d_name);
+			if(HasExtension(fileName, ".so") || HasExtension(fileName, ".dylib"))
+				fileNames.push_back(directory + "/" + fileName);
+		}
+		closedir(dir);
+
+		std::sort(fileNames.begin(), fileNames.end());
+		for(auto& fileName : fileNames)
+			LoadLibrary(fileName);
+	}
+
+	void CriterionRegistry::LoadFromEnvironment()
+	{
+		const char * path = std::getenv(PluginPathVariable);
+		if(path == nullptr)
+			return;
+
+		std::istringstream is(path);
+		std::string directory;
+		while(std::getline(is, directory, ':'))
+		{
+			if(!directory.empty())
+				LoadDirectory(directory);
+		}
+	}
+
+	const GRMCriterionPlugin * CriterionRegistry::Find(const std::string& name) const
+	{
+		for(auto& criterion : m_Criteria)
+		{
+			if(name == criterion->m_Name)
+				return criterion;
+		}
+		return nullptr;
+	}
+
+} // end of namespace grm
@@ -0,0 +1,369 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "grmFeatureAccumulators.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace grm
+{
+	namespace
+	{
+		std::string BandName(const std::string& prefix, const unsigned int band)
+		{
+			std::ostringstream os;
+			os << prefix << "_b" << band;
+			return os.str();
+		}
+
+		/*
+		 * Pairwise combination of the central moments of two sets of
+		 * values (Chan et al., Pebay): only the difference of the means is
+		 * raised to a power, hence no cancellation for large sets of
+		 * values with a large mean.
+		 */
+		void MergeCentralMoments(const double n1, const double mean1, double& m2, double * m3,
+								 const double n2, const double mean2, const double otherM2, const double * otherM3)
+		{
+			const double n = n1 + n2;
+			const double delta = mean2 - mean1;
+			if(m3 != nullptr)
+			{
+				*m3 += *otherM3 + delta * delta * delta * n1 * n2 * (n1 - n2) / (n * n) +
+					3.0 * delta * (n1 * otherM2 - n2 * m2) / n;
+			}
+			m2 += otherM2 + delta * delta * n1 * n2 / n;
+		}
+
+		void CheckBand(const std::string& accumulator, const unsigned int band, const unsigned int n)
+		{
+			if(band < 1 || band > n)
+			{
+				std::ostringstream os;
+				os << accumulator << " - Band " << band << " is not in [1, " << n << "]";
+				throw std::runtime_error(os.str());
+			}
+		}
+	} // end of anonymous namespace
+
+	/* MinMaxAccumulator: state = [min(b), max(b)] */
+
+	std::size_t MinMaxAccumulator::GetStateSize() const
+	{
+		return 2 * m_NumberOfComponentsPerPixel;
+	}
+
+	void MinMaxAccumulator::Initialize(double * state, const float * pixel) const
+	{
+		for(unsigned int b = 0; b < m_NumberOfComponentsPerPixel; ++b)
+		{
+			state[b] = pixel[b];
+			state[m_NumberOfComponentsPerPixel + b] = pixel[b];
+		}
+	}
+
+	void MinMaxAccumulator::Merge(double * state, const unsigned int, const double * other, const unsigned int) const
+	{
+		for(unsigned int b = 0; b < m_NumberOfComponentsPerPixel; ++b)
+		{
+			state[b] = std::min(state[b], other[b]);
+			state[m_NumberOfComponentsPerPixel + b] = std::max(state[m_NumberOfComponentsPerPixel + b],
+															   other[m_NumberOfComponentsPerPixel + b]);
+		}
+	}
+
+	std::vector<std::string> MinMaxAccumulator::GetFeatureNames() const
+	{
+		std::vector<std::string> names;
+		for(unsigned int b = 1; b <= m_NumberOfComponentsPerPixel; ++b)
+			names.push_back(BandName("min", b));
+		for(unsigned int b = 1; b <= m_NumberOfComponentsPerPixel; ++b)
+			names.push_back(BandName("max", b));
+		return names;
+	}
+
+	void MinMaxAccumulator::GetFeatures(const double * state,
+										const unsigned int,
+										std::vector<double>& features) const
+	{
+		features.insert(features.end(), state, state + GetStateSize());
+	}
+
+	/*
+	 * MomentsAccumulator: state = [sum(b), M2(b), M3(b)], the sums of the
+	 * squared and cubed deviations from the mean
+	 */
+
+	std::size_t MomentsAccumulator::GetStateSize() const
+	{
+		return 3 * m_NumberOfComponentsPerPixel;
+	}
+
+	void MomentsAccumulator::Initialize(double * state, const float * pixel) const
+	{
+		const unsigned int n = m_NumberOfComponentsPerPixel;
+		for(unsigned int b = 0; b < n; ++b)
+		{
+			state[b] = pixel[b];
+			state[n + b] = 0.0;
+			state[2 * n + b] = 0.0;
+		}
+	}
+
+	void MomentsAccumulator::Merge(double * state, const unsigned int area,
+								   const double * other, const unsigned int otherArea) const
+	{
+		const unsigned int n = m_NumberOfComponentsPerPixel;
+		for(unsigned int b = 0; b < n; ++b)
+		{
+			// The moments are combined before the sums, which give the means.
+			MergeCentralMoments(area, state[b] / area, state[n + b], &state[2 * n + b],
+								otherArea, other[b] / otherArea, other[n + b], &other[2 * n + b]);
+			state[b] += other[b];
+		}
+	}
+
+	std::vector<std::string> MomentsAccumulator::GetFeatureNames() const
+	{
+		std::vector<std::string> names;
+		for(unsigned int b = 1; b <= m_NumberOfComponentsPerPixel; ++b)
+		{
+			names.push_back(BandName("mean", b));
+			names.push_back(BandName("std", b));
+			names.push_back(BandName("skewness", b));
+		}
+		return names;
+	}
+
+	void MomentsAccumulator::GetFeatures(const double * state,
+										 const unsigned int area,
+										 std::vector<double>& features) const
+	{
+		const unsigned int n = m_NumberOfComponentsPerPixel;
+		for(unsigned int b = 0; b < n; ++b)
+		{
+			const double variance = state[n + b] / area;
+			const double std = std::sqrt(variance);
+			features.push_back(state[b] / area);
+			features.push_back(std);
+			features.push_back((std > 0.0) ? state[2 * n + b] / area / (variance * std) : 0.0);
+		}
+	}
+
+	/* HistogramAccumulator: state = [count(bin)] */
+
+	HistogramAccumulator::HistogramAccumulator(const unsigned int band,
+											   const unsigned int numberOfBins,
+											   const float minimum,
+											   const float maximum) :
+		m_Band(band), m_NumberOfBins(numberOfBins), m_Minimum(minimum), m_Maximum(maximum)
+	{
+		if(numberOfBins < 1 || !(minimum < maximum))
+			throw std::runtime_error("HistogramAccumulator - Invalid number of bins or range");
+	}
+
+	void HistogramAccumulator::SetNumberOfComponentsPerPixel(const unsigned int n)
+	{
+		CheckBand("HistogramAccumulator", m_Band, n);
+		FeatureAccumulator::SetNumberOfComponentsPerPixel(n);
+	}
+
+	std::size_t HistogramAccumulator::GetStateSize() const
+	{
+		return m_NumberOfBins;
+	}
+
+	void HistogramAccumulator::Initialize(double * state, const float * pixel) const
+	{
+		std::fill(state, state + m_NumberOfBins, 0.0);
+
+		// The values out of the range go to the first or last bin.
+		const float v = pixel[m_Band - 1];
+		long int bin = static_cast<long int>(std::floor((v - m_Minimum) / (m_Maximum - m_Minimum) * m_NumberOfBins));
+		bin = std::max(0L, std::min(bin, static_cast<long int>(m_NumberOfBins) - 1));
+		state[bin] = 1.0;
+	}
+
+	void HistogramAccumulator::Merge(double * state, const unsigned int, const double * other, const unsigned int) const
+	{
+		for(unsigned int i = 0; i < m_NumberOfBins; ++i)
+			state[i] += other[i];
+	}
+
+	std::vector<std::string> HistogramAccumulator::GetFeatureNames() const
+	{
+		std::vector<std::string> names;
+		for(unsigned int i = 0; i < m_NumberOfBins; ++i)
+		{
+			std::ostringstream os;
+			os << BandName("hist", m_Band) << "_" << i;
+			names.push_back(os.str());
+		}
+		return names;
+	}
+
+	void HistogramAccumulator::GetFeatures(const double * state,
+										   const unsigned int area,
+										   std::vector<double>& features) const
+	{
+		for(unsigned int i = 0; i < m_NumberOfBins; ++i)
+			features.push_back(state[i] / area);
+	}
+
+	/* NDVIAccumulator: state = [sum, sum of the squared deviations from the mean, min, max] */
+
+	NDVIAccumulator::NDVIAccumulator(const unsigned int redBand, const unsigned int nirBand) :
+		m_RedBand(redBand), m_NIRBand(nirBand)
+	{
+	}
+
+	void NDVIAccumulator::SetNumberOfComponentsPerPixel(const unsigned int n)
+	{
+		CheckBand("NDVIAccumulator", m_RedBand, n);
+		CheckBand("NDVIAccumulator", m_NIRBand, n);
+		FeatureAccumulator::SetNumberOfComponentsPerPixel(n);
+	}
+
+	std::size_t NDVIAccumulator::GetStateSize() const
+	{
+		return 4;
+	}
+
+	void NDVIAccumulator::Initialize(double * state, const float * pixel) const
+	{
+		const double red = pixel[m_RedBand - 1], nir = pixel[m_NIRBand - 1];
+		const double ndvi = (nir + red != 0.0) ? (nir - red) / (nir + red) : 0.0;
+		state[0] = ndvi;
+		state[1] = 0.0;
+		state[2] = ndvi;
+		state[3] = ndvi;
+	}
+
+	void NDVIAccumulator::Merge(double * state, const unsigned int area,
+								const double * other, const unsigned int otherArea) const
+	{
+		MergeCentralMoments(area, state[0] / area, state[1], nullptr, otherArea, other[0] / otherArea, other[1], nullptr);
+		state[0] += other[0];
+		state[2] = std::min(state[2], other[2]);
+		state[3] = std::max(state[3], other[3]);
+	}
+
+	std::vector<std::string> NDVIAccumulator::GetFeatureNames() const
+	{
+		return {"ndvi_mean", "ndvi_std", "ndvi_min", "ndvi_max"};
+	}
+
+	void NDVIAccumulator::GetFeatures(const double * state,
+									  const unsigned int area,
+									  std::vector<double>& features) const
+	{
+		const double mean = state[0] / area;
+		features.push_back(mean);
+		features.push_back(std::sqrt(state[1] / area));
+		features.push_back(state[2]);
+		features.push_back(state[3]);
+	}
+
+	/* FeatureAccumulatorSet */
+
+	void FeatureAccumulatorSet::Add(std::shared_ptr<FeatureAccumulator> accumulator)
+	{
+		m_Accumulators.push_back(accumulator);
+	}
+
+	void FeatureAccumulatorSet::Clear()
+	{
+		m_Accumulators.clear();
+		m_Offsets.clear();
+		m_StateSize = 0;
+	}
+
+	void FeatureAccumulatorSet::SetNumberOfComponentsPerPixel(const unsigned int n)
+	{
+		m_Offsets.clear();
+		m_StateSize = 0;
+		for(auto& accumulator : m_Accumulators)
+		{
+			accumulator->SetNumberOfComponentsPerPixel(n);
+			m_Offsets.push_back(m_StateSize);
+			m_StateSize += accumulator->GetStateSize();
+		}
+	}
+
+	void FeatureAccumulatorSet::Initialize(double * state, const float * pixel) const
+	{
+		for(std::size_t i = 0; i < m_Accumulators.size(); ++i)
+			m_Accumulators[i]->Initialize(state + m_Offsets[i], pixel);
+	}
+
+	void FeatureAccumulatorSet::Merge(double * state, const unsigned int area,
+									  const double * other, const unsigned int otherArea) const
+	{
+		for(std::size_t i = 0; i < m_Accumulators.size(); ++i)
+			m_Accumulators[i]->Merge(state + m_Offsets[i], area, other + m_Offsets[i], otherArea);
+	}
+
+	std::vector<std::string> FeatureAccumulatorSet::GetFeatureNames() const
+	{
+		std::vector<std::string> names;
+		for(auto& accumulator : m_Accumulators)
+		{
+			auto accumulatorNames = accumulator->GetFeatureNames();
+			names.insert(names.end(), accumulatorNames.begin(), accumulatorNames.end());
+		}
+		return names;
+	}
+
+	void FeatureAccumulatorSet::GetFeatures(const double * state,
+											const unsigned int area,
+											std::vector<double>& features) const
+	{
+		for(std::size_t i = 0; i < m_Accumulators.size(); ++i)
+			m_Accumulators[i]->GetFeatures(state + m_Offsets[i], area, features);
+	}
+
+	std::shared_ptr<FeatureAccumulator> CreateFeatureAccumulator(const std::string& description)
+	{
+		std::vector<std::string> tokens;
+		std::istringstream is(description);
+		std::string token;
+		while(std::getline(is, token, ':'))
+			tokens.push_back(token);
+
+		try
+		{
+			if(tokens.size() == 1 && tokens[0] == "minmax")
+				return std::make_shared<MinMaxAccumulator>();
+			if(tokens.size() == 1 && tokens[0] == "moments")
+				return std::make_shared<MomentsAccumulator>();
+			if(tokens.size() == 5 && tokens[0] == "histogram")
+				return std::make_shared<HistogramAccumulator>(std::stoul(tokens[1]), std::stoul(tokens[2]),
+															  std::stof(tokens[3]), std::stof(tokens[4]));
+			if(tokens.size() == 3 && tokens[0] == "ndvi")
+				return std::make_shared<NDVIAccumulator>(std::stoul(tokens[1]), std::stoul(tokens[2]));
+		}
+		catch(const std::logic_error&)
+		{
+			// Numbers which cannot be parsed are reported below.
+		}
+
+		throw std::runtime_error("CreateFeatureAccumulator - Invalid feature description: " + description);
+	}
+
+} // end of namespace grm
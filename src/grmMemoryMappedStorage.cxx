@@ -0,0 +1,133 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "grmMemoryMappedStorage.h"
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace grm
+{
+	MemoryMappedStorage::MemoryMappedStorage(const std::size_t segmentSize) :
+		m_FileDescriptor(-1), m_FileSize(0), m_SegmentSize(segmentSize),
+		m_Cursor(nullptr), m_End(nullptr)
+	{
+	}
+
+	MemoryMappedStorage::MemoryMappedStorage(const std::string& directory,
+											 const std::size_t segmentSize) :
+		m_FileDescriptor(-1), m_FileSize(0), m_SegmentSize(segmentSize),
+		m_Cursor(nullptr), m_End(nullptr)
+	{
+		std::string path = directory + "/grmGraphXXXXXX";
+		std::vector<char> name(path.begin(), path.end());
+		name.push_back('\0');
+
+		m_FileDescriptor = mkstemp(name.data());
+		if(m_FileDescriptor < 0)
+			throw std::runtime_error("MemoryMappedStorage - Cannot create a file in " + directory +
+									 ": " + std::strerror(errno));
+
+		// The file only lives as long as it is opened.
+		unlink(name.data());
+	}
+
+	MemoryMappedStorage::~MemoryMappedStorage()
+	{
+		for(auto& segment : m_Segments)
+			munmap(segment.first, segment.second);
+		if(m_FileDescriptor >= 0)
+			close(m_FileDescriptor);
+	}
+
+	std::size_t MemoryMappedStorage::RoundSize(const std::size_t numberOfBytes)
+	{
+		// Small blocks (nodes, short edge lists) are rounded to 16 bytes,
+		// larger ones to the next power of two to limit the number of lists.
+		if(numberOfBytes <= 1024)
+			return (numberOfBytes + 15) & ~static_cast<std::size_t>(15);
+
+		std::size_t size = 2048;
+		while(size < numberOfBytes)
+			size <<= 1;
+		return size;
+	}
+
+	void MemoryMappedStorage::MapNewSegment(const std::size_t minimumSize)
+	{
+		const std::size_t pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+		std::size_t length = std::max(m_SegmentSize, minimumSize);
+		length = ((length + pageSize - 1) / pageSize) * pageSize;
+
+		void * addr;
+		if(m_FileDescriptor < 0)
+			addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		else
+		{
+			if(ftruncate(m_FileDescriptor, static_cast<off_t>(m_FileSize + length)) != 0)
+				throw std::runtime_error(std::string("MemoryMappedStorage - Cannot grow the storage file: ") +
+										 std::strerror(errno));
+
+			addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+						m_FileDescriptor, static_cast<off_t>(m_FileSize));
+		}
+		if(addr == MAP_FAILED)
+			throw std::runtime_error(std::string("MemoryMappedStorage - Cannot map the storage file: ") +
+									 std::strerror(errno));
+
+		m_Segments.push_back(std::make_pair(static_cast<char*>(addr), length));
+		m_FileSize += length;
+		m_Cursor = static_cast<char*>(addr);
+		m_End = m_Cursor + length;
+	}
+
+	void * MemoryMappedStorage::Allocate(const std::size_t numberOfBytes)
+	{
+		const std::size_t size = RoundSize(numberOfBytes);
+
+		// Reuse a released block first.
+		auto freeList = m_FreeLists.find(size);
+		if(freeList != m_FreeLists.end() && freeList->second != nullptr)
+		{
+			void * block = freeList->second;
+			freeList->second = *static_cast<void**>(block);
+			return block;
+		}
+
+		if(m_Cursor == nullptr || static_cast<std::size_t>(m_End - m_Cursor) < size)
+			MapNewSegment(size);
+
+		void * block = m_Cursor;
+		m_Cursor += size;
+		return block;
+	}
+
+	void MemoryMappedStorage::Deallocate(void * ptr, const std::size_t numberOfBytes)
+	{
+		if(ptr == nullptr)
+			return;
+
+		void *& head = m_FreeLists[RoundSize(numberOfBytes)];
+		*static_cast<void**>(ptr) = head;
+		head = ptr;
+	}
+	
+} // end of namespace grm
@@ -0,0 +1,74 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "grmMemoryUsage.h"
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+
+namespace grm
+{
+	namespace
+	{
+		/* Read a field (in kB) of /proc/self/status, 0 if not available. */
+		std::size_t ReadProcStatus(const std::string& field)
+		{
+			std::ifstream status("/proc/self/status");
+			std::string line;
+			while(std::getline(status, line))
+			{
+				if(line.compare(0, field.size(), field) == 0)
+					return std::stoul(line.substr(field.size() + 1)) * 1024;
+			}
+			return 0;
+		}
+	}
+
+	std::size_t GetCurrentMemoryUsage()
+	{
+		return ReadProcStatus("VmRSS");
+	}
+
+	std::size_t GetPeakMemoryUsage()
+	{
+		std::size_t peak = ReadProcStatus("VmHWM");
+		if(peak == 0)
+		{
+			struct rusage usage;
+			if(getrusage(RUSAGE_SELF, &usage) == 0)
+				peak = static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+		}
+		return peak;
+	}
+
+	void ResetPeakMemoryUsage()
+	{
+		// Writing 5 to clear_refs resets VmHWM (Linux >= 4.0).
+		std::ofstream clearRefs("/proc/self/clear_refs");
+		if(clearRefs)
+			clearRefs << "5";
+	}
+
+	std::size_t GetHeapBlockSize(const std::size_t numberOfBytes)
+	{
+		if(numberOfBytes == 0)
+			return 0;
+		return std::max<std::size_t>(32, (numberOfBytes + sizeof(std::size_t) + 15) & ~static_cast<std::size_t>(15));
+	}
+	
+} // end of namespace grm
@@ -0,0 +1,96 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "grmParallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace grm
+{
+	unsigned int GetNumberOfThreads(const unsigned int requested)
+	{
+		if(requested > 0)
+			return requested;
+
+		const char * itkThreads = std::getenv("ITK_GLOBAL_DEFAULT_NUMBER_OF_THREADS");
+		if(itkThreads != nullptr && std::atoi(itkThreads) > 0)
+			return std::atoi(itkThreads);
+
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	void ParallelFor(const std::size_t first,
+					 const std::size_t last,
+					 const unsigned int numberOfThreads,
+					 const std::function<void(std::size_t, std::size_t)>& f)
+	{
+		if(first >= last)
+			return;
+
+		const std::size_t n = last - first;
+		const std::size_t threads = std::min<std::size_t>(GetNumberOfThreads(numberOfThreads), n);
+		if(threads == 1)
+		{
+			f(first, last);
+			return;
+		}
+
+		// A few blocks per thread are enough to balance the work.
+		const std::size_t blockSize = std::max<std::size_t>(1, n / (8 * threads));
+		std::atomic<std::size_t> next(first);
+		std::exception_ptr error;
+		std::mutex errorMutex;
+
+		auto worker = [&]()
+		{
+			try
+			{
+				for(;;)
+				{
+					const std::size_t begin = next.fetch_add(blockSize);
+					if(begin >= last)
+						break;
+					f(begin, std::min(begin + blockSize, last));
+				}
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if(!error)
+					error = std::current_exception();
+				next = last;
+			}
+		};
+
+		std::vector<std::thread> pool;
+		pool.reserve(threads - 1);
+		for(std::size_t t = 1; t < threads; ++t)
+			pool.emplace_back(worker);
+		worker();
+		for(auto& thread : pool)
+			thread.join();
+
+		if(error)
+			std::rethrow_exception(error);
+	}
+
+} // end of namespace grm
@@ -0,0 +1,100 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "grmStatistics.h"
+#include <fstream>
+#include <stdexcept>
+
+namespace grm
+{
+	void SegmentationStatistics::Clear()
+	{
+		m_InitializationTime = 0.0;
+		m_InitialNumberOfNodes = 0;
+		m_NumberOfCostEvaluations = 0;
+		m_NumberOfCachedCosts = 0;
+		m_NumberOfSmallRegionMerges = 0;
+		m_SmallRegionMergingTime = 0.0;
+		m_InitialMemoryUsage = 0;
+		m_PeakMemoryUsage = 0;
+		m_EstimatedMemoryUsage = 0;
+		m_Iterations.clear();
+	}
+
+	void SegmentationStatistics::WriteCSV(std::ostream& os) const
+	{
+		os << "iteration,threshold,nodes,edges,merges,cost_evaluations,cached_costs,cost_update_time,merge_time,"
+		   << "node_removal_time,memory_usage" << std::endl;
+		for(auto& it : m_Iterations)
+		{
+			os << it.m_Iteration << "," << it.m_Threshold << "," << it.m_NumberOfNodes << "," << it.m_NumberOfEdges << ","
+			   << it.m_NumberOfMerges << "," << it.m_NumberOfCostEvaluations << ","
+			   << it.m_NumberOfCachedCosts << ","
+			   << it.m_CostUpdateTime << "," << it.m_MergeTime << "," << it.m_NodeRemovalTime << ","
+			   << it.m_MemoryUsage << std::endl;
+		}
+	}
+
+	void SegmentationStatistics::WriteJSON(std::ostream& os) const
+	{
+		os << "{" << std::endl
+		   << "  \"initialization_time\": " << m_InitializationTime << "," << std::endl
+		   << "  \"initial_nodes\": " << m_InitialNumberOfNodes << "," << std::endl
+		   << "  \"cost_evaluations\": " << m_NumberOfCostEvaluations << "," << std::endl
+		   << "  \"cached_costs\": " << m_NumberOfCachedCosts << "," << std::endl
+		   << "  \"small_region_merges\": " << m_NumberOfSmallRegionMerges << "," << std::endl
+		   << "  \"small_region_merging_time\": " << m_SmallRegionMergingTime << "," << std::endl
+		   << "  \"initial_memory_usage\": " << m_InitialMemoryUsage << "," << std::endl
+		   << "  \"peak_memory_usage\": " << m_PeakMemoryUsage << "," << std::endl
+		   << "  \"estimated_memory_usage\": " << m_EstimatedMemoryUsage << "," << std::endl
+		   << "  \"iterations\": [";
+
+		for(std::size_t i = 0; i < m_Iterations.size(); ++i)
+		{
+			const IterationStatistics& it = m_Iterations[i];
+			os << (i > 0 ? "," : "") << std::endl
+			   << "    {\"iteration\": " << it.m_Iteration
+			   << ", \"threshold\": " << it.m_Threshold
+			   << ", \"nodes\": " << it.m_NumberOfNodes
+			   << ", \"edges\": " << it.m_NumberOfEdges
+			   << ", \"merges\": " << it.m_NumberOfMerges
+			   << ", \"cost_evaluations\": " << it.m_NumberOfCostEvaluations
+			   << ", \"cached_costs\": " << it.m_NumberOfCachedCosts
+			   << ", \"cost_update_time\": " << it.m_CostUpdateTime
+			   << ", \"merge_time\": " << it.m_MergeTime
+			   << ", \"node_removal_time\": " << it.m_NodeRemovalTime
+			   << ", \"memory_usage\": " << it.m_MemoryUsage << "}";
+		}
+
+		os << std::endl << "  ]" << std::endl << "}" << std::endl;
+	}
+
+	void SegmentationStatistics::Write(const std::string& fileName) const
+	{
+		std::ofstream os(fileName);
+		if(!os)
+			throw std::runtime_error("SegmentationStatistics::Write - Cannot open " + fileName);
+
+		const std::string extension(".json");
+		if(fileName.size() >= extension.size() &&
+		   fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0)
+			WriteJSON(os);
+		else
+			WriteCSV(os);
+	}
+	
+} // end of namespace grm
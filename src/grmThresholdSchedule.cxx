@@ -0,0 +1,136 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "grmThresholdSchedule.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace grm
+{
+	ThresholdSchedule::ThresholdSchedule() :
+		m_Type(CONSTANT), m_StartFactor(1.0f), m_NumberOfIterations(0)
+	{
+	}
+
+	ThresholdSchedule ThresholdSchedule::Linear(const float startFactor, const unsigned int numberOfIterations)
+	{
+		if(!(startFactor >= 0.0f) || numberOfIterations == 0)
+			throw std::runtime_error("ThresholdSchedule::Linear - The start factor has to be positive and the number of iterations nonzero");
+
+		ThresholdSchedule schedule;
+		schedule.m_Type = LINEAR;
+		schedule.m_StartFactor = startFactor;
+		schedule.m_NumberOfIterations = numberOfIterations;
+		return schedule;
+	}
+
+	ThresholdSchedule ThresholdSchedule::Geometric(const float startFactor, const unsigned int numberOfIterations)
+	{
+		if(!(startFactor > 0.0f) || numberOfIterations == 0)
+			throw std::runtime_error("ThresholdSchedule::Geometric - The start factor has to be strictly positive and the number of iterations nonzero");
+
+		ThresholdSchedule schedule;
+		schedule.m_Type = GEOMETRIC;
+		schedule.m_StartFactor = startFactor;
+		schedule.m_NumberOfIterations = numberOfIterations;
+		return schedule;
+	}
+
+	ThresholdSchedule ThresholdSchedule::Table(const std::vector<float>& factors)
+	{
+		if(factors.empty())
+			throw std::runtime_error("ThresholdSchedule::Table - The table of factors is empty");
+		for(auto factor : factors)
+		{
+			if(!(factor >= 0.0f))
+				throw std::runtime_error("ThresholdSchedule::Table - The factors have to be positive");
+		}
+
+		ThresholdSchedule schedule;
+		schedule.m_Type = TABLE;
+		schedule.m_Factors = factors;
+		return schedule;
+	}
+
+	ThresholdSchedule ThresholdSchedule::Parse(const std::string& description)
+	{
+		std::vector<std::string> tokens;
+		std::istringstream is(description);
+		std::string token;
+		while(std::getline(is, token, ':'))
+			tokens.push_back(token);
+
+		try
+		{
+			if(tokens.size() == 1 && tokens[0] == "constant")
+				return ThresholdSchedule();
+			if(tokens.size() == 3 && tokens[0] == "linear")
+				return Linear(std::stof(tokens[1]), std::stoul(tokens[2]));
+			if(tokens.size() == 3 && tokens[0] == "geometric")
+				return Geometric(std::stof(tokens[1]), std::stoul(tokens[2]));
+			if(tokens.size() == 2 && tokens[0] == "table")
+			{
+				std::vector<float> factors;
+				std::istringstream values(tokens[1]);
+				while(std::getline(values, token, ','))
+					factors.push_back(std::stof(token));
+				return Table(factors);
+			}
+		}
+		catch(const std::logic_error&)
+		{
+			// Numbers which cannot be parsed are reported below.
+		}
+
+		throw std::runtime_error("ThresholdSchedule::Parse - Invalid threshold schedule: " + description);
+	}
+
+	float ThresholdSchedule::GetThreshold(const std::size_t iteration, const float threshold) const
+	{
+		// The constant schedule gives the threshold of the segmenter exactly.
+		if(m_Type == CONSTANT)
+			return threshold;
+		return GetFactor(iteration) * threshold;
+	}
+
+	bool ThresholdSchedule::IsRising(const std::size_t iteration, const float threshold) const
+	{
+		return GetThreshold(iteration + 1, threshold) > GetThreshold(iteration, threshold);
+	}
+
+	float ThresholdSchedule::GetFactor(const std::size_t iteration) const
+	{
+		switch(m_Type)
+		{
+		case LINEAR:
+			if(iteration >= m_NumberOfIterations)
+				return 1.0f;
+			return m_StartFactor + (1.0f - m_StartFactor) * iteration / m_NumberOfIterations;
+		case GEOMETRIC:
+			if(iteration >= m_NumberOfIterations)
+				return 1.0f;
+			return std::pow(m_StartFactor, static_cast<float>(m_NumberOfIterations - iteration) / m_NumberOfIterations);
+		case TABLE:
+			return m_Factors[std::min(iteration, m_Factors.size() - 1)];
+		default:
+			return 1.0f;
+		}
+	}
+
+} // end of namespace grm
@@ -19,6 +19,56 @@
 
 namespace lp
 {
+	namespace
+	{
+		/*
+		 * Walks along a contour starting at the cell startCellId and calls
+		 * f with the index of each border cell (several times for some).
+		 * Within a run, every move is a straight step from a border cell to
+		 * the next one. Between two runs, a turn to the left (the new move
+		 * is the previous one minus 1) crosses the corner of a diagonal
+		 * cell, while a turn to the right stays on the current cell.
+		 */
+		template<class F>
+		void ForEachBorderCell(const Contour& contour,
+							   CellIndex idx,
+							   const std::size_t gridSizeX,
+							   F f)
+		{
+			// Add the first pixel to the border list
+			f(idx);
+
+			if(ContourOperations::GetNumberOfMoves(contour) <= 4)
+				return;
+
+			const long int width = static_cast<long int>(gridSizeX);
+			const long int straightSteps[4] = {-width, 1, width, -1};
+
+			Move prev = 0;
+			bool first = true;
+			for(const Run r : contour)
+			{
+				const Move curr = ContourOperations::GetRunMove(r);
+				std::size_t length = ContourOperations::GetRunLength(r);
+
+				// The first move of the contour has no predecessor.
+				if(!first && curr == (prev + 3) % 4)
+				{
+					idx += straightSteps[prev] + straightSteps[curr];
+					f(idx);
+				}
+				first = false;
+
+				for(--length; length > 0; --length)
+				{
+					idx += straightSteps[curr];
+					f(idx);
+				}
+
+				prev = curr;
+			}
+		}
+	} // end of anonymous namespace
 	
 	void ContourOperations::MergeContour(Contour& mergedContour,
 										 BoundingBox& mergedBBox,
@@ -34,12 +84,7 @@ namespace lp
 		// of the bounding boxes bbox1 and bbox2
 		mergedBBox = MergeBoundingBoxes(bbox1, bbox2);
 
-		// Create the associate matrix indicating where the cells are located
-		// inside the bbox
-		std::vector<bool> cellMatrix(mergedBBox.m_W*mergedBBox.m_H, false);
-		std::unordered_set<CellIndex> setCells;
-
-		// Fill the cell matrix with the cells from both contours
+		// Collect the border cells of both contours in the merged bbox reference
 		CellLists borderCells;
 
         // Fill with the cells of contour 1
@@ -173,105 +218,9 @@ namespace lp
 																const std::size_t gridSizeX,
 																const BoundingBox& mergedBBox)
 	{
-		// Add the first pixel to the border list
-		borderCells.insert(GridToBBox(startCellId, mergedBBox, gridSizeX));
-
-		if(contour.size() > 8)
-		{
-	
-			// Intialize the first move at prev
-			short curr, prev = GetMove10(GetMove2(0, contour));
-
-			// Declare the current pixel index
-			CellIndex idx = startCellId;
-
-			// Explore the contour
-			for(ContourIndex cidx = 1; cidx < contour.size() / 2; cidx++)
-			{
-				curr = GetMove10(GetMove2(cidx, contour));
-				assert(curr >= 0 && curr < 4);
-
-				if(curr == 0)
-				{
-					// Impossible case is prev = 2;
-					assert(prev != 2);
-
-					//*
-					//*
-					if(prev == 0)
-					{
-						idx -= gridSizeX;
-						borderCells.insert(GridToBBox(idx, mergedBBox, gridSizeX));
-					}
-			
-					//  *
-					// **
-					if(prev == 1)
-					{
-						idx = idx + 1 - gridSizeX;
-						borderCells.insert(GridToBBox(idx, mergedBBox, gridSizeX));
-					}
-				}else if(curr == 1)
-				{
-					// Impossible case
-					assert(prev != 3);
-
-					// **
-					if(prev == 1)
-					{
-						idx++;
-						borderCells.insert(GridToBBox(idx, mergedBBox, gridSizeX));
-					}
-
-					//*
-					//**
-					if (prev == 2)
-					{
-						idx = idx + 1 + gridSizeX;
-						borderCells.insert(GridToBBox(idx, mergedBBox, gridSizeX));
-					}
-			
-				}else if(curr == 2)
-				{
-					// Impossible case
-					assert(prev != 0);
-
-					// *
-					// *
-					if(prev == 2)
-					{
-						idx += gridSizeX;
-						borderCells.insert(GridToBBox(idx, mergedBBox, gridSizeX));
-					}
-
-					// **
-					// *
-					if(prev == 3)
-					{
-						idx = idx - 1 + gridSizeX;
-						borderCells.insert(GridToBBox(idx, mergedBBox, gridSizeX));
-					}
-				}else
-				{
-					// Impossible case
-					assert(prev != 1);
-
-					if(prev == 0)
-					{
-						idx = idx - 1 - gridSizeX;
-						borderCells.insert(GridToBBox(idx, mergedBBox, gridSizeX));
-					}
-
-					if(prev == 3)
-					{
-						idx--;
-						borderCells.insert(GridToBBox(idx, mergedBBox, gridSizeX));
-					}
-				}
-
-				prev = curr;
-			}
-		}
+		ForEachBorderCell(contour, startCellId, gridSizeX, [&](const CellIndex idx){
+				borderCells.insert(GridToBBox(idx, mergedBBox, gridSizeX));
+			});
 	}
 	
 	void ContourOperations::GenerateBorderCells(CellLists& borderCells, 
@@ -279,105 +228,9 @@ namespace lp
 												const CellIndex startCellId, 
 												const std::size_t gridSizeX)
 	{
-		// Add the first pixel to the border list
-		borderCells.insert(startCellId);
-
-		if(contour.size() > 8)
-		{
-	
-			// Intialize the first move at prev
-			short curr, prev = GetMove10(GetMove2(0, contour));
-
-			// Declare the current pixel index
-			CellIndex idx = startCellId;
-
-			// Explore the contour
-			for(ContourIndex cidx = 1; cidx < contour.size() / 2; cidx++)
-			{
-				curr = GetMove10(GetMove2(cidx, contour));
-				assert(curr >= 0 && curr < 4);
-
-				if(curr == 0)
-				{
-					// Impossible case is prev = 2;
-					assert(prev != 2);
-
-					//*
-					//*
-					if(prev == 0)
-					{
-						idx -= gridSizeX;
-						borderCells.insert(idx);
-					}
-			
-					//  *
-					// **
-					if(prev == 1)
-					{
-						idx = idx + 1 - gridSizeX;
-						borderCells.insert(idx);
-					}
-				}else if(curr == 1)
-				{
-					// Impossible case
-					assert(prev != 3);
-
-					// **
-					if(prev == 1)
-					{
-						idx++;
-						borderCells.insert(idx);
-					}
-
-					//*
-					//**
-					if (prev == 2)
-					{
-						idx = idx + 1 + gridSizeX;
-						borderCells.insert(idx);
-					}
-			
-				}else if(curr == 2)
-				{
-					// Impossible case
-					assert(prev != 0);
-
-					// *
-					// *
-					if(prev == 2)
-					{
-						idx += gridSizeX;
-						borderCells.insert(idx);
-					}
-
-					// **
-					// *
-					if(prev == 3)
-					{
-						idx = idx - 1 + gridSizeX;
-						borderCells.insert(idx);
-					}
-				}else
-				{
-					// Impossible case
-					assert(prev != 1);
-
-					if(prev == 0)
-					{
-						idx = idx - 1 - gridSizeX;
-						borderCells.insert(idx);
-					}
-
-					if(prev == 3)
-					{
-						idx--;
-						borderCells.insert(idx);
-					}
-				}
-
-				prev = curr;
-			}
-		}
+		ForEachBorderCell(contour, startCellId, gridSizeX, [&](const CellIndex idx){
+				borderCells.insert(idx);
+			});
 	}
 
 	CellIndex ContourOperations::BBoxToGrid(const CellIndex bboxId,
@@ -462,33 +315,40 @@ namespace lp
 		return bb;
 	}
 	
-	Move ContourOperations::GetMove2(ContourIndex idx, const Contour& contour)
+	std::size_t ContourOperations::GetNumberOfMoves(const Contour& contour)
 	{
-		return Move(2*contour[2*idx] + contour[idx*2 +1]);
+		std::size_t numberOfMoves = 0;
+		for(const Run r : contour)
+			numberOfMoves += GetRunLength(r);
+		return numberOfMoves;
 	}
 
-	short ContourOperations::GetMove10(const Move& m)
+	void ContourOperations::Push(Contour& contour, const Move m)
 	{
-		return (m[0]*2 + m[1]);
+		// Extend the last run if it has the same move.
+		if(!contour.empty() && GetRunMove(contour.back()) == m)
+			contour.back() += 4;
+		else
+			contour.push_back(static_cast<Run>(4 | m));
 	}
 	
 	void ContourOperations::Push0(Contour& contour)
 	{
-		contour.push_back(0); contour.push_back(0);
+		Push(contour, 0);
 	}
 
 	void ContourOperations::Push1(Contour& contour)
 	{
-		contour.push_back(1); contour.push_back(0);
+		Push(contour, 1);
 	}
 
 	void ContourOperations::Push2(Contour& contour)
 	{
-		contour.push_back(0); contour.push_back(1);
+		Push(contour, 2);
 	}
 
 	void ContourOperations::Push3(Contour& contour)
 	{
-		contour.push_back(1); contour.push_back(1);
+		Push(contour, 3);
 	}
 } // end of namespace lp
@@ -0,0 +1,264 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+     Checks the Baatz & Schape segmenter, which combines the squared
+     deviations of the regions pairwise and computes the costs of the
+     edges by batches, against the direct formula from the sums of the
+     values and of their squares: same number of regions, same labels and
+     same merging costs on the final graph.
+
+     Usage: grmBaatzSegmenterTest [width height bands]
+
+=========================================================================*/
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <otbVectorImage.h>
+#include "grmBaatzSegmenter.h"
+
+namespace
+{
+	typedef otb::VectorImage<unsigned short, 2> ImageType;
+
+	/* Region of the reference segmenter */
+	struct ReferenceBaatzNode : grm::Node<ReferenceBaatzNode>
+	{
+		std::vector<uint64_t> m_SpectralSum;
+		std::vector<uint64_t> m_SquareSum;
+		std::vector<float> m_Std;
+	};
+
+	/*
+	  Baatz & Schape criterion computed one edge at a time with the standard
+	  deviations derived from the exact sums of the values and of their squares.
+	*/
+	class ReferenceBaatzSegmenter : public grm::Segmenter<ImageType, ReferenceBaatzNode, grm::BaatzParam>
+	{
+	public:
+
+		typedef grm::Segmenter<ImageType, ReferenceBaatzNode, grm::BaatzParam> Superclass;
+		typedef Superclass::NodePointerType NodePointerType;
+		typedef Superclass::GraphOperatorType GraphOperatorType;
+
+		void InitFromImage()
+		{
+			this->m_ImageWidth = this->m_InputImage->GetLargestPossibleRegion().GetSize()[0];
+			this->m_ImageHeight = this->m_InputImage->GetLargestPossibleRegion().GetSize()[1];
+			this->m_NumberOfComponentsPerPixel = this->m_InputImage->GetNumberOfComponentsPerPixel();
+
+			this->ForEachPixelByStrips(this->m_InputImage, [&](const std::size_t idx, const ImageType::PixelType& pixel)
+				{
+					auto& n = this->m_Graph.m_Nodes[idx];
+					n->m_SpectralSum.resize(this->m_NumberOfComponentsPerPixel);
+					n->m_SquareSum.resize(this->m_NumberOfComponentsPerPixel);
+					n->m_Std.assign(this->m_NumberOfComponentsPerPixel, 0.0f);
+					for(unsigned int b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+					{
+						n->m_SpectralSum[b] = pixel[b];
+						n->m_SquareSum[b] = uint64_t(pixel[b]) * pixel[b];
+					}
+				});
+		}
+
+		float ComputeMergingCost(NodePointerType n1, NodePointerType n2)
+		{
+			const unsigned int a1 = n1->m_Area, a2 = n2->m_Area, a_sum = a1 + a2;
+
+			float spect_cost = 0.0f;
+			for(unsigned int b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+			{
+				const float std = static_cast<float>(ComputeStd(static_cast<double>(n1->m_SpectralSum[b] + n2->m_SpectralSum[b]),
+																static_cast<double>(n1->m_SquareSum[b] + n2->m_SquareSum[b]),
+																a_sum));
+				spect_cost += (a_sum * std - a1 * n1->m_Std[b] - a2 * n2->m_Std[b]);
+			}
+			spect_cost *= this->m_Param.m_SpectralWeight;
+
+			if(spect_cost >= this->m_Threshold)
+				return spect_cost;
+
+			const float p1 = static_cast<float>(n1->m_Perimeter);
+			const float p2 = static_cast<float>(n2->m_Perimeter);
+			const unsigned int boundary = (GraphOperatorType::FindEdge(n1, n2))->m_Boundary;
+			const float p3 = p1 + p2 - 2 * static_cast<float>(boundary);
+
+			const lp::BoundingBox merged_bbox = lp::ContourOperations::MergeBoundingBoxes(n1->m_Bbox, n2->m_Bbox);
+			const float bb1_perimeter = static_cast<float>(2*n1->m_Bbox.m_W + 2*n1->m_Bbox.m_H);
+			const float bb2_perimeter = static_cast<float>(2*n2->m_Bbox.m_W + 2*n2->m_Bbox.m_H);
+			const float mbb_perimeter = static_cast<float>(2 * merged_bbox.m_W + 2 * merged_bbox.m_H);
+
+			const float smooth_f = a_sum*p3/mbb_perimeter - a1*p1/bb1_perimeter - a2*p2/bb2_perimeter;
+			const float compact_f = a_sum*p3/std::sqrt(a_sum) - a1*p1/std::sqrt(a1) - a2*p2/std::sqrt(a2);
+			const float shape_cost = this->m_Param.m_ShapeWeight * compact_f + (1-this->m_Param.m_ShapeWeight) * smooth_f;
+
+			return (spect_cost + (1-this->m_Param.m_SpectralWeight)*shape_cost);
+		}
+
+		void UpdateSpecificAttributes(NodePointerType n1, NodePointerType n2)
+		{
+			const double a_sum = static_cast<double>(n1->m_Area) + static_cast<double>(n2->m_Area);
+			for(unsigned int b = 0; b < this->m_NumberOfComponentsPerPixel; ++b)
+			{
+				n1->m_SpectralSum[b] += n2->m_SpectralSum[b];
+				n1->m_SquareSum[b] += n2->m_SquareSum[b];
+				n1->m_Std[b] = static_cast<float>(ComputeStd(static_cast<double>(n1->m_SpectralSum[b]),
+															 static_cast<double>(n1->m_SquareSum[b]),
+															 a_sum));
+			}
+		}
+
+	private:
+
+		static double ComputeStd(const double sum, const double squareSum, const double area)
+		{
+			const double squaredDeviations = squareSum - sum * sum / area;
+			return (squaredDeviations > 0.0) ? std::sqrt(squaredDeviations / area) : 0.0;
+		}
+	};
+
+	/* Blocks of 16 x 16 pixels of random radiometry with a gaussian noise */
+	ImageType::Pointer CreateImage(const unsigned int width, const unsigned int height, const unsigned int bands)
+	{
+		ImageType::IndexType index;
+		ImageType::SizeType size;
+		ImageType::RegionType region;
+		index[0] = 0; index[1] = 0;
+		size[0] = width; size[1] = height;
+		region.SetIndex(index);
+		region.SetSize(size);
+
+		ImageType::Pointer image = ImageType::New();
+		image->SetRegions(region);
+		image->SetNumberOfComponentsPerPixel(bands);
+		image->Allocate();
+
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<float> radiometry(200.0f, 1000.0f);
+		std::normal_distribution<float> noise(0.0f, 8.0f);
+
+		const unsigned int blocksX = (width + 15) / 16, blocksY = (height + 15) / 16;
+		std::vector<float> values(std::size_t(blocksX) * blocksY * bands);
+		for(auto& v : values)
+			v = radiometry(generator);
+
+		ImageType::PixelType pixel;
+		pixel.SetSize(bands);
+		for(unsigned int y = 0; y < height; ++y)
+		{
+			for(unsigned int x = 0; x < width; ++x)
+			{
+				const float * value = &values[((y / 16) * blocksX + x / 16) * bands];
+				for(unsigned int b = 0; b < bands; ++b)
+					pixel[b] = static_cast<unsigned short>(std::max(0.0f, value[b] + noise(generator)));
+				index[0] = x; index[1] = y;
+				image->SetPixel(index, pixel);
+			}
+		}
+		return image;
+	}
+
+	template<class TSegmenter>
+	void Segment(TSegmenter& seg, ImageType * image)
+	{
+		grm::BaatzParam params;
+		params.m_SpectralWeight = 0.7;
+		params.m_ShapeWeight = 0.3;
+		seg.SetParam(params);
+		seg.SetThreshold(60 * 60);
+		seg.SetInput(image);
+		seg.Update();
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	unsigned int width = 128, height = 128, bands = 4;
+	if(argc == 4)
+	{
+		width = std::stoul(argv[1]);
+		height = std::stoul(argv[2]);
+		bands = std::stoul(argv[3]);
+	}
+	else if(argc != 1)
+	{
+		std::cerr << "Usage: " << argv[0] << " [width height bands]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	ImageType::Pointer image = CreateImage(width, height, bands);
+
+	grm::BaatzSegmenter<ImageType> seg;
+	ReferenceBaatzSegmenter reference;
+	Segment(seg, image);
+	Segment(reference, image);
+
+	std::cout << seg.m_Graph.m_Nodes.size() << " regions (reference: "
+			  << reference.m_Graph.m_Nodes.size() << ")" << std::endl;
+	if(seg.m_Graph.m_Nodes.size() != reference.m_Graph.m_Nodes.size())
+	{
+		std::cerr << "Different numbers of regions" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// The labels follow the order of the nodes: identical merges give identical label images.
+	auto labels = seg.GetLabeledClusteredOutput();
+	auto referenceLabels = reference.GetLabeledClusteredOutput();
+	const std::size_t numberOfPixels = std::size_t(width) * height;
+	for(std::size_t i = 0; i < numberOfPixels; ++i)
+	{
+		if(labels->GetBufferPointer()[i] != referenceLabels->GetBufferPointer()[i])
+		{
+			std::cerr << "Different labels at pixel " << i << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Costs of the merges of the final regions, which span many pixels.
+	for(std::size_t i = 0; i < seg.m_Graph.m_Nodes.size(); ++i)
+	{
+		auto n = seg.m_Graph.m_Nodes[i];
+		auto r = reference.m_Graph.m_Nodes[i];
+		if(n->m_Edges.size() != r->m_Edges.size())
+		{
+			std::cerr << "Different numbers of neighbors of region " << i << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		// The edges are not in the same order in both graphs: they are matched by the ids of the neighbors.
+		for(auto& edge : n->m_Edges)
+		{
+			auto referenceEdge = std::find_if(r->m_Edges.begin(), r->m_Edges.end(), [&](const ReferenceBaatzNode::CRPTNeighborType& e)
+											  { return e.GetRegion()->m_Id == edge.GetRegion()->m_Id; });
+			if(referenceEdge == r->m_Edges.end())
+			{
+				std::cerr << "Different neighbors of region " << i << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			const float cost = seg.ComputeMergingCost(n, edge.GetRegion());
+			const float referenceCost = reference.ComputeMergingCost(r, referenceEdge->GetRegion());
+			if(std::abs(cost - referenceCost) > 1e-3f * std::max(1.0f, std::abs(referenceCost)))
+			{
+				std::cerr << "Different merging costs of region " << i << ": " << cost
+						  << " (reference: " << referenceCost << ")" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
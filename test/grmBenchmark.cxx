@@ -0,0 +1,483 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+     Benchmark of the GRM library: times the main steps of the region
+     merging for each criterion, on a synthetic image or on a real one.
+
+     Usage: grmBenchmark [--help] [--in image] [--width w] [--height h] [--bands b]
+                         [--texture t] [--criterion bs|ed|fls|all]
+                         [--repeat n] [--csv file]
+
+=========================================================================*/
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <otbVectorImage.h>
+#include <otbImageFileReader.h>
+#include "grmSpringSegmenter.h"
+#include "grmFullLambdaScheduleSegmenter.h"
+#include "grmBaatzSegmenter.h"
+#include "grmMemoryUsage.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	typedef otb::VectorImage<float, 2> ImageType;
+	typedef otb::ImageFileReader<ImageType> ReaderType;
+	typedef std::chrono::steady_clock Clock;
+
+	struct BenchmarkOptions
+	{
+		std::string m_InputFileName;
+		unsigned int m_Width = 512;
+		unsigned int m_Height = 512;
+		unsigned int m_Bands = 4;
+		float m_Texture = 4.0f;
+		std::string m_Criterion = "all";
+		unsigned int m_Repeat = 1;
+		std::string m_CsvFileName;
+		bool m_Help = false;
+	};
+
+	/* One line of the report */
+	struct Measure
+	{
+		std::string m_Criterion;
+		std::string m_Scenario;
+		double m_Seconds = 0.0;
+		std::size_t m_PeakMemory = 0;
+		std::size_t m_Merges = 0;
+		unsigned int m_Iterations = 0;
+		long long m_CacheMisses = -1;
+
+		/* Quality of the segmentation of the full runs (see GetRootMeanSquareError) */
+		std::size_t m_NumberOfRegions = 0;
+		double m_RootMeanSquareError = -1.0;
+	};
+
+	/*
+	  Counter of the hardware cache misses of the calling thread
+	  (perf_event_open), reports -1 when it is not available.
+	*/
+	class CacheMissCounter
+	{
+	public:
+		CacheMissCounter() : m_Fd(-1)
+		{
+#ifdef __linux__
+			struct perf_event_attr attr;
+			std::memset(&attr, 0, sizeof(attr));
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = PERF_COUNT_HW_CACHE_MISSES;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			m_Fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+		}
+
+		~CacheMissCounter()
+		{
+#ifdef __linux__
+			if(m_Fd >= 0)
+				close(m_Fd);
+#endif
+		}
+
+		void Start()
+		{
+#ifdef __linux__
+			if(m_Fd >= 0)
+			{
+				ioctl(m_Fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(m_Fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		long long Stop()
+		{
+			long long count = -1;
+#ifdef __linux__
+			if(m_Fd >= 0)
+			{
+				ioctl(m_Fd, PERF_EVENT_IOC_DISABLE, 0);
+				if(read(m_Fd, &count, sizeof(count)) != sizeof(count))
+					count = -1;
+			}
+#endif
+			return count;
+		}
+
+	private:
+		int m_Fd;
+	};
+
+	double Seconds(const Clock::time_point& start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	/*
+	  Synthetic scene made of patches of constant radiometry (Voronoi cells
+	  around random seeds) with a gaussian noise of standard deviation texture.
+	*/
+	ImageType::Pointer CreateSyntheticImage(const BenchmarkOptions& options)
+	{
+		ImageType::IndexType index;
+		ImageType::SizeType size;
+		ImageType::RegionType region;
+		index[0] = 0; index[1] = 0;
+		size[0] = options.m_Width; size[1] = options.m_Height;
+		region.SetIndex(index);
+		region.SetSize(size);
+
+		ImageType::Pointer image = ImageType::New();
+		image->SetRegions(region);
+		image->SetNumberOfComponentsPerPixel(options.m_Bands);
+		image->Allocate();
+
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<float> radiometry(0.0f, 255.0f);
+		std::normal_distribution<float> noise(0.0f, options.m_Texture);
+
+		// One seed jittered inside each cell of a 32x32 grid: the closest seed of
+		// a pixel lies in its cell or in one of the 8 neighbouring cells.
+		const unsigned int cellSize = 32;
+		const unsigned int cellsX = (options.m_Width + cellSize - 1) / cellSize;
+		const unsigned int cellsY = (options.m_Height + cellSize - 1) / cellSize;
+		const std::size_t numberOfSeeds = std::size_t(cellsX) * cellsY;
+		std::uniform_int_distribution<unsigned int> jitter(0, cellSize - 1);
+		std::vector<std::pair<unsigned int, unsigned int> > seeds(numberOfSeeds);
+		std::vector<std::vector<float> > values(numberOfSeeds, std::vector<float>(options.m_Bands));
+		for(std::size_t s = 0; s < numberOfSeeds; ++s)
+		{
+			const unsigned int x = (s % cellsX) * cellSize + jitter(generator);
+			const unsigned int y = (s / cellsX) * cellSize + jitter(generator);
+			seeds[s] = std::make_pair(std::min(x, options.m_Width - 1), std::min(y, options.m_Height - 1));
+			for(auto& v : values[s])
+				v = radiometry(generator);
+		}
+
+		ImageType::PixelType pixel;
+		pixel.SetSize(options.m_Bands);
+		for(unsigned int y = 0; y < options.m_Height; ++y)
+		{
+			const unsigned int cellY = y / cellSize;
+			for(unsigned int x = 0; x < options.m_Width; ++x)
+			{
+				const unsigned int cellX = x / cellSize;
+				std::size_t closest = 0;
+				long int minDistance = std::numeric_limits<long int>::max();
+				for(unsigned int cy = (cellY > 0) ? cellY - 1 : 0; cy <= std::min(cellY + 1, cellsY - 1); ++cy)
+				{
+					for(unsigned int cx = (cellX > 0) ? cellX - 1 : 0; cx <= std::min(cellX + 1, cellsX - 1); ++cx)
+					{
+						const std::size_t s = std::size_t(cy) * cellsX + cx;
+						const long int dx = long(x) - long(seeds[s].first), dy = long(y) - long(seeds[s].second);
+						if(dx * dx + dy * dy < minDistance)
+						{
+							minDistance = dx * dx + dy * dy;
+							closest = s;
+						}
+					}
+				}
+
+				for(unsigned int b = 0; b < options.m_Bands; ++b)
+					pixel[b] = values[closest][b] + noise(generator);
+
+				index[0] = x; index[1] = y;
+				image->SetPixel(index, pixel);
+			}
+		}
+
+		return image;
+	}
+
+	template<class TSegmenter>
+	void Configure(TSegmenter& seg, ImageType * image, float threshold)
+	{
+		seg.SetInput(image);
+		seg.SetThreshold(threshold);
+	}
+
+	void Configure(grm::BaatzSegmenter<ImageType>& seg, ImageType * image, float threshold)
+	{
+		grm::BaatzParam params;
+		params.m_SpectralWeight = 0.7;
+		params.m_ShapeWeight = 0.3;
+		seg.SetParam(params);
+		seg.SetInput(image);
+		seg.SetThreshold(threshold * threshold);
+	}
+
+	/*
+	  Root mean square difference between the pixels and the mean of their
+	  segment over all the bands: the lower, the more homogeneous the
+	  segments for a given number of segments.
+	*/
+	template<class TSegmenter>
+	double GetRootMeanSquareError(TSegmenter& seg, ImageType * image)
+	{
+		const unsigned int bands = image->GetNumberOfComponentsPerPixel();
+		std::vector<float> means(seg.m_Graph.m_Nodes.size() * bands);
+		for(std::size_t i = 0; i < seg.m_Graph.m_Nodes.size(); ++i)
+			seg.GetMeans(seg.m_Graph.m_Nodes[i], &means[i * bands]);
+
+		// The labels follow the order of the nodes.
+		auto labelImage = seg.GetLabeledClusteredOutput();
+		const std::size_t numberOfPixels = image->GetLargestPossibleRegion().GetNumberOfPixels();
+		double sum = 0.0;
+		for(std::size_t i = 0; i < numberOfPixels; ++i)
+		{
+			const float * mean = &means[(labelImage->GetBufferPointer()[i] - 1) * bands];
+			for(unsigned int b = 0; b < bands; ++b)
+			{
+				const double difference = image->GetBufferPointer()[i * bands + b] - mean[b];
+				sum += difference * difference;
+			}
+		}
+		return std::sqrt(sum / (double(numberOfPixels) * bands));
+	}
+
+	/* Run all the scenarios for a criterion. */
+	template<class TSegmenter>
+	void BenchmarkCriterion(const std::string& name, ImageType * image, float threshold,
+							std::vector<Measure>& measures)
+	{
+		typedef typename TSegmenter::GraphOperatorType GraphOperatorType;
+		CacheMissCounter cacheMisses;
+		const std::size_t numberOfPixels = image->GetLargestPossibleRegion().GetNumberOfPixels();
+
+		// Initialization of the graph and first computation of the costs.
+		{
+			Measure init, costs;
+			init.m_Criterion = costs.m_Criterion = name;
+			init.m_Scenario = "InitNodes";
+			costs.m_Scenario = "UpdateMergingCosts";
+
+			TSegmenter seg;
+			Configure(seg, image, threshold);
+
+			grm::ResetPeakMemoryUsage();
+			auto start = Clock::now();
+			GraphOperatorType::InitNodes(image, seg, FOUR);
+			init.m_Seconds = Seconds(start);
+			init.m_PeakMemory = grm::GetPeakMemoryUsage();
+
+			cacheMisses.Start();
+			start = Clock::now();
+			GraphOperatorType::UpdateMergingCosts(seg, seg.GetThreshold());
+			costs.m_Seconds = Seconds(start);
+			costs.m_CacheMisses = cacheMisses.Stop();
+			costs.m_PeakMemory = grm::GetPeakMemoryUsage();
+
+			measures.push_back(init);
+			measures.push_back(costs);
+		}
+
+		// Full runs with the local mutual best fitting heuristic, with the
+		// row-major layout and with the Z-order layout, then the dithered
+		// and the bucketed best fitting ones.
+		const char * scenarios[] = {"LMBF", "LMBF-ZOrder", "Dithered", "Bucketed"};
+		for(int scenario = 0; scenario < 4; ++scenario)
+		{
+			Measure run;
+			run.m_Criterion = name;
+			run.m_Scenario = scenarios[scenario];
+
+			TSegmenter seg;
+			Configure(seg, image, threshold);
+
+			grm::ResetPeakMemoryUsage();
+			GraphOperatorType::InitNodes(image, seg, FOUR);
+			if(scenario == 1)
+				GraphOperatorType::SortNodesAlongZOrderCurve(seg.m_Graph);
+
+			bool merged = true;
+			cacheMisses.Start();
+			auto start = Clock::now();
+			while(merged && run.m_Iterations < 200 && seg.m_Graph.m_Nodes.size() > 1)
+			{
+				++run.m_Iterations;
+				if(scenario == 1 && run.m_Iterations % 10 == 0)
+					GraphOperatorType::SortNodesAlongZOrderCurve(seg.m_Graph);
+
+				if(scenario == 2)
+					merged = GraphOperatorType::PerfomOneDitheredIterationWithBF(seg, seg.GetThreshold());
+				else if(scenario == 3)
+					merged = GraphOperatorType::PerfomOneBucketedIterationWithBF(seg, seg.GetThreshold());
+				else
+					merged = GraphOperatorType::PerfomOneIterationWithLMBF(seg, seg.GetThreshold());
+			}
+			run.m_Seconds = Seconds(start);
+			run.m_CacheMisses = cacheMisses.Stop();
+			run.m_PeakMemory = grm::GetPeakMemoryUsage();
+			run.m_Merges = numberOfPixels - seg.m_Graph.m_Nodes.size();
+			run.m_NumberOfRegions = seg.m_Graph.m_Nodes.size();
+			run.m_RootMeanSquareError = GetRootMeanSquareError(seg, image);
+			measures.push_back(run);
+
+			if(scenario == 0)
+			{
+				// Contour fusion of each remaining region with its first neighbor.
+				Measure contour;
+				contour.m_Criterion = name;
+				contour.m_Scenario = "MergeContour";
+				auto start = Clock::now();
+				for(auto& r : seg.m_Graph.m_Nodes)
+				{
+					if(r->m_Edges.empty())
+						continue;
+					// The contour starts at the first pixel of the region with the smallest id.
+					auto a = r;
+					auto b = r->m_Edges.front().GetRegion();
+					if(b->m_Id < a->m_Id)
+						std::swap(a, b);
+					lp::Contour mergedContour;
+					lp::BoundingBox mergedBBox;
+					lp::ContourOperations::MergeContour(mergedContour, mergedBBox, a->m_Contour, b->m_Contour,
+														a->m_Bbox, b->m_Bbox, a->m_Id, b->m_Id, seg.GetImageWidth());
+					++contour.m_Merges;
+				}
+				contour.m_Seconds = Seconds(start);
+				contour.m_PeakMemory = grm::GetPeakMemoryUsage();
+				measures.push_back(contour);
+
+				// Export of the label image.
+				Measure label;
+				label.m_Criterion = name;
+				label.m_Scenario = "LabelExport";
+				start = Clock::now();
+				auto labelImage = seg.GetLabeledClusteredOutput();
+				label.m_Seconds = Seconds(start);
+				label.m_PeakMemory = grm::GetPeakMemoryUsage();
+				measures.push_back(label);
+			}
+		}
+	}
+
+	void Report(const std::vector<Measure>& measures, std::ostream& os, const char sep)
+	{
+		os << "criterion" << sep << "scenario" << sep << "seconds" << sep << "peak_rss_mb" << sep
+		   << "merges" << sep << "merges_per_second" << sep << "iterations" << sep << "cache_misses" << sep
+		   << "regions" << sep << "rmse" << std::endl;
+		for(auto& m : measures)
+		{
+			os << m.m_Criterion << sep << m.m_Scenario << sep << std::fixed << std::setprecision(4) << m.m_Seconds << sep
+			   << std::setprecision(1) << m.m_PeakMemory / (1024.0 * 1024.0) << sep
+			   << m.m_Merges << sep << std::setprecision(0) << (m.m_Seconds > 0 ? m.m_Merges / m.m_Seconds : 0.0) << sep
+			   << m.m_Iterations << sep;
+			if(m.m_CacheMisses < 0)
+				os << "n/a";
+			else
+				os << m.m_CacheMisses;
+			os << sep;
+			if(m.m_RootMeanSquareError < 0)
+				os << "n/a" << sep << "n/a";
+			else
+				os << m.m_NumberOfRegions << sep << std::setprecision(3) << m.m_RootMeanSquareError;
+			os << std::endl;
+		}
+	}
+
+	bool ParseOptions(int argc, char * argv[], BenchmarkOptions& options)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			const std::string arg(argv[i]);
+			if(arg == "--help")
+			{
+				options.m_Help = true;
+				return true;
+			}
+			if(i + 1 >= argc)
+				return false;
+			const std::string value(argv[++i]);
+
+			if(arg == "--in") options.m_InputFileName = value;
+			else if(arg == "--width") options.m_Width = std::stoul(value);
+			else if(arg == "--height") options.m_Height = std::stoul(value);
+			else if(arg == "--bands") options.m_Bands = std::stoul(value);
+			else if(arg == "--texture") options.m_Texture = std::stof(value);
+			else if(arg == "--criterion") options.m_Criterion = value;
+			else if(arg == "--repeat") options.m_Repeat = std::stoul(value);
+			else if(arg == "--csv") options.m_CsvFileName = value;
+			else return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	BenchmarkOptions options;
+	const bool parsed = ParseOptions(argc, argv, options);
+	if(!parsed || options.m_Help)
+	{
+		std::ostream& out = parsed ? std::cout : std::cerr;
+		out << "Usage: " << argv[0] << " [--help] [--in image] [--width w] [--height h] [--bands b]"
+			<< " [--texture t] [--criterion bs|ed|fls|all] [--repeat n] [--csv file]" << std::endl;
+		return parsed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	ImageType::Pointer image;
+	if(options.m_InputFileName.empty())
+	{
+		image = CreateSyntheticImage(options);
+	}
+	else
+	{
+		ReaderType::Pointer reader = ReaderType::New();
+		reader->SetFileName(options.m_InputFileName);
+		reader->Update();
+		image = reader->GetOutput();
+
+		// Keep the image in memory: the segmenters would read it again by strips.
+		image->DisconnectPipeline();
+	}
+
+	std::vector<Measure> measures;
+	for(unsigned int r = 0; r < options.m_Repeat; ++r)
+	{
+		if(options.m_Criterion == "all" || options.m_Criterion == "bs")
+			BenchmarkCriterion< grm::BaatzSegmenter<ImageType> >("bs", image, 60, measures);
+		if(options.m_Criterion == "all" || options.m_Criterion == "ed")
+			BenchmarkCriterion< grm::SpringSegmenter<ImageType> >("ed", image, 30, measures);
+		if(options.m_Criterion == "all" || options.m_Criterion == "fls")
+			BenchmarkCriterion< grm::FullLambdaScheduleSegmenter<ImageType> >("fls", image, 500, measures);
+	}
+
+	Report(measures, std::cout, '\t');
+	if(!options.m_CsvFileName.empty())
+	{
+		std::ofstream csv(options.m_CsvFileName);
+		Report(measures, csv, ',');
+	}
+
+	return EXIT_SUCCESS;
+}
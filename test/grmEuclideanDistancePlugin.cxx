@@ -0,0 +1,123 @@
+/*=========================================================================
+
+  Program: Generic Region Merging Library
+  Language: C++
+  author: Lassalle Pierre
+  contact: lassallepierre34@gmail.com
+
+
+
+  Copyright (c) Centre National d'Etudes Spatiales. All rights reserved
+
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+     Example of a criterion plugin: the Euclidean distance between the
+     means of the regions, as the ed criterion, with an optional scale
+     of the distance ("scale=value").
+
+=========================================================================*/
+#include "grmCriterionPlugin.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace
+{
+	struct Context
+	{
+		unsigned int m_NumberOfBands;
+		double m_Scale;
+	};
+
+	void * CreateContext(const char * parameters, unsigned int numberOfBands)
+	{
+		double scale = 1.0;
+		if(parameters != nullptr && std::strlen(parameters) > 0)
+		{
+			const char * prefix = "scale=";
+			if(std::strncmp(parameters, prefix, std::strlen(prefix)) != 0)
+				return nullptr;
+
+			char * end = nullptr;
+			scale = std::strtod(parameters + std::strlen(prefix), &end);
+			if(*end != '\0' || !(scale > 0.0))
+				return nullptr;
+		}
+
+		Context * context = new(std::nothrow) Context;
+		if(context != nullptr)
+		{
+			context->m_NumberOfBands = numberOfBands;
+			context->m_Scale = scale;
+		}
+		return context;
+	}
+
+	void DestroyContext(void * context)
+	{
+		delete static_cast<Context*>(context);
+	}
+
+	/* The attributes are the means of the bands */
+	unsigned int GetNumberOfAttributes(const void * context)
+	{
+		return static_cast<const Context*>(context)->m_NumberOfBands;
+	}
+
+	void InitAttributes(const void * context, const float * pixels, size_t n, double * attributes)
+	{
+		const unsigned int bands = static_cast<const Context*>(context)->m_NumberOfBands;
+		for(size_t i = 0; i < n * bands; ++i)
+			attributes[i] = pixels[i];
+	}
+
+	void ComputeMergingCosts(const void * context,
+							 const GRMPluginRegion * region,
+							 const GRMPluginRegion * neighbors,
+							 const unsigned int *,
+							 size_t n,
+							 float * costs)
+	{
+		const Context * c = static_cast<const Context*>(context);
+		for(size_t i = 0; i < n; ++i)
+		{
+			double distance = 0.0;
+			for(unsigned int b = 0; b < c->m_NumberOfBands; ++b)
+			{
+				const double d = region->m_Attributes[b] - neighbors[i].m_Attributes[b];
+				distance += d * d;
+			}
+			costs[i] = static_cast<float>(c->m_Scale * std::sqrt(distance));
+		}
+	}
+
+	void MergeAttributes(const void * context, GRMPluginRegion * a, const GRMPluginRegion * b, unsigned int)
+	{
+		const unsigned int bands = static_cast<const Context*>(context)->m_NumberOfBands;
+		const double a1 = a->m_Area, a2 = b->m_Area;
+		for(unsigned int i = 0; i < bands; ++i)
+			a->m_Attributes[i] = (a1 * a->m_Attributes[i] + a2 * b->m_Attributes[i]) / (a1 + a2);
+	}
+
+	const GRMCriterionPlugin EuclideanDistanceCriterion = {
+		GRM_CRITERION_PLUGIN_ABI_VERSION,
+		"plugined",
+		"Euclidean Distance (plugin example)",
+		&CreateContext,
+		&DestroyContext,
+		&GetNumberOfAttributes,
+		&InitAttributes,
+		&ComputeMergingCosts,
+		&MergeAttributes
+	};
+} // end of anonymous namespace
+
+extern "C" __attribute__((visibility("default")))
+void GRMRegisterCriteria(GRMRegisterCriterionFunction registerCriterion, void * registry)
+{
+	registerCriterion(registry, &EuclideanDistanceCriterion);
+}